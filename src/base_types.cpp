@@ -9,20 +9,28 @@ void inplace_xor(buffer_type &lhs, const buffer_type &rhs) {
   if (lhs.empty())
     throw runtime_error("XOR empty bufffers");
 
+  inplace_xor(lhs.data(), rhs.data(), lhs.size());
+}
+
+void inplace_xor(char *lhs, const char *rhs, std::size_t size) {
   typedef std::uint_fast32_t fast_uint;
 
-  fast_uint *i = reinterpret_cast<fast_uint*>(lhs.data());
-  const fast_uint *j = reinterpret_cast<const fast_uint*>(rhs.data());
-  fast_uint *lhs_fast_end = i + (lhs.size() / sizeof(fast_uint));
-  while (i != lhs_fast_end) {
-    *i++ ^= *j++;
+  // The ranges can be unaligned when they are inside a block buffer:
+  // load and store the words with memcpy
+  char *lhs_fast_end = lhs + (size / sizeof(fast_uint)) * sizeof(fast_uint);
+  while (lhs != lhs_fast_end) {
+    fast_uint a, b;
+    std::memcpy(&a, lhs, sizeof(fast_uint));
+    std::memcpy(&b, rhs, sizeof(fast_uint));
+    a ^= b;
+    std::memcpy(lhs, &a, sizeof(fast_uint));
+    lhs += sizeof(fast_uint);
+    rhs += sizeof(fast_uint);
   }
 
-  char *i_c = reinterpret_cast<char*>(i);
-  const char *j_c = reinterpret_cast<const char*>(j);
-  char *lhs_end = lhs.data() + lhs.size();
-  while (i_c != lhs_end) {
-    *i_c++ ^= *j_c++;
+  char *lhs_end = lhs + size % sizeof(fast_uint);
+  while (lhs != lhs_end) {
+    *lhs++ ^= *rhs++;
   }
 }
 }
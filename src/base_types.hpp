@@ -21,6 +21,8 @@ typedef std::vector<char> buffer_type;
 
 /** Perform a bitwise XOR between two buffers. */
 void inplace_xor(buffer_type &lhs, const buffer_type &rhs);
+/** Perform a bitwise XOR between two ranges of `size` bytes. */
+void inplace_xor(char *lhs, const char *rhs, std::size_t size);
 
 }
 
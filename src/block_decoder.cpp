@@ -1,7 +1,11 @@
 #include "block_decoder.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iterator>
+#include <limits>
 #include <stdexcept>
 
 using namespace std;
@@ -9,6 +13,10 @@ using namespace std::chrono;
 
 namespace uep {
 
+constexpr double block_decoder::OVERHEAD_EMA_WEIGHT;
+constexpr std::size_t block_decoder::NEED_HISTORY_SIZE;
+constexpr std::size_t block_decoder::SEQNO_BITMAP_WORDS;
+
 block_decoder::block_decoder(const lt_row_generator &rg) :
   block_decoder(std::make_unique<lt_row_generator>(rg)) {
 }
@@ -17,14 +25,27 @@ block_decoder::block_decoder(std::unique_ptr<base_row_generator> &&rg) :
   basic_lg(boost::log::keywords::channel = log::basic),
   perf_lg(boost::log::keywords::channel = log::performance),
   rowgen(std::move(rg)),
+  seqno_bitmap(SEQNO_BITMAP_WORDS, 0),
+  seqno_words_used(0),
+  received_count_(0),
+  link_first(1, 0),
+  received_pkts_used(0),
   mp_ctx(rowgen->K()),
-  mp_pristine(rowgen->K()) {
-  link_cache.reserve(rowgen->K());
+  throttle_step(0),
+  overhead_est(0),
+  next_attempt(0),
+  attempt_count(0),
+  skipped_count(0),
+  need_history_next(0) {
+  link_first.reserve(rowgen->K() + 1);
+  last_received.reserve(rowgen->K());
+  need_history.reserve(NEED_HISTORY_SIZE);
+  mp_ctx.enable_xor_schedule(1);
 }
 
 void block_decoder::check_correct_block(const fountain_packet &p) {
   // First packet: set blockno, length, seed
-  if (received_seqnos.empty()) {
+  if (received_count_ == 0) {
     blockno = p.block_number();
     rowgen->reset(p.block_seed());
     pktsize = p.size();
@@ -54,23 +75,32 @@ bool block_decoder::push(const fountain_packet &p) {
 }
 
 void block_decoder::reset() {
+  // A failed block tells that more packets were needed
+  if (!has_decoded() && received_count() >= rowgen->K()) record_need(false);
   rowgen->reset();
-  received_seqnos.clear();
-  link_cache.clear();
+  std::fill(seqno_bitmap.begin(), seqno_bitmap.begin() + seqno_words_used, 0);
+  seqno_words_used = 0;
+  received_count_ = 0;
+  link_edges.clear();
+  link_first.resize(1);
   last_received.clear();
   mp_ctx.reset();
-  mp_pristine.reset();
+  received_pkts_used = 0;
   avg_mp.reset();
   avg_setup.reset();
+  attempt_count = 0;
+  skipped_count = 0;
+  next_attempt = throttle_step > 0 ?
+    static_cast<std::size_t>(std::ceil(rowgen->K() * (1 + overhead_est))) : 0;
 }
 
 block_decoder::seed_t block_decoder::seed() const {
-  if (received_seqnos.empty()) throw std::runtime_error("No received packets");
+  if (received_count_ == 0) throw std::runtime_error("No received packets");
   return rowgen->seed();
 }
 
 std::size_t block_decoder::block_number() const {
-  if (received_seqnos.empty()) throw std::runtime_error("No received packets");
+  if (received_count_ == 0) throw std::runtime_error("No received packets");
   return blockno;
 }
 
@@ -83,7 +113,7 @@ std::size_t block_decoder::decoded_count() const {
 }
 
 std::size_t block_decoder::received_count() const {
-  return mp_ctx.output_size();
+  return received_count_;
 }
 
 std::size_t block_decoder::block_size() const {
@@ -110,6 +140,214 @@ block_decoder::const_partial_iterator block_decoder::partial_end() const {
 				lazy2p_conv<LX_MAX_SIZE>());
 }
 
+void block_decoder::write_block(block_buffer &buf) const {
+  const std::size_t K = block_size();
+  if (received_count_ == 0) {
+    buf.assign(K, 0);
+    return;
+  }
+
+  buf.assign(K, pktsize);
+  std::size_t i = 0;
+  for (auto s = mp_ctx.input_symbols_begin();
+       s != mp_ctx.input_symbols_end(); ++s, ++i) {
+    if (*s) {
+      s->evaluate_into(buf.packet_data(i));
+      buf.set_present(i);
+    }
+    else {
+      std::memset(buf.packet_data(i), 0, pktsize);
+    }
+  }
+}
+
+void block_decoder::enable_elimination(std::size_t max_unknowns) {
+  mp_ctx.enable_elimination(max_unknowns);
+}
+
+std::size_t block_decoder::elimination_limit() const {
+  return mp_ctx.elimination_limit();
+}
+
+std::size_t block_decoder::eliminated_count() const {
+  return mp_ctx.eliminated_count();
+}
+
+void block_decoder::enable_xor_schedule(std::size_t threads) {
+  mp_ctx.enable_xor_schedule(threads);
+}
+
+std::size_t block_decoder::xor_schedule_threads() const {
+  return mp_ctx.xor_schedule_threads();
+}
+
+void block_decoder::enable_parallel_peeling(std::size_t threads) {
+  mp_ctx.enable_parallel_peeling(threads);
+}
+
+std::size_t block_decoder::parallel_peeling_threads() const {
+  return mp_ctx.parallel_peeling_threads();
+}
+
+void block_decoder::set_ripple_order(mp::ripple_order order,
+				     std::vector<std::size_t> priorities) {
+  mp_ctx.set_ripple_order(order, std::move(priorities));
+}
+
+mp::ripple_order block_decoder::get_ripple_order() const {
+  return mp_ctx.get_ripple_order();
+}
+
+const std::vector<std::size_t> &block_decoder::ripple_priorities() const {
+  return mp_ctx.ripple_priorities();
+}
+
+void block_decoder::set_decode_budget(std::size_t max_decoded) {
+  mp_ctx.set_decode_budget(max_decoded);
+}
+
+std::size_t block_decoder::decode_budget() const {
+  return mp_ctx.decode_budget();
+}
+
+void block_decoder::enable_attempt_throttling(double step) {
+  if (step < 0) throw std::invalid_argument("The step must be non-negative");
+  throttle_step = step;
+  next_attempt = step > 0 ?
+    static_cast<std::size_t>(std::ceil(rowgen->K() * (1 + overhead_est))) : 0;
+}
+
+double block_decoder::attempt_step() const {
+  return throttle_step;
+}
+
+double block_decoder::overhead_estimate() const {
+  return overhead_est;
+}
+
+std::size_t block_decoder::skipped_attempts() const {
+  return skipped_count;
+}
+
+bool block_decoder::run_pending() {
+  if (last_received.empty()) return false;
+  run_message_passing();
+  return true;
+}
+
+double block_decoder::success_probability(std::size_t extra) const {
+  if (has_decoded()) return 1;
+
+  const std::size_t K = rowgen->K();
+  const std::size_t recv = received_count();
+  const std::size_t total = recv + extra;
+  if (total < K) return 0;
+
+  // Each undecoded input needs at least one more equation: the
+  // buffered packets are not yet in the residual graph
+  const std::size_t unknowns = K - decoded_count();
+  const std::size_t equations = mp_ctx.residual_output_count() +
+    last_received.size();
+  if (equations + extra < unknowns) return 0;
+
+  // Previous blocks that needed more than the received packets. A
+  // failed block is not counted once `total` exceeds what it got.
+  std::size_t above = 0, within = 0, decoded = 0;
+  std::size_t min_need = std::numeric_limits<std::size_t>::max();
+  for (const need_sample &n : need_history) {
+    std::size_t need = static_cast<std::size_t>(std::ceil(n.ratio * K));
+    if (n.decoded) {
+      ++decoded;
+      min_need = std::min(min_need, need);
+      if (need > recv) {
+	++above;
+	if (need <= total) ++within;
+      }
+    }
+    else if (need >= total) {
+      ++above;
+    }
+  }
+  if (above > 0) return static_cast<double>(within) / above;
+  if (decoded == 0) return 1;
+
+  // This block already needs more than all the previous ones: assume
+  // it needs the missing equations plus the spread of the history
+  const std::size_t missing = std::max<std::size_t>(
+    unknowns > equations ? unknowns - equations : 0, 1);
+  for (const need_sample &n : need_history) {
+    if (!n.decoded) continue;
+    std::size_t need = static_cast<std::size_t>(std::ceil(n.ratio * K));
+    if (missing + (need - min_need) <= extra) ++within;
+  }
+  return static_cast<double>(within) / decoded;
+}
+
+std::size_t block_decoder::needed_estimate() const {
+  if (has_decoded()) return 0;
+
+  // The history is an empirical count that need not grow with the
+  // extra packets, so scan up to a value where it must be one. Below
+  // K received packets the probability is zero.
+  const std::size_t K = rowgen->K();
+  double max_ratio = 1;
+  for (const need_sample &n : need_history) {
+    max_ratio = std::max(max_ratio, n.ratio);
+  }
+  const std::size_t recv = received_count();
+  std::size_t extra = recv < K ? K - recv : 0;
+  std::size_t hi = K + static_cast<std::size_t>(std::ceil(max_ratio * K)) + 1;
+  for (; extra < hi; ++extra) {
+    if (success_probability(extra) >= 0.5) break;
+  }
+  return extra;
+}
+
+void block_decoder::record_need(bool decoded) {
+  need_sample n;
+  n.ratio = static_cast<double>(received_count()) / rowgen->K();
+  n.decoded = decoded;
+  if (need_history.size() < NEED_HISTORY_SIZE) {
+    need_history.push_back(n);
+  }
+  else {
+    need_history[need_history_next] = n;
+  }
+  need_history_next = (need_history_next + 1) % NEED_HISTORY_SIZE;
+}
+
+bool block_decoder::attempt_due() const {
+  return received_count() >= next_attempt;
+}
+
+void block_decoder::update_throttling() {
+  ++attempt_count;
+  if (throttle_step <= 0) return;
+
+  const double K = rowgen->K();
+  const std::size_t recv = received_count();
+  if (mp_ctx.has_decoded()) {
+    // A success at the first attempt does not tell how many packets
+    // were really needed: lower the estimate by one step
+    double overhead = recv / K - 1;
+    if (attempt_count == 1) overhead -= throttle_step;
+    overhead_est += OVERHEAD_EMA_WEIGHT * (std::max(overhead, 0.0) - overhead_est);
+  }
+  else {
+    next_attempt = std::max(recv + 1, static_cast<std::size_t>(
+			      std::ceil(recv * (1 + throttle_step))));
+  }
+}
+
+void block_decoder::set_decoded_callback(decoded_callback cb) {
+  decoded_cb = std::move(cb);
+}
+
+const block_decoder::decoded_callback &
+block_decoder::get_decoded_callback() const {
+  return decoded_cb;
+}
+
 double block_decoder::average_message_passing_time() const {
   return avg_mp.value();
 }
@@ -129,25 +367,39 @@ bool block_decoder::operator!() const {
 void block_decoder::run_message_passing() {
   auto tic = high_resolution_clock::now();
 
-  for (auto i = last_received.cbegin(); i != last_received.cend(); ++i) {
-    // Update the context
-    const base_row_generator::row_type &row = link_cache[i->sequence_number()];
-    mp_pristine.add_output(sym_t(std::move(i->buffer())), row.cbegin(), row.cend());
+  for (auto i = last_received.begin(); i != last_received.end(); ++i) {
+    // Update the context: the new packets are reduced by the
+    // already decoded ones. Only the shared data is moved.
+    std::size_t seqno = i->sequence_number();
+    auto row_begin = link_edges.cbegin() + link_first[seqno];
+    auto row_end = link_edges.cbegin() + link_first[seqno+1];
+    if (received_pkts_used == received_pkts.size()) received_pkts.emplace_back();
+    packet &slot = received_pkts[received_pkts_used++];
+    slot = std::move(*i);
+    mp_ctx.add_output(sym_t(&slot), row_begin, row_end);
   }
   last_received.clear();
 
-  // Run on a copy
-  mp_ctx = mp_pristine;
-
   duration<double> mp_tdiff = high_resolution_clock::now() - tic;
 
   BOOST_LOG(perf_lg) << "block_decoder::run_message_passing mp_setup_time="
 		     << mp_tdiff.count();
 
+  // Bind the callback to the current position of this decoder
+  if (decoded_cb) {
+    mp_ctx.set_decoded_callback([this](std::size_t i, const sym_t &s) {
+	decoded_cb(blockno, i, lazy2p_conv<LX_MAX_SIZE>()(s));
+      });
+  }
+  else {
+    mp_ctx.set_decoded_callback(nullptr);
+  }
   mp_ctx.run();
 
   avg_setup.add_sample(mp_tdiff.count());
   avg_mp.add_sample(mp_ctx.run_duration());
+  update_throttling();
+  if (mp_ctx.has_decoded()) record_need(true);
 
   BOOST_LOG(perf_lg) << "block_decoder::run_message_passing decoded_pkts="
 		     << mp_ctx.decoded_count()
@@ -1,10 +1,12 @@
 #ifndef UEP_BLOCK_DECODER_HPP
 #define UEP_BLOCK_DECODER_HPP
 
-#include <forward_list>
-#include <set>
+#include <cstdint>
+#include <deque>
+#include <functional>
 #include <vector>
 
+#include "block_queues.hpp"
 #include "counter.hpp"
 #include "lazy_xor.hpp"
 #include "log.hpp"
@@ -15,18 +17,17 @@
 
 namespace uep {
 
-/** Converter to evaluate lazy_xors into packets. */
+/** Converter to evaluate lazy_xors into packets. The evaluation is
+ *  memoized by the lazy_xor, so the returned reference is valid as
+ *  long as the symbol is not modified. All the empty symbols are
+ *  converted to the same empty packet.
+ */
 template <std::size_t MAX_SIZE>
 struct lazy2p_conv {
-  packet operator()(const lazy_xor<buffer_type,MAX_SIZE> &lx) const {
-    if (lx) {
-      packet p;
-      p.buffer() = lx.evaluate();
-      return p;
-    }
-    else {
-      return packet();
-    }
+  const packet &operator()(const lazy_xor<packet,MAX_SIZE> &lx) const {
+    static const packet empty_pkt;
+    if (lx) return lx.evaluate();
+    else return empty_pkt;
   }
 };
 
@@ -40,15 +41,16 @@ using lazy2p_iterator = boost::transform_iterator<lazy2p_conv<MAX_SIZE>, BaseIte
  */
 class block_decoder {
 private:
-  /** Max size for the lazy_xors. */
+  /** Max size for the lazy_xors. Larger values were slower: a
+   *  decoded symbol with pending XORs repeats them in every output it
+   *  is XORed into.
+   */
   static constexpr std::size_t LX_MAX_SIZE = 1;
 
   /** Type of the symbols used for the mp algorithm. */
-  typedef lazy_xor<buffer_type,LX_MAX_SIZE> sym_t;
+  typedef lazy_xor<packet,LX_MAX_SIZE> sym_t;
   /** Type of the underlying message passing context. */
   typedef mp::mp_context<sym_t> mp_ctx_t;
-  /** Type of the container used to cache the row generator output. */
-  typedef std::vector<base_row_generator::row_type> link_cache_t;
 
 public:
   /** Iterator over the input packets, either decoded or empty. */
@@ -59,6 +61,10 @@ public:
 			  LX_MAX_SIZE> const_block_iterator;
   /** Type of the seed used by the row generator. */
   typedef lt_row_generator::rng_type::result_type seed_t;
+  /** Function called with the block number, the position in the
+   *  block and the value of each decoded input packet.
+   */
+  typedef std::function<void(std::size_t, std::size_t, const packet&)> decoded_callback;
 
   /** Construct with a copy of the given lt_row_generator. */
   explicit block_decoder(const lt_row_generator &rg);
@@ -120,12 +126,109 @@ public:
    */
   const_partial_iterator partial_end() const;
 
+  /** Write the partially decoded block to `buf`, evaluating each
+   *  decoded packet directly in its position. The missing packets are
+   *  zeroed. The storage of `buf` is reused, so no packet is
+   *  allocated.
+   */
+  void write_block(block_buffer &buf) const;
+
+  /** Solve the residual system by Gaussian elimination when the
+   *  message passing stalls with at most `max_unknowns` missing input
+   *  packets. 0 disables it. \sa mp::mp_context::enable_elimination
+   */
+  void enable_elimination(std::size_t max_unknowns);
+  /** Return the limit set by enable_elimination(). */
+  std::size_t elimination_limit() const;
+  /** Number of input packets of the current block decoded by the
+   *  Gaussian elimination.
+   */
+  std::size_t eliminated_count() const;
+
+  /** Execute the XORs of the message passing after the peeling, with
+   *  the given number of threads. 0 XORs the packets during the
+   *  peeling. The default is 1.
+   *  \sa mp::mp_context::enable_xor_schedule
+   */
+  void enable_xor_schedule(std::size_t threads);
+  /** Return the value set by enable_xor_schedule(). */
+  std::size_t xor_schedule_threads() const;
+  /** Peel the large blocks with the given number of threads.
+   *  \sa mp::mp_context::enable_parallel_peeling
+   */
+  void enable_parallel_peeling(std::size_t threads);
+  /** Return the value set by enable_parallel_peeling(). */
+  std::size_t parallel_peeling_threads() const;
+
+  /** Set the order in which the message passing processes the ripple.
+   *  \sa mp::mp_context::set_ripple_order
+   */
+  void set_ripple_order(mp::ripple_order order,
+			std::vector<std::size_t> priorities = {});
+  /** Return the order set by set_ripple_order(). */
+  mp::ripple_order get_ripple_order() const;
+  /** Return the priorities set by set_ripple_order(). */
+  const std::vector<std::size_t> &ripple_priorities() const;
+  /** Limit the number of packets decoded after each push. The
+   *  following pushes resume the decoding.
+   *  \sa mp::mp_context::set_decode_budget
+   */
+  void set_decode_budget(std::size_t max_decoded);
+  /** Return the budget set by set_decode_budget(). */
+  std::size_t decode_budget() const;
+
+  /** Call `cb` as soon as each input packet is decoded, before the
+   *  whole block is available. An empty function disables it.
+   *  \sa mp::mp_context::set_decoded_callback
+   */
+  void set_decoded_callback(decoded_callback cb);
+  /** Return the function set by set_decoded_callback(). */
+  const decoded_callback &get_decoded_callback() const;
+
+  /** Skip the decoding attempts that are unlikely to succeed. The
+   *  message passing is first run when the received packets reach
+   *  K*(1+e), where e is the overhead learned from the previous
+   *  blocks, then each time their number grows by a factor
+   *  (1+step). The packets received in between are buffered. A step
+   *  of 0 runs the message passing after every push, which is the
+   *  default. \sa run_pending()
+   */
+  void enable_attempt_throttling(double step);
+  /** Return the step set by enable_attempt_throttling(). */
+  double attempt_step() const;
+  /** Return the overhead learned from the decoded blocks. */
+  double overhead_estimate() const;
+  /** Return the number of decoding attempts skipped by the throttling
+   *  since the last reset.
+   */
+  std::size_t skipped_attempts() const;
+  /** Run the message passing on the packets that are still buffered
+   *  by the throttling. Return true if there were any.
+   */
+  bool run_pending();
+
+  /** Estimate the probability that the current block is decoded once
+   *  `extra` more unique packets are received. The estimate uses the
+   *  number of packets needed by the last blocks, given that the
+   *  current one is still undecoded, and is zero when the residual
+   *  graph has too few equations left. A block reset undecoded after
+   *  receiving at least K packets counts as needing more than it
+   *  received. Before the first such block only the residual graph is
+   *  used.
+   */
+  double success_probability(std::size_t extra) const;
+  /** Estimate how many more unique packets are needed to decode the
+   *  current block: the smallest number for which
+   *  success_probability() is at least one half.
+   */
+  std::size_t needed_estimate() const;
+
   /** Return the average time to run message passing measured since
    *  the last reset.
    */
   double average_message_passing_time() const;
-  /** Return the average time to setup the mp context measured since
-   *  the last reset.
+  /** Return the average time to add the received packets to the mp
+   *  context measured since the last reset.
    */
   double average_mp_setup_time() const;
 
@@ -140,36 +243,123 @@ private:
   log::default_logger basic_lg, perf_lg;
 
   std::unique_ptr<base_row_generator> rowgen;
-  std::set<std::size_t> received_seqnos;
-  link_cache_t link_cache;
-  std::forward_list<fountain_packet> last_received;
+  std::vector<std::uint64_t> seqno_bitmap; /**< One bit for each
+					    *   sequence number, set
+					    *   when it is received.
+					    */
+  std::size_t seqno_words_used; /**< Number of words of seqno_bitmap
+				 *   that can be non-zero.
+				 */
+  std::size_t received_count_; /**< Number of bits set in
+				*   seqno_bitmap.
+				*/
+  /** Words allocated upfront in seqno_bitmap: enough for the
+   *  sequence numbers of the LT encoders. It grows for larger ones.
+   */
+  static constexpr std::size_t SEQNO_BITMAP_WORDS = 0x10000 / 64;
+  base_row_generator::row_type link_edges; /**< Rows of the
+					    *   generated seqnos, one
+					    *   after the other.
+					    */
+  std::vector<std::size_t> link_first; /**< Start of the row of each
+					*   seqno in link_edges, plus
+					*   the end of the last one.
+					*/
+  base_row_generator::row_type row_buf; /**< Buffer filled by the row
+					 *   generator.
+					 */
+  std::vector<fountain_packet> last_received; /**< Packets not yet
+					       *   added to mp_ctx.
+					       */
+  std::deque<packet> received_pkts; /**< Arena that holds the data of
+				     *   the packets added to mp_ctx,
+				     *   which the symbols point to.
+				     *   The slots are reused after a
+				     *   reset.
+				     */
+  std::size_t received_pkts_used; /**< Slots of received_pkts in use. */
   mp_ctx_t mp_ctx; /**< Context used to run the mp algorithm and hold
-		    *   the result.
+		    *   the result. The received packets are added to
+		    *   it as they arrive and the peeling resumes from
+		    *   the previous state.
 		    */
-  mp_ctx_t mp_pristine; /**< Keep a version of the context that was
-			 *   never "runned".
-			 */
   std::size_t blockno;
   std::size_t pktsize;
+  decoded_callback decoded_cb; /**< Called for each decoded packet. */
+
+  double throttle_step; /**< Growth factor between the decoding
+			 *   attempts, or 0.
+			 */
+  double overhead_est; /**< Moving average of the overhead needed by
+			*   the previous blocks. It is kept across
+			*   resets.
+			*/
+  std::size_t next_attempt; /**< Received count that triggers the
+			     *   next attempt.
+			     */
+  std::size_t attempt_count; /**< Attempts made on this block. */
+  std::size_t skipped_count; /**< Attempts skipped on this block. */
+
+  /** Weight of the last block in overhead_est. */
+  static constexpr double OVERHEAD_EMA_WEIGHT = 0.25;
+
+  /** Packets received by a past block. */
+  struct need_sample {
+    double ratio; /**< Received packets over K. */
+    bool decoded; /**< False when the block needed more than ratio*K
+		   *   packets.
+		   */
+  };
+  std::vector<need_sample> need_history; /**< Samples of the last
+					  *   blocks. It is kept
+					  *   across resets.
+					  */
+  std::size_t need_history_next; /**< Next entry of need_history to
+				  *   overwrite.
+				  */
+  /** Number of blocks kept in need_history. */
+  static constexpr std::size_t NEED_HISTORY_SIZE = 64;
 
   stat::average_counter avg_mp; /**< Average time to run the message
 				 *   passing algorithm.
 				 */
-  stat::average_counter avg_setup; /**< Average time to setup
-				    *	mp_ctx before each run.
+  stat::average_counter avg_setup; /**< Average time to add the
+				    *	received packets to mp_ctx
+				    *	before each run.
 				    */
 
   /** Check the blockno, seqno and seed of the packet and raise an
    *  exception if they don't match the current block.
    */
   void check_correct_block(const fountain_packet &p);
+  /** Mark a sequence number as received. Return false if it was
+   *  already received.
+   */
+  bool mark_received(std::size_t seqno);
   /** Run the message passing algortihm over the currently received
    *  packets.
    */
   void run_message_passing();
+  /** True if the throttling allows to run the message passing. */
+  bool attempt_due() const;
+  /** Update the throttling after an attempt. */
+  void update_throttling();
+  /** Add the packets received by the current block to need_history. */
+  void record_need(bool decoded);
 };
 
 //		  block_decoder template definitions
+inline bool block_decoder::mark_received(std::size_t seqno) {
+  const std::size_t word = seqno / 64;
+  const std::uint64_t mask = std::uint64_t(1) << (seqno % 64);
+  if (word >= seqno_bitmap.size()) seqno_bitmap.resize(word + 1, 0);
+  if (word >= seqno_words_used) seqno_words_used = word + 1;
+  if (seqno_bitmap[word] & mask) return false;
+  seqno_bitmap[word] |= mask;
+  ++received_count_;
+  return true;
+}
+
 template <class Iter>
 std::size_t block_decoder::push(Iter in_first, Iter in_last) {
   // Ignore packets after successful decoding
@@ -180,32 +370,32 @@ std::size_t block_decoder::push(Iter in_first, Iter in_last) {
   std::size_t pushed = 0;
   std::size_t max_seqno = 0;
   for (auto i = in_first; i != in_last; ++i) {
-    fountain_packet p(*i);
-    check_correct_block(p);
-    size_t p_seqno = p.sequence_number();
-
-    auto ins_ret = received_seqnos.insert(p_seqno);
-    // Ignore duplicates
-    if (!ins_ret.second) {
-      break;
+    const fountain_packet &in_p = *i;
+    check_correct_block(in_p);
+    size_t p_seqno = in_p.sequence_number();
+
+    // Ignore duplicates before copying them
+    if (!mark_received(p_seqno)) {
+      continue;
     }
 
-    last_received.push_front(std::move(p));
+    last_received.push_back(fountain_packet(*i));
     ++pushed;
     if (max_seqno < p_seqno)
       max_seqno = p_seqno;
   }
 
   // Generate enough output links
-  if (link_cache.size() <= max_seqno) {
-    size_t prev_size = link_cache.size();
-    link_cache.resize(max_seqno+1);
-    for (size_t i = prev_size; i < max_seqno+1; ++i) {
-      link_cache[i] = rowgen->next_row();
-    }
+  while (link_first.size() < max_seqno+2) {
+    rowgen->fill_row(row_buf);
+    link_edges.insert(link_edges.end(), row_buf.cbegin(), row_buf.cend());
+    link_first.push_back(link_edges.size());
   }
 
-  if (pushed > 0) run_message_passing();
+  if (pushed > 0) {
+    if (attempt_due()) run_message_passing();
+    else ++skipped_count;
+  }
   return pushed;
 }
 
@@ -1,5 +1,8 @@
 #include "block_encoder.hpp"
 
+#include <algorithm>
+#include <limits>
+
 using namespace std;
 
 namespace uep {
@@ -11,7 +14,10 @@ block_encoder::block_encoder(const lt_row_generator &rg) :
 block_encoder::block_encoder(std::unique_ptr<base_row_generator> &&rg) :
   basic_lg(boost::log::keywords::channel = log::basic),
   perf_lg(boost::log::keywords::channel = log::performance),
-  rowgen(std::move(rg)), out_count(0) {
+  rowgen(std::move(rg)), out_count(0),
+  cache_max_bytes(0), cache_bytes(0),
+  tot_xors(0), tot_saved_xors(0),
+  cache_lookups(0), cache_hits(0) {
   block.reserve(rowgen->K());
 }
 
@@ -21,14 +27,25 @@ void block_encoder::set_seed(seed_t seed) {
   rowgen->reset(seed);
 }
 
+void block_encoder::set_block_shallow(const_block_span blk) {
+  if (blk.size() != block_size())
+    throw std::logic_error("The block must have fixed length");
+  block.clear();
+  block_view = blk;
+  out_count = 0;
+  clear_xor_cache();
+}
+
 void block_encoder::reset() {
   rowgen->reset();
   block.clear();
+  block_view = const_block_span();
   out_count = 0;
+  clear_xor_cache();
 }
 
 bool block_encoder::can_encode() const {
-  return block.size() == rowgen->K();
+  return block_view.size() == rowgen->K();
 }
 
 block_encoder::seed_t block_encoder::seed() const {
@@ -36,11 +53,11 @@ block_encoder::seed_t block_encoder::seed() const {
 }
 
 block_encoder::const_block_iterator block_encoder::block_begin() const {
-  return block.cbegin();
+  return block_view.begin();
 }
 
 block_encoder::const_block_iterator block_encoder::block_end() const {
-  return block.cend();
+  return block_view.end();
 }
 
 std::size_t block_encoder::block_size() const {
@@ -55,19 +72,113 @@ std::size_t block_encoder::output_count() const {
   return out_count;
 }
 
+void block_encoder::skip_rows(std::size_t n) {
+  if (!can_encode())
+    throw std::logic_error("Does not have a block");
+  for (std::size_t i = 0; i < n; ++i) {
+    rowgen->next_row();
+  }
+  out_count += n;
+}
+
 packet block_encoder::next_coded() {
   if (!can_encode())
     throw std::logic_error("Does not have a block");
   base_row_generator::row_type row = rowgen->next_row();
+  ++out_count;
+  if (cache_max_bytes > 0) return next_coded_cached(row);
+
   auto i = row.cbegin();
-  packet first(block[*i++]);
+  packet first(block_view[*i++]);
   for (; i != row.cend(); ++i) {
-    first ^= block[*i];
+    first ^= block_view[*i];
   }
-  ++out_count;
+  tot_xors += row.size() - 1;
   return first;
 }
 
+packet block_encoder::next_coded_cached(base_row_generator::row_type &row) {
+  // Pair the adjacent indices of the sorted row
+  std::sort(row.begin(), row.end());
+
+  packet out;
+  bool has_out = false;
+  auto add = [this, &out, &has_out](const packet &p) {
+    if (has_out) {
+      out ^= p;
+      ++tot_xors;
+    }
+    else {
+      out = p;
+      has_out = true;
+    }
+  };
+
+  std::size_t k = 0;
+  while (k < row.size()) {
+    if (k + 1 < row.size()) {
+      std::size_t key = row[k] * block_size() + row[k+1];
+      ++cache_lookups;
+      auto c = xor_cache.find(key);
+      if (c != xor_cache.end()) {
+	++cache_hits;
+	++tot_saved_xors;
+	add(c->second);
+	k += 2;
+	continue;
+      }
+
+      std::size_t &cnt = pair_counts[key];
+      ++cnt;
+      const packet &a = block_view[row[k]];
+      if (cnt > 1 && cache_bytes + a.size() <= cache_max_bytes) {
+	// Seen again: store the XOR of the pair
+	packet pair_xor(a);
+	pair_xor ^= block_view[row[k+1]];
+	++tot_xors;
+	cache_bytes += pair_xor.size();
+	add(pair_xor);
+	xor_cache.emplace(key, std::move(pair_xor));
+	k += 2;
+	continue;
+      }
+    }
+
+    add(block_view[row[k]]);
+    ++k;
+  }
+
+  return out;
+}
+
+void block_encoder::enable_xor_cache(std::size_t max_bytes) {
+  cache_max_bytes = max_bytes;
+  clear_xor_cache();
+}
+
+std::size_t block_encoder::xor_cache_max_size() const {
+  return cache_max_bytes;
+}
+
+std::size_t block_encoder::xor_count() const {
+  return tot_xors;
+}
+
+std::size_t block_encoder::saved_xor_count() const {
+  return tot_saved_xors;
+}
+
+double block_encoder::xor_cache_hit_rate() const {
+  if (cache_lookups == 0) return std::numeric_limits<double>::quiet_NaN();
+  return static_cast<double>(cache_hits) / cache_lookups;
+}
+
+void block_encoder::clear_xor_cache() {
+  pair_counts.clear();
+  xor_cache.clear();
+  cache_bytes = 0;
+}
+
 block_encoder::operator bool() const {
   return can_encode();
 }
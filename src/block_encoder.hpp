@@ -1,11 +1,13 @@
 #ifndef UEP_BLOCK_ENCODER
 #define UEP_BLOCK_ENCODER
 
+#include <unordered_map>
 #include <vector>
 
 #include "log.hpp"
 #include "packets.hpp"
 #include "rng.hpp"
+#include "span.hpp"
 
 namespace uep {
 
@@ -13,12 +15,18 @@ namespace uep {
  * The LT-code parameters are given by the lt_row_generator passed to
  * the constructor. The seed for the row generator is manipulated
  * through seed() and set_seed(seed_t).
+ *
+ * The encoder can optionally cache the XOR of pairs of input packets
+ * that appear together in more than one row of the same block, up to
+ * a maximum amount of memory. This is useful with the UEP row
+ * generators, where the packets with higher priority are selected
+ * much more often. \sa enable_xor_cache()
  */
 class block_encoder {
 public:
   typedef base_row_generator::rng_type::result_type seed_t;
-  typedef std::vector<packet>::const_iterator const_block_iterator;
-  typedef std::vector<packet>::iterator block_iterator;
+  typedef const packet *const_block_iterator;
+  typedef utils::span<const packet> const_block_span;
 
   /** Construct using a copy of the given lt_row_generator. */
   explicit block_encoder(const lt_row_generator &rg);
@@ -30,9 +38,11 @@ public:
   /** Replace the current block with [first,last). */
   template <class InputIt>
   void set_block(InputIt first, InputIt last);
-  /** Replace the current block by shallow-copying [first,last). */
-  template <class InputIt>
-  void set_block_shallow(InputIt first, InputIt last);
+  /** Use the packets viewed by `blk` as the current block, without
+   *  copying them. The packets must not be modified or destroyed
+   *  until the block is replaced or the encoder is reset.
+   */
+  void set_block_shallow(const_block_span blk);
   /** Reset the encoder to the initial state: default seed and empty block. */
   void reset();
 
@@ -54,6 +64,28 @@ public:
 
   /** Produce a new encoded packet. */
   packet next_coded();
+  /** Advance the row generator by `n` rows without encoding, as if
+   *  next_coded() was called `n` times.
+   */
+  void skip_rows(std::size_t n);
+
+  /** Cache the XOR of the pairs of input packets that are used more
+   *  than once in the current block, using at most `max_bytes` of
+   *  packet data. A value of 0 disables the cache.
+   */
+  void enable_xor_cache(std::size_t max_bytes);
+  /** Return the maximum size of the XOR cache in bytes. */
+  std::size_t xor_cache_max_size() const;
+  /** Return the total number of packet XORs performed. */
+  std::size_t xor_count() const;
+  /** Return the total number of packet XORs avoided by using the
+   *  cache.
+   */
+  std::size_t saved_xor_count() const;
+  /** Return the fraction of the pair lookups that found a cached
+   *  XOR. If there were no lookups return NaN.
+   */
+  double xor_cache_hit_rate() const;
 
   /** Return true when the encoder has a block. */
   explicit operator bool() const;
@@ -64,8 +96,27 @@ private:
   log::default_logger basic_lg, perf_lg;
 
   std::unique_ptr<base_row_generator> rowgen;
-  std::vector<packet> block;
+  std::vector<packet> block; /**< Holds the copies made by set_block. */
+  const_block_span block_view; /**< The packets that are encoded. */
   std::size_t out_count;
+
+  std::size_t cache_max_bytes; /**< Memory limit for the XOR cache. */
+  std::size_t cache_bytes; /**< Memory used by the XOR cache. */
+  /** Number of times each pair was seen in the current block. */
+  std::unordered_map<std::size_t, std::size_t> pair_counts;
+  /** XOR of the pairs that were seen more than once. */
+  std::unordered_map<std::size_t, packet> xor_cache;
+  std::size_t tot_xors; /**< Total number of XORs performed. */
+  std::size_t tot_saved_xors; /**< Total number of XORs avoided. */
+  std::size_t cache_lookups; /**< Total number of pair lookups. */
+  std::size_t cache_hits; /**< Total number of pair lookups that
+			   *   found a cached XOR.
+			   */
+
+  /** Produce a new encoded packet using the XOR cache. */
+  packet next_coded_cached(base_row_generator::row_type &row);
+  /** Drop the cached XORs and the pair counts. */
+  void clear_xor_cache();
 };
 
 		    //// Template definitions ////
@@ -73,7 +124,9 @@ private:
 template <class InputIt>
 void block_encoder::set_block(InputIt first, InputIt last) {
   block.clear();
+  block_view = const_block_span();
   out_count = 0;
+  clear_xor_cache();
   std::size_t c = 0;
   for (;first != last; ++first) {
     block.push_back(*first);
@@ -83,21 +136,7 @@ void block_encoder::set_block(InputIt first, InputIt last) {
     block.clear();
     throw std::logic_error("The block must have fixed length");
   }
-}
-
-template <class InputIt>
-void block_encoder::set_block_shallow(InputIt first, InputIt last) {
-  block.clear();
-  out_count = 0;
-  std::size_t c = 0;
-  for (;first != last; ++first) {
-    block.push_back(first->shallow_copy());
-    ++c;
-  }
-  if (c != block_size()) {
-    block.clear();
-    throw std::logic_error("The block must have fixed length");
-  }
+  block_view = const_block_span(block.data(), block.size());
 }
 
 }
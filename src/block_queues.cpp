@@ -39,3 +39,63 @@ output_block_queue::operator bool() const {
 bool output_block_queue::operator!() const {
   return empty();
 }
+
+namespace uep {
+
+block_buffer::block_buffer() :
+  K(0), pktsize(0), present_cnt(0) {
+}
+
+void block_buffer::assign(std::size_t block_size, std::size_t pkt_size) {
+  K = block_size;
+  pktsize = pkt_size;
+  if (buf.size() < K * pktsize) buf.resize(K * pktsize);
+  present.assign(K, false);
+  present_cnt = 0;
+}
+
+void block_buffer::set_present(std::size_t i) {
+  if (!present.at(i)) {
+    present[i] = true;
+    ++present_cnt;
+  }
+}
+
+std::size_t block_buffer::block_size() const {
+  return K;
+}
+
+std::size_t block_buffer::packet_size() const {
+  return pktsize;
+}
+
+std::size_t block_buffer::present_count() const {
+  return present_cnt;
+}
+
+bool block_buffer::has_packet(std::size_t i) const {
+  return present.at(i);
+}
+
+char *block_buffer::packet_data(std::size_t i) {
+  return buf.data() + i * pktsize;
+}
+
+const char *block_buffer::packet_data(std::size_t i) const {
+  return buf.data() + i * pktsize;
+}
+
+utils::span<const char> block_buffer::packet_span(std::size_t i) const {
+  if (i >= K) throw std::out_of_range("Packet index out of range");
+  return utils::span<const char>(packet_data(i), pktsize);
+}
+
+const char *block_buffer::data() const {
+  return buf.data();
+}
+
+std::size_t block_buffer::size() const {
+  return K * pktsize;
+}
+
+}
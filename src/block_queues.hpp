@@ -1,26 +1,39 @@
 #ifndef UEP_BLOCK_QUEUES_HPP
 #define UEP_BLOCK_QUEUES_HPP
 
+#include <algorithm>
 #include <cstddef>
+#include <iterator>
+#include <memory>
 #include <queue>
 #include <stdexcept>
 #include <vector>
 
 #include "packets.hpp"
+#include "span.hpp"
 
 namespace uep {
 
 /** Class used to segment a stream in fixed-length blocks.  The
  *  elements are enqueued using push() and, when has_block() is true,
- *  a block can be accessed using a pair of iterators or by position.
+ *  a block can be accessed using a pair of iterators, by position or
+ *  as a span.
+ *
+ *  The elements are stored in a ring of block-sized arrays of slots,
+ *  so each block occupies K consecutive slots. Popping a block only
+ *  advances the head of the ring: the elements are neither moved nor
+ *  destroyed until their slots are reused. When the ring is full it
+ *  grows by adding new arrays, without moving the existing elements,
+ *  so a view over the current block stays valid until it is popped.
  */
 template <class T>
 class block_queue {
 public:
   typedef T value_type;
-  typedef typename std::vector<T>::iterator block_iterator;
-  typedef typename std::vector<T>::const_iterator const_block_iterator;
+  typedef T *block_iterator;
+  typedef const T *const_block_iterator;
   typedef std::move_iterator<block_iterator> move_block_iterator;
+  typedef utils::span<const T> const_block_span;
 
   explicit block_queue(std::size_t block_size);
 
@@ -30,8 +43,14 @@ public:
   void push(const T &p);
   /** Remove the current block. If there is no block, raise a logic_error. */
   void pop_block();
+  /** Remove the current block and the following n-1 blocks at
+   *  once. If there are less than n blocks, raise a logic_error.
+   */
+  void pop_blocks(std::size_t n);
   /** Remove all elements. */
   void clear();
+  /** Remove the last elements that do not form a full block. */
+  void drop_partial_block();
 
   /** Return true when there are enough elements to form a block. */
   bool has_block() const;
@@ -47,7 +66,19 @@ public:
   std::size_t queue_size() const;
   /** The total number of elements held by the block_queue. */
   std::size_t size() const;
+  /** The number of full blocks, including the current one. */
+  std::size_t block_count() const;
 
+  /** Return a view over the K elements of the current block. The
+   *  view is valid until the block is popped. If there is no block,
+   *  a logic_error is raised.
+   */
+  const_block_span block() const;
+  /** Return a view over the n-th full block, counting from the
+   *  current one. The view is valid until the block is popped. If
+   *  there are not enough blocks, a logic_error is raised.
+   */
+  const_block_span block(std::size_t n) const;
   /** Constant random iterator pointing to the start of the block.
    *  If there is no block, a logic_error is raised.
    */
@@ -60,6 +91,12 @@ public:
    *  block.  If there is no block, a logic_error is raised.
    */
   const T &block_at(std::size_t pos) const;
+  /** Return a const reference to the element at position pos,
+   *  counting from the start of the current block. This also reaches
+   *  the queued elements after the current block and does not
+   *  require a full block.
+   */
+  const T &at(std::size_t pos) const;
   /** Move-iterator pointing to the start of the block. */
   move_block_iterator block_mbegin();
   /** Move-iterator pointing to the end of the block. */
@@ -72,11 +109,67 @@ public:
 
 private:
   std::size_t K;
-  std::queue<T> input_queue;
-  std::vector<T> input_block;
+  std::vector<std::unique_ptr<T[]>> ring; /**< Arrays of K slots. */
+  std::size_t first; /**< Index of the array holding the current
+		      *   block.
+		      */
+  std::size_t count; /**< Number of elements stored starting from
+		      *   the first array.
+		      */
+
+  /** Double the number of arrays in the ring. */
+  void grow();
+  /** Throw a logic_error if there is no block. */
+  void check_has_block() const;
+};
+
+/** Block of K packets of the same size stored in a single contiguous
+ *  buffer. Each packet is either present or missing, the bytes of
+ *  the missing packets are zero. The storage is kept across the calls
+ *  to assign(), so a buffer reused for the blocks of a stream
+ *  allocates only when the block grows.
+ */
+class block_buffer {
+public:
+  /** Construct an empty buffer with no packets. */
+  block_buffer();
+
+  /** Make room for `block_size` packets of `pkt_size` bytes, all
+   *  missing. The previous content is lost.
+   */
+  void assign(std::size_t block_size, std::size_t pkt_size);
+  /** Mark the packet `i` as present. */
+  void set_present(std::size_t i);
 
-  /** Check if the queue has enough elements to build a block. */
-  void check_has_block();
+  /** Return the number of packets in the block. */
+  std::size_t block_size() const;
+  /** Return the size of each packet. */
+  std::size_t packet_size() const;
+  /** Return the number of present packets. */
+  std::size_t present_count() const;
+  /** True when the packet `i` is present. */
+  bool has_packet(std::size_t i) const;
+
+  /** Pointer to the first byte of the packet `i`. */
+  char *packet_data(std::size_t i);
+  /** Pointer to the first byte of the packet `i`. */
+  const char *packet_data(std::size_t i) const;
+  /** View over the bytes of the packet `i`. */
+  utils::span<const char> packet_span(std::size_t i) const;
+
+  /** Pointer to the first byte of the block. */
+  const char *data() const;
+  /** Size in bytes of the block. */
+  std::size_t size() const;
+
+private:
+  std::size_t K; /**< Number of packets. */
+  std::size_t pktsize; /**< Size of each packet. */
+  buffer_type buf; /**< Storage for the packets. Its size can be
+		    *   larger than K*pktsize.
+		    */
+  std::vector<bool> present; /**< Present flag of each packet. */
+  std::size_t present_cnt; /**< Number of present packets. */
 };
 
 }
@@ -150,7 +243,9 @@ template <class InputIt>
 void output_block_queue::push_shallow(InputIt first, InputIt last) {
   std::size_t count = 0;
   for (;first != last; ++first) {
-    output_queue.push(first->shallow_copy());
+    // Empty packets may all share the same data
+    if (first->empty()) output_queue.push(packet());
+    else output_queue.push(first->shallow_copy());
     ++count;
   }
   if (count != K)
@@ -163,14 +258,15 @@ namespace uep {
 
 template <class T>
 block_queue<T>::block_queue(std::size_t block_size):
-  K(block_size) {
-  input_block.reserve(K);
+  K(block_size), first(0), count(0) {
 }
 
 template <class T>
 void block_queue<T>::push(T &&p) {
-  input_queue.push(std::move(p));
-  check_has_block();
+  std::size_t n = count / K;
+  if (n == ring.size()) grow();
+  ring[(first + n) % ring.size()][count % K] = std::move(p);
+  ++count;
 }
 
 template <class T>
@@ -181,61 +277,91 @@ void block_queue<T>::push(const T &p) {
 
 template <class T>
 bool block_queue<T>::has_block() const {
-  return input_block.size() == K;
+  return count >= K;
 }
 
 template <class T>
 bool block_queue<T>::empty() const {
-  return input_queue.empty() && input_block.empty();
+  return count == 0;
 }
 
 template <class T>
 void block_queue<T>::pop_block() {
   if (!has_block())
     throw std::logic_error("Cannot pop without a full block");
-  input_block.clear();
+  first = (first + 1) % ring.size();
+  count -= K;
+}
+
+template <class T>
+void block_queue<T>::pop_blocks(std::size_t n) {
+  if (n == 0) return;
+  if (count < n * K)
+    throw std::logic_error("Cannot pop without enough full blocks");
+  first = (first + n) % ring.size();
+  count -= n * K;
+}
+
+template <class T>
+typename block_queue<T>::const_block_span
+block_queue<T>::block() const {
   check_has_block();
+  return const_block_span(ring[first].get(), K);
+}
+
+template <class T>
+typename block_queue<T>::const_block_span
+block_queue<T>::block(std::size_t n) const {
+  if (n >= block_count()) throw std::logic_error("Does not have the block");
+  return const_block_span(ring[(first + n) % ring.size()].get(), K);
 }
 
 template <class T>
 typename block_queue<T>::const_block_iterator
 block_queue<T>::block_begin() const {
-  if (!has_block()) throw std::logic_error("Does not have a block");
-  return input_block.cbegin();
+  return block().begin();
 }
 
 template <class T>
 typename block_queue<T>::const_block_iterator
 block_queue<T>::block_end() const {
-  if (!has_block()) throw std::logic_error("Does not have a block");
-  return input_block.cend();
+  return block().end();
 }
 
 template <class T>
 const T &block_queue<T>::block_at(std::size_t pos) const {
-  if (!has_block()) throw std::logic_error("Does not have a block");
-  return input_block.at(pos);
+  return block().at(pos);
+}
+
+template <class T>
+const T &block_queue<T>::at(std::size_t pos) const {
+  if (pos >= count) throw std::out_of_range("Position out of range");
+  return ring[(first + pos / K) % ring.size()][pos % K];
 }
 
 template <class T>
 typename block_queue<T>::move_block_iterator
 block_queue<T>::block_mbegin() {
-  if (!has_block()) throw std::logic_error("Does not have a block");
-  return move_block_iterator(input_block.begin());
+  check_has_block();
+  return move_block_iterator(ring[first].get());
 }
 
 template <class T>
 typename block_queue<T>::move_block_iterator
 block_queue<T>::block_mend() {
-  if (!has_block()) throw std::logic_error("Does not have a block");
-  return move_block_iterator(input_block.end());
+  check_has_block();
+  return move_block_iterator(ring[first].get() + K);
 }
 
 template <class T>
 void block_queue<T>::clear() {
-  input_block.clear();
-  typedef decltype(input_queue) queue_t;
-  input_queue = queue_t();
+  first = 0;
+  count = 0;
+}
+
+template <class T>
+void block_queue<T>::drop_partial_block() {
+  count -= count % K;
 }
 
 template <class T>
@@ -245,25 +371,38 @@ std::size_t block_queue<T>::block_size() const {
 
 template <class T>
 std::size_t block_queue<T>::queue_size() const {
-  return input_queue.size();
+  return has_block() ? count - K : count;
 }
 
 template <class T>
 std::size_t block_queue<T>::size() const {
-  return input_queue.size() + (has_block() ? K : 0);
+  return count;
+}
+
+template <class T>
+std::size_t block_queue<T>::block_count() const {
+  return count / K;
 }
 
 template <class T>
-void block_queue<T>::check_has_block() {
-  using std::swap;
-
-  if (!has_block() && input_queue.size() >= K)
-    for (std::size_t i = 0; i < K; ++i) {
-      T p;
-      swap(p, input_queue.front());
-      input_queue.pop();
-      input_block.push_back(std::move(p));
-    }
+void block_queue<T>::grow() {
+  std::size_t new_size = std::max<std::size_t>(1, 2 * ring.size());
+  std::vector<std::unique_ptr<T[]>> new_ring;
+  new_ring.reserve(new_size);
+  // Keep the arrays in order, starting from the current block
+  for (std::size_t i = 0; i < ring.size(); ++i) {
+    new_ring.push_back(std::move(ring[(first + i) % ring.size()]));
+  }
+  while (new_ring.size() < new_size) {
+    new_ring.push_back(std::make_unique<T[]>(K));
+  }
+  ring = std::move(new_ring);
+  first = 0;
+}
+
+template <class T>
+void block_queue<T>::check_has_block() const {
+  if (!has_block()) throw std::logic_error("Does not have a block");
 }
 
 template <class T>
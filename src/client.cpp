@@ -168,11 +168,23 @@ private:
       RFs.push_back(cp.rfs(i));
     }
     out_header.assign(cp.header().begin(), cp.header().end());
-    dc.setup_decoder(Ks.begin(), Ks.end(),
-		     RFs.begin(), RFs.end(),
-		     cp.ef(),
-		     cp.c(),
-		     cp.delta());
+    if (cp.wps_size() == 0) {
+      dc.setup_decoder(Ks.begin(), Ks.end(),
+		       RFs.begin(), RFs.end(),
+		       cp.ef(),
+		       cp.c(),
+		       cp.delta());
+    }
+    else {
+      assert(cp.wps_size() == cp.ks_size());
+      std::vector<double> WPs(cp.wps().begin(), cp.wps().end());
+      dc.setup_decoder(Ks.begin(), Ks.end(),
+		       WPs.begin(), WPs.end(),
+		       cp.c(),
+		       cp.delta());
+    }
+    if (cp.has_interleavedepth())
+      dc.interleave_depth(cp.interleavedepth());
     dc.setup_sink(out_header, client_params.stream_name);
     dc.enable_ack(cp.ack());
     //dc.expected_count(0);
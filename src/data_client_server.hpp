@@ -1,12 +1,23 @@
 #ifndef UEP_NET_DATA_CLIENT_SERVER_HPP
 #define UEP_NET_DATA_CLIENT_SERVER_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
 #include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <exception>
 #include <functional>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <boost/asio.hpp>
 #include <boost/asio/steady_timer.hpp>
@@ -14,6 +25,7 @@
 #include "counter.hpp"
 #include "log.hpp"
 #include "packets_rw.hpp"
+#include "spsc_ring.hpp"
 #include "utils.hpp"
 
 namespace uep { namespace net {
@@ -81,6 +93,15 @@ public:
   void enable_ack(bool b);
   /** Return true when the sending of ACKs is enabled. */
   bool is_ack_enabled() const;
+  /** Set the number of blocks that the decoder keeps open at the
+   *  same time. It must match the interleave depth of the server.
+   */
+  void interleave_depth(std::size_t depth);
+  /** Set the number of blocks that the decoder keeps open in
+   *  addition to the interleave depth, to decode the packets
+   *  reordered by the network.
+   */
+  void reorder_window(std::size_t n);
   /** Set the number of packets to be received before stopping. */
   void expected_count(std::size_t ec);
   /** Get the number of packets to be received before stopping. */
@@ -103,6 +124,20 @@ public:
   void channel_transition_probabilities(double p_GB, double p_BG);
   /** Get the channel state transition probabilities. */
   std::pair<double, double> channel_transition_probabilities() const;
+  /** Ask the server for more packets when the current block is
+   *  unlikely to be decoded within the `max_per_block` packets sent
+   *  for each block. Once half of them have been sent, the client
+   *  estimates from the observed losses how many more will arrive
+   *  and, if the success probability given by the decoder is below
+   *  `min_probability`, sends a "need more" hint with the number of
+   *  missing packets. At most one hint is sent for each block and
+   *  only when the ACKs are enabled. A max_per_block of 0 disables
+   *  the hints, which is the default.
+   */
+  void enable_need_more_hints(std::size_t max_per_block,
+			      double min_probability);
+  /** Return the number of "need more" hints sent to the server. */
+  std::size_t need_more_count() const;
 
   /** Add an handler that will be called when this client stops. */
   template <class H>
@@ -154,6 +189,9 @@ private:
   buffer_type ack_buffer; /**< Buffer to hold the raw ack during
 			   *   the async transmission.
 			   */
+  buffer_type hint_buffer; /**< Buffer to hold the raw "need more"
+			    *   hint during the async transmission.
+			    */
 
   std::atomic_bool ack_enabled; /**< Set when the data_client should
 				 *   send back ACKs.
@@ -166,6 +204,22 @@ private:
 				 */
   std::atomic_bool is_stopped_;
 
+  std::atomic_size_t hint_max_per_block; /**< Packets sent by the
+					  *   server for each block,
+					  *   or 0 to disable the
+					  *   hints.
+					  */
+  std::atomic<double> hint_min_prob; /**< Success probability below
+				      *   which a hint is sent.
+				      */
+  std::size_t hint_blockno; /**< Block tracked for the hints. */
+  std::size_t hint_sent_pkts; /**< Packets of hint_blockno sent by
+			       *   the server, from the highest
+			       *   received seqno.
+			       */
+  bool hint_done; /**< Set when hint_blockno needs no more hints. */
+  std::atomic_size_t hint_count; /**< Number of hints sent. */
+
   markov2_distribution drop_dist; /**< Distribution of packet
 				   *   dropping.
 				   */
@@ -193,11 +247,21 @@ private:
   void reset_timer();
   /** Schedule the transmission of an ACK to the server. */
   void schedule_ack(std::size_t blockno);
+  /** Schedule the transmission of a "need more" hint to the server. */
+  void schedule_need_more(std::size_t blockno, std::size_t count);
+  /** Track the block numbers and sequence numbers of the received
+   *  packets and send a hint if the current block is likely to fail.
+   */
+  void update_need_more(const std::vector<std::pair<std::size_t,
+			                            std::size_t>> &recv_pos);
 
   /** Called when a new packet is received. */
   void handle_received(const boost::system::error_code& ec, std::size_t size);
   /** Called when the ACK has been sent. */
   void handle_sent_ack(const boost::system::error_code& ec, std::size_t size);
+  /** Called when the "need more" hint has been sent. */
+  void handle_sent_need_more(const boost::system::error_code& ec,
+			     std::size_t size);
   /** Called when the timeout timer expires or is cancelled. */
   void handle_timeout(const boost::system::error_code& ec);
   /** Called after stop(). */
@@ -220,6 +284,19 @@ private:
  *
  *  The send rate can be dynamically limited by specifying it in
  *  bit/s. If it is too high the server sends at maximum rate.
+ *
+ *  When the encoder keeps more than one block open (see
+ *  interleave_depth()) the packets of the open blocks are sent
+ *  round-robin, and an ACK for a block also drops the packets of the
+ *  previous open blocks.
+ *
+ *  The source and the encoder are only used by a producer thread,
+ *  started by start(), that keeps a bounded ring of raw packets
+ *  ready to be sent. The asynchronous handlers only pop the packets
+ *  from the ring and transmit them, so the encoding time does not
+ *  affect the send schedule. When an ACK is received the packets
+ *  left in the ring that belong to the acknowledged blocks are
+ *  discarded.
  */
 template <class Encoder, class Source>
 class data_server {
@@ -229,6 +306,11 @@ public:
   typedef typename Encoder::parameter_set encoder_parameter_set;
   typedef typename Source::parameter_set source_parameter_set;
 
+  /** Default number of encoded packets that can be buffered in the
+   *  ring between the producer thread and the sender.
+   */
+  static constexpr std::size_t DEFAULT_RING_CAPACITY = 64;
+
   /** Construct a data_server tied to an io_service. This does not
    *  bind the socket yet.
    */
@@ -242,8 +324,32 @@ public:
     is_stopped_(true),
     ack_enabled(true),
     max_per_block(Encoder::MAX_SEQNO),
-    last_ack(ack_header_size),
-    pkt_timer(io_service_) {
+    last_ack(need_more_size),
+    pkt_timer(io_service_),
+    ring_capacity_(DEFAULT_RING_CAPACITY),
+    producer_running(false),
+    producer_waiting(false),
+    producer_done(false),
+    consumer_waiting(false),
+    epoch(0),
+    has_pending_ack(false),
+    pending_ack(0),
+    has_pending_ext(false),
+    pending_ext_blockno(0),
+    pending_ext_count(0),
+    ext_blockno(0),
+    ext_count(0),
+    extended_count_(0),
+    has_pending_skip(false),
+    last_pkt_epoch(0),
+    last_pkt_blockno(0),
+    tx_blockno(0),
+    tx_depth(1) {
+  }
+
+  /** Stop the producer thread, if it is still running. */
+  ~data_server() {
+    stop_producer();
   }
 
   /** Replace the encoder with a new one built using the given
@@ -305,9 +411,17 @@ public:
     strand_.dispatch(std::bind(&data_server::handle_stopped, this));
   }
 
-  /** Schedule the passage to the next block of packets. */
+  /** Schedule the passage to the next block of packets. The packets
+   *  of the current block that are still waiting to be sent are
+   *  discarded.
+   */
   void next_block() {
-    strand_.dispatch(std::bind(&Encoder::next_block, encoder_.get()));
+    {
+      std::lock_guard<std::mutex> lock(producer_mutex);
+      has_pending_skip = true;
+      ++epoch;
+    }
+    producer_cv.notify_one();
   }
 
   /** Set the target send rate in bit/s. */
@@ -335,6 +449,30 @@ public:
     return max_per_block;
   }
 
+  /** Set the maximum number of encoded packets that can wait to be
+   *  sent. Takes effect at the next start().
+   */
+  void ring_capacity(std::size_t n) {
+    if (n < 1)
+      throw std::underflow_error("The ring must hold at least one packet");
+    ring_capacity_ = n;
+  }
+
+  /** Get the maximum number of encoded packets that can wait to be
+   *  sent.
+   */
+  std::size_t ring_capacity() const {
+    return ring_capacity_;
+  }
+
+  /** Return the number of packets added to the blocks, beyond the
+   *  maximum sequence number, because of the "need more" hints
+   *  received from the client.
+   */
+  std::size_t extended_count() const {
+    return extended_count_;
+  }
+
   /** Get the UDP endpoint that the server socket is currently bound
    *  to.
    */
@@ -352,6 +490,16 @@ public:
     return ack_enabled;
   }
 
+  /** Set the number of blocks that the encoder keeps open at the
+   *  same time. This must be called after setup_encoder() and before
+   *  start().
+   */
+  void interleave_depth(std::size_t depth) {
+    if (!is_stopped_)
+      throw std::logic_error("Cannot change the interleave depth while running");
+    encoder_->interleave_depth(depth);
+  }
+
   /** True when the data_server is not sending data and not listening
    *  for ACKs.
    */
@@ -367,13 +515,20 @@ public:
    */
   std::size_t cancel_stop_handlers();
 
-  /** Return a const reference to the source object. */
+  /** Return a reference to the source object. The producer thread
+   *  uses the source while the server runs, so this must only be
+   *  called before start() or after the server has stopped.
+   */
   Source &source() const {
+    assert(!producer.joinable());
     return *source_;
   }
 
-  /** Return a const referece to the encoder object. */
+  /** Return a const referece to the encoder object. The same
+   *  restriction of source() applies.
+   */
   const Encoder &encoder() const {
+    assert(!producer.joinable());
     return *encoder_;
   }
 
@@ -416,7 +571,9 @@ private:
   buffer_type last_pkt; /**< Last _raw_ coded packet generated
 			       *   by the encoder.
 			       */
-  buffer_type last_ack; /**< Last _raw_ ack packet received. */
+  buffer_type last_ack; /**< Last _raw_ ack or "need more" packet
+			 *   received.
+			 */
   std::chrono::steady_clock::time_point last_sent_time;
   boost::asio::steady_timer pkt_timer; /**< Timer used to schedule the
 					*   packet transmissions.
@@ -428,20 +585,164 @@ private:
       >
     > stop_handlers; /**< Holds the handlers to call after a stop. */
 
-  /** Encode the next packet and schedule its transmission according
-   *  to the target send rate.
+  /** Raw packet produced by the encoder thread. */
+  struct ready_packet {
+    buffer_type raw; /**< Wire representation of the packet. */
+    std::size_t blockno; /**< Block number of the packet. */
+    std::size_t epoch; /**< Value of the epoch when the packet was
+			*   encoded.
+			*/
+  };
+
+  std::atomic_size_t ring_capacity_; /**< Capacity used for the next
+				      *   ring.
+				      */
+  std::unique_ptr<spsc_ring<ready_packet>> ring_; /**< Packets ready
+						   *   to be sent.
+						   */
+  std::thread producer; /**< Thread that runs the encoder. */
+  std::mutex producer_mutex; /**< Protects the requests to the
+			      *	  producer thread.
+			      */
+  std::condition_variable producer_cv; /**< Wakes up the producer
+					*   thread.
+					*/
+  bool producer_running; /**< Cleared to terminate the producer
+			  *   thread.
+			  */
+  std::atomic_bool producer_waiting; /**< Set while the producer is
+				      *	  sleeping on producer_cv.
+				      */
+  std::atomic_bool producer_done; /**< Set when the producer has no
+				   *   more packets to encode.
+				   */
+  std::atomic_bool consumer_waiting; /**< Set when the sender found
+				      *	  the ring empty and must be
+				      *	  woken up by the producer.
+				      */
+  std::atomic_size_t epoch; /**< Incremented by next_block() to
+			     *	 invalidate all the packets in the
+			     *	 ring.
+			     */
+  bool has_pending_ack; /**< An ACK must be applied to the encoder. */
+  std::size_t pending_ack; /**< Block number of the pending ACK. */
+  bool has_pending_ext; /**< A "need more" hint must be applied to
+			 *   the encoder.
+			 */
+  std::size_t pending_ext_blockno; /**< Block of the pending hint. */
+  std::size_t pending_ext_count; /**< Packets asked by the pending
+				  *   hint.
+				  */
+  std::size_t ext_blockno; /**< Block extended by the last hint. Only
+			    *   used by the producer.
+			    */
+  std::size_t ext_count; /**< Packets added to ext_blockno. Only used
+			  *   by the producer.
+			  */
+  std::atomic_size_t extended_count_; /**< Total packets added by the
+				       *   hints.
+				       */
+  bool has_pending_skip; /**< A next_block() must be applied to the
+			  *   encoder.
+			  */
+  std::size_t last_pkt_epoch; /**< Epoch of last_pkt. */
+  std::size_t last_pkt_blockno; /**< Block number of last_pkt. */
+  std::size_t tx_blockno; /**< Oldest block number of the packets
+			  *   being sent, or requested by the last
+			  *   ACK.
+			  */
+  std::size_t tx_depth; /**< Number of blocks that can be sent at the
+			 *   same time.
+			 */
+
+  /** Create a new ring and start the producer thread. */
+  void start_producer() {
+    ring_ = std::make_unique<spsc_ring<ready_packet>>(ring_capacity_);
+    producer_done = false;
+    producer_waiting = false;
+    consumer_waiting = false;
+    {
+      std::lock_guard<std::mutex> lock(producer_mutex);
+      producer_running = true;
+      has_pending_ack = false;
+      has_pending_ext = false;
+      has_pending_skip = false;
+    }
+    ext_count = 0;
+    producer = std::thread(&data_server::producer_loop, this);
+  }
+
+  /** Terminate the producer thread and wait for it. */
+  void stop_producer() {
+    {
+      std::lock_guard<std::mutex> lock(producer_mutex);
+      producer_running = false;
+    }
+    producer_cv.notify_one();
+    if (producer.joinable()) producer.join();
+  }
+
+  /** Body of the producer thread. Encode packets while there is
+   *  space in the ring and apply the ACKs received by the sender.
    */
-  void schedule_next_pkt() {
-    BOOST_LOG_SEV(basic_lg, log::debug) << "Called schedule_next_pkt";
-    using std::move;
-    //using std::chrono::seconds;
-    using std::chrono::microseconds;
-    using namespace std::placeholders;
+  void producer_loop() {
+    try {
+      std::unique_lock<std::mutex> lock(producer_mutex);
+      for (;;) {
+	producer_waiting = true;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	producer_cv.wait(lock, [this]() {
+	    return !producer_running || has_pending_ack ||
+	      has_pending_ext || has_pending_skip || !ring_->full();
+	  });
+	producer_waiting = false;
+	if (!producer_running) return;
+
+	bool ack = has_pending_ack;
+	std::size_t ack_blockno = pending_ack;
+	bool skip = has_pending_skip;
+	bool ext = has_pending_ext;
+	std::size_t ext_blockno_ = pending_ext_blockno;
+	std::size_t ext_count_ = pending_ext_count;
+	std::size_t current_epoch = epoch;
+	has_pending_ack = false;
+	has_pending_ext = false;
+	has_pending_skip = false;
+	lock.unlock();
+
+	if (skip) encoder_->next_block();
+	if (ack) apply_ack(ack_blockno);
+	if (ext) apply_extension(ext_blockno_, ext_count_);
+	bool more = ring_->full() || encode_next_pkt(current_epoch);
+
+	lock.lock();
+	if (!more) break;
+      }
+    }
+    catch (...) {
+      // Rethrow from io_service::run
+      std::exception_ptr e = std::current_exception();
+      io_service_.post([e]() { std::rethrow_exception(e); });
+      return;
+    }
 
-    if (is_stopped_) return;
+    producer_done = true;
+    wake_consumer();
+  }
+
+  /** Encode the next packet and push it into the ring. Return false
+   *  when there is no more data to send.
+   */
+  bool encode_next_pkt(std::size_t current_epoch) {
+    using std::move;
 
     // Check if the max number has been reached
-    if (max_per_block <= encoder_->coded_count()) {
+    std::size_t limit = max_per_block;
+    if (ext_count > 0 && ext_blockno == encoder_->blockno()) {
+      const std::size_t max_seqno = Encoder::MAX_SEQNO;
+      limit = std::min(limit + ext_count, max_seqno);
+    }
+    if (limit <= encoder_->coded_count()) {
       encoder_->next_block();
     }
 
@@ -461,13 +762,142 @@ private:
     if (!*encoder_) {
       BOOST_LOG_SEV(basic_lg, log::info) <<
 	"Data server out of data to send";
-      stop();
-      return;
+      return false;
     }
 
     fountain_packet p = encoder_->next_coded();
+    ready_packet rp;
+    rp.blockno = p.block_number();
+    rp.epoch = current_epoch;
+    rp.raw = build_raw_packet(move(p));
+    if (!ring_->try_push(move(rp)))
+      throw std::logic_error("The ring should not be full");
+    wake_consumer();
+    return true;
+  }
+
+  /** Skip the encoder to the block requested by an ACK, unless the
+   *  ACK is old.
+   */
+  void apply_ack(std::size_t ack_blockno_) {
+    circular_counter<std::size_t>
+      current_blockno(Encoder::MAX_BLOCKNO),
+      ack_blockno(Encoder::MAX_BLOCKNO);
+    current_blockno.set(encoder_->blockno());
+    ack_blockno.set(ack_blockno_);
+    std::size_t diff = current_blockno.forward_distance(ack_blockno);
+    if (diff > Encoder::BLOCK_WINDOW || diff == 0) return; // Old ACK
+
+    // Fill the encoder buffer with enough packets
+    std::size_t required_pkts = diff * encoder_->K();
+    while (*source_ && encoder_->size() < required_pkts)
+      encoder_->push(source_->next_packet());
+
+    // Skip blocks
+    encoder_->next_block(ack_blockno_);
+  }
+
+  /** Let the encoder send `count` more packets of the block given by
+   *  a "need more" hint, unless it has already moved past it.
+   */
+  void apply_extension(std::size_t ext_blockno_, std::size_t count) {
+    if (encoder_->blockno() != ext_blockno_) return; // Late hint
+    if (ext_count > 0 && ext_blockno == ext_blockno_) ext_count += count;
+    else ext_count = count;
+    ext_blockno = ext_blockno_;
+    extended_count_ += count;
+  }
+
+  /** Called by the producer after a push into the ring: resume the
+   *  sender if it is waiting.
+   */
+  void wake_consumer() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (consumer_waiting.exchange(false)) {
+      strand_.post(std::bind(&data_server::schedule_next_pkt, this));
+    }
+  }
+
+  /** Called by the sender after a pop from the ring: resume the
+   *  producer if it is waiting.
+   */
+  void wake_producer() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (producer_waiting) {
+      { std::lock_guard<std::mutex> lock(producer_mutex); }
+      producer_cv.notify_one();
+    }
+  }
+
+  /** True if a packet was invalidated by next_block() or belongs to
+   *  a block that comes before tx_blockno.
+   */
+  bool is_stale(std::size_t pkt_blockno, std::size_t pkt_epoch) const {
+    if (pkt_epoch != epoch) return true;
+    circular_counter<std::size_t>
+      pkt_bn(Encoder::MAX_BLOCKNO),
+      tx_bn(Encoder::MAX_BLOCKNO);
+    pkt_bn.set(pkt_blockno);
+    tx_bn.set(tx_blockno);
+    return pkt_bn.is_before(tx_bn);
+  }
+
+  /** Move tx_blockno forward so that the window of tx_depth blocks
+   *  ending at `pkt_blockno` is being sent.
+   */
+  void advance_tx_blockno(std::size_t pkt_blockno) {
+    circular_counter<std::size_t>
+      pkt_bn(Encoder::MAX_BLOCKNO),
+      tx_bn(Encoder::MAX_BLOCKNO);
+    pkt_bn.set(pkt_blockno);
+    tx_bn.set(tx_blockno);
+    std::size_t dist = tx_bn.forward_distance(pkt_bn);
+    if (dist < tx_depth || dist > Encoder::BLOCK_WINDOW) return;
+    tx_bn.next(dist - (tx_depth - 1));
+    tx_blockno = tx_bn.value();
+  }
+
+  /** Pop the next valid packet from the ring into last_pkt. Return
+   *  false if the sender must wait for the producer.
+   */
+  bool pop_ready_pkt() {
+    ready_packet rp;
+    for (;;) {
+      if (ring_->try_pop(rp)) {
+	wake_producer();
+	if (is_stale(rp.blockno, rp.epoch)) continue; // Drop it
+	last_pkt = std::move(rp.raw);
+	last_pkt_epoch = rp.epoch;
+	last_pkt_blockno = rp.blockno;
+	advance_tx_blockno(rp.blockno);
+	return true;
+      }
+      if (producer_done && ring_->empty()) return false;
+
+      consumer_waiting = true;
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      // The producer will wake up the sender
+      if (ring_->empty() && !producer_done) return false;
+      // The producer has already posted a wake-up
+      if (!consumer_waiting.exchange(false)) return false;
+    }
+  }
+
+  /** Take the next packet from the ring and schedule its
+   *  transmission according to the target send rate.
+   */
+  void schedule_next_pkt() {
+    BOOST_LOG_SEV(basic_lg, log::debug) << "Called schedule_next_pkt";
+    using std::chrono::microseconds;
+
+    if (is_stopped_) return;
+
     bool is_first = last_pkt.empty();
-    last_pkt = build_raw_packet(move(p));
+    if (!pop_ready_pkt()) {
+      // Empty ring and no more data: stop
+      if (producer_done && ring_->empty()) stop();
+      return;
+    }
 
     if (is_first) { // First packet: no need to wait
       pkt_timer.expires_from_now(microseconds(0));
@@ -503,6 +933,13 @@ private:
     if (ec == boost::asio::error::operation_aborted) return; // cancelled
     if (ec) throw boost::system::system_error(ec);
 
+    if (recv_size > 0 && last_ack[0] == raw_packet_type::need_more) {
+      if (recv_size != need_more_size)
+	throw std::runtime_error("The packet has a wrong size");
+      handle_need_more(parse_raw_need_more_packet(last_ack));
+      listen_for_acks();
+      return;
+    }
     if (recv_size != ack_header_size)
       throw std::runtime_error("The packet has a wrong size");
 
@@ -516,33 +953,63 @@ private:
       throw e;
     }
 
-    // Fill the encoder buffer with enough packets
+    // Compare with the block that is being sent
     circular_counter<std::size_t>
       current_blockno(Encoder::MAX_BLOCKNO),
       ack_blockno(Encoder::MAX_BLOCKNO);
-    current_blockno.set(encoder_->blockno());
+    current_blockno.set(tx_blockno);
     ack_blockno.set(ack_blockno_);
     std::size_t diff = current_blockno.forward_distance(ack_blockno);
-    if (diff > Encoder::BLOCK_WINDOW || diff == 0) {
+    if (last_pkt.empty() || diff > Encoder::BLOCK_WINDOW || diff == 0) {
       // Old ACK
       // Keep listening
       listen_for_acks();
       return;
     }
-    std::size_t required_pkts = diff * encoder_->K();
-    while (*source_ && encoder_->size() < required_pkts)
-      encoder_->push(source_->next_packet());
 
-    // Skip blocks
-    encoder_->next_block(ack_blockno_);
+    // Drop the encoded packets of the old blocks
+    tx_blockno = ack_blockno_;
+    std::size_t flushed = 0;
+    ready_packet *front;
+    while ((front = ring_->front()) &&
+	   is_stale(front->blockno, front->epoch)) {
+      ready_packet rp;
+      ring_->try_pop(rp);
+      ++flushed;
+    }
+    if (flushed > 0) wake_producer();
+
+    // Let the producer skip blocks
+    {
+      std::lock_guard<std::mutex> lock(producer_mutex);
+      has_pending_ack = true;
+      pending_ack = ack_blockno_;
+    }
+    producer_cv.notify_one();
+    BOOST_LOG(perf_lg) << "data_server::handle_ack"
+		       << " blockno=" << ack_blockno_
+		       << " flushed_pkts=" << flushed;
 
-    // Reschedule the next coded packet: must be rebuilt
-    pkt_timer.cancel();
-    schedule_next_pkt();
     // Keep listening
     listen_for_acks();
   }
 
+  /** Called when a "need more" hint is received: pass it to the
+   *  producer.
+   */
+  void handle_need_more(const std::pair<std::size_t, std::size_t> &hint) {
+    {
+      std::lock_guard<std::mutex> lock(producer_mutex);
+      has_pending_ext = true;
+      pending_ext_blockno = hint.first;
+      pending_ext_count = hint.second;
+    }
+    producer_cv.notify_one();
+    BOOST_LOG(perf_lg) << "data_server::handle_need_more"
+		       << " blockno=" << hint.first
+		       << " count=" << hint.second;
+  }
+
   /** Called when the packet timer has expired or was cancelled. */
   void handle_send_timer(const boost::system::error_code &ec) {
     using namespace std::placeholders;
@@ -550,6 +1017,12 @@ private:
     if (ec == boost::asio::error::operation_aborted) return; // cancelled
     if (ec) throw boost::system::system_error(ec);
 
+    // An ACK arrived while waiting: take a new packet
+    if (is_stale(last_pkt_blockno, last_pkt_epoch)) {
+      schedule_next_pkt();
+      return;
+    }
+
     // Start transmission
     last_sent_time = std::chrono::steady_clock::now();
     socket_.async_send_to(boost::asio::buffer(last_pkt),
@@ -577,6 +1050,9 @@ private:
   void handle_started() {
     BOOST_LOG_SEV(basic_lg, log::debug) << "Called handle_started";
     is_stopped_ = false;
+    last_pkt.clear();
+    tx_depth = encoder_->interleave_depth();
+    start_producer();
     schedule_next_pkt();
     listen_for_acks();
   }
@@ -584,6 +1060,7 @@ private:
   /** Called after stop(). */
   void handle_stopped() {
     is_stopped_ = true;
+    stop_producer();
     pkt_timer.cancel();
     socket_.cancel();
     BOOST_LOG(perf_lg) << "data_server::stopped sent_pkts="
@@ -611,6 +1088,12 @@ data_client<Decoder,Sink>::data_client(boost::asio::io_service &io) :
   ack_enabled(true),
   exp_count(0),
   is_stopped_(true),
+  hint_max_per_block(0),
+  hint_min_prob(0),
+  hint_blockno(std::numeric_limits<std::size_t>::max()),
+  hint_sent_pkts(0),
+  hint_done(false),
+  hint_count(0),
   drop_dist(0),
   timeout_timer(io),
   timeout_(std::chrono::steady_clock::duration::zero()) {
@@ -732,6 +1215,16 @@ bool data_client<Decoder,Sink>::is_ack_enabled() const {
   return ack_enabled;
 }
 
+template <class Decoder, class Sink>
+void data_client<Decoder,Sink>::interleave_depth(std::size_t depth) {
+  decoder_->interleave_depth(depth);
+}
+
+template <class Decoder, class Sink>
+void data_client<Decoder,Sink>::reorder_window(std::size_t n) {
+  decoder_->reorder_window(n);
+}
+
 template <class Decoder, class Sink>
 void data_client<Decoder,Sink>::expected_count(std::size_t ec) {
   exp_count = ec;
@@ -784,6 +1277,18 @@ data_client<Decoder,Sink>::channel_transition_probabilities() const {
   return std::make_pair(drop_dist.p_01(), drop_dist.p_10());
 }
 
+template<typename Decoder, typename Sink>
+void data_client<Decoder,Sink>::enable_need_more_hints(std::size_t max_per_block,
+						       double min_probability) {
+  hint_max_per_block = max_per_block;
+  hint_min_prob = min_probability;
+}
+
+template<typename Decoder, typename Sink>
+std::size_t data_client<Decoder,Sink>::need_more_count() const {
+  return hint_count;
+}
+
 template <class Decoder, class Sink>
 const Sink &data_client<Decoder,Sink>::sink() const {
   return *sink_;
@@ -828,6 +1333,61 @@ void data_client<Decoder,Sink>::schedule_ack(std::size_t blockno) {
 					       std::placeholders::_2)));
 }
 
+template <class Decoder, class Sink>
+void data_client<Decoder,Sink>::schedule_need_more(std::size_t blockno,
+						   std::size_t count) {
+  if (!ack_enabled) return;
+
+  hint_buffer = build_raw_need_more(blockno, count);
+  socket_.async_send_to(boost::asio::buffer(hint_buffer),
+			server_endpoint_,
+			strand_.wrap(std::bind(&data_client::handle_sent_need_more,
+					       this,
+					       std::placeholders::_1,
+					       std::placeholders::_2)));
+  ++hint_count;
+  BOOST_LOG(perf_lg) << "data_client::schedule_need_more"
+		     << " blockno=" << blockno
+		     << " count=" << count;
+}
+
+template <class Decoder, class Sink>
+void data_client<Decoder,Sink>::update_need_more(
+  const std::vector<std::pair<std::size_t, std::size_t>> &recv_pos) {
+  std::size_t bn = decoder_->blockno();
+  if (bn != hint_blockno) {
+    hint_blockno = bn;
+    hint_sent_pkts = 0;
+    hint_done = false;
+  }
+  for (const auto &pos : recv_pos) {
+    if (pos.first == bn) hint_sent_pkts = std::max(hint_sent_pkts, pos.second + 1);
+  }
+  if (hint_done || hint_sent_pkts == 0) return;
+  if (decoder_->has_decoded()) {
+    hint_done = true;
+    return;
+  }
+
+  // Wait until the loss rate can be estimated
+  const std::size_t max_pkts = hint_max_per_block;
+  if (2 * hint_sent_pkts < max_pkts) return;
+
+  // Packets that will arrive before the server moves on
+  double delivery = static_cast<double>(decoder_->received_count()) /
+    hint_sent_pkts;
+  std::size_t left = hint_sent_pkts < max_pkts ? max_pkts - hint_sent_pkts : 0;
+  std::size_t expected = static_cast<std::size_t>(delivery * left);
+  if (decoder_->success_probability(expected) >= hint_min_prob) return;
+
+  std::size_t needed = decoder_->needed_estimate();
+  std::size_t missing = needed > expected ? needed - expected : 1;
+  std::size_t count = delivery > 0 ?
+    static_cast<std::size_t>(std::ceil(missing / delivery)) : missing;
+  schedule_need_more(bn, std::max<std::size_t>(count, 1));
+  hint_done = true;
+}
+
 template <class Decoder, class Sink>
 void data_client<Decoder,Sink>::handle_received(const boost::system::error_code& ec,
 						std::size_t size) {
@@ -891,6 +1451,15 @@ void data_client<Decoder,Sink>::handle_received(const boost::system::error_code&
 
   reset_timer();
 
+  // Keep the position of the packets in their blocks for the hints
+  std::vector<std::pair<std::size_t, std::size_t>> recv_pos;
+  if (hint_max_per_block > 0) {
+    recv_pos.reserve(recv_list.size());
+    for (const fountain_packet &p : recv_list) {
+      recv_pos.emplace_back(p.block_number(), p.sequence_number());
+    }
+  }
+
   decoder_->push(std::make_move_iterator(recv_list.begin()),
 		 std::make_move_iterator(recv_list.end()));
 
@@ -904,9 +1473,10 @@ void data_client<Decoder,Sink>::handle_received(const boost::system::error_code&
     auto bnc = decoder_->block_number_counter();
     schedule_ack(bnc.next());
   }
+  if (!recv_pos.empty()) update_need_more(recv_pos);
 
   // Keep listening if not all packets have been decoded or failed
-  bool more_eos = *sink_;
+  bool more_eos = static_cast<bool>(*sink_);
   bool more_pktnum = exp_count == 0 ||
     (decoder_->total_decoded_count() +
      decoder_->total_failed_count()) < exp_count;
@@ -927,6 +1497,14 @@ void data_client<Decoder, Sink>::handle_sent_ack(const boost::system::error_code
   if (size != ack_buffer.size()) throw std::runtime_error("Was not sent fully");
 }
 
+template <class Decoder, class Sink>
+void data_client<Decoder, Sink>::handle_sent_need_more(const boost::system::error_code& ec,
+						       std::size_t size) {
+  if (ec == boost::asio::error::operation_aborted) return; // was cancelled
+  if (ec) throw boost::system::system_error(ec);
+  if (size != hint_buffer.size()) throw std::runtime_error("Was not sent fully");
+}
+
 template <class Decoder, class Sink>
 void data_client<Decoder, Sink>::handle_timeout(const boost::system::error_code& ec) {
   if (ec == boost::asio::error::operation_aborted) return; // was cancelled
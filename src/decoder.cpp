@@ -29,12 +29,15 @@ lt_decoder::lt_decoder(std::unique_ptr<base_row_generator> &&rg) :
   basic_lg(boost::log::keywords::channel = log::basic),
   perf_lg(boost::log::keywords::channel = log::performance),
   the_output_queue(rg->K()),
-  the_block_decoder(std::move(rg)),
+  first_slot(0),
+  the_interleave_depth(1),
+  the_reorder_window(0),
   blockno_counter(MAX_BLOCKNO, BLOCK_WINDOW),
   has_enqueued(false),
   uniq_recv_count(0),
   tot_dec_count(0),
   tot_failed_count(0) {
+  the_block_decoders.push_back(std::make_unique<block_decoder>(std::move(rg)));
   blockno_counter.set(0);
 }
 
@@ -57,11 +60,11 @@ fountain_packet lt_decoder::next_decoded() {
 }
 
 lt_decoder::const_block_iterator lt_decoder::decoded_begin() const {
-  return the_block_decoder.block_begin();
+  return window_decoder(0).block_begin();
 }
 
 lt_decoder::const_block_iterator lt_decoder::decoded_end() const {
-  return the_block_decoder.block_end();
+  return window_decoder(0).block_end();
 }
 
 void lt_decoder::flush() {
@@ -113,29 +116,157 @@ void lt_decoder::flush_small_blockno(std::size_t blockno_) {
 
   enqueue_partially_decoded();
 
-  // Push dist-1 empty blocks
-  if (dist > 1) {
-    const std::vector<packet> empty_block(K());
-    for (size_t i = 0; i < dist - 1; ++i) {
-      the_output_queue.push_shallow(empty_block.cbegin(),
-				    empty_block.cend());
+  // Push the other blocks of the window that are left behind
+  size_t nopen = std::min(dist, window_size());
+  auto bn(blockno_counter);
+  for (size_t i = 1; i < nopen; ++i) {
+    enqueue_block(window_decoder(i), bn.next());
+  }
 
-    }
-    tot_failed_count += K() * (dist - 1);
+  // Push dist-nopen empty blocks
+  for (size_t i = nopen; i < dist; ++i) {
+    enqueue_empty_block(bn.next());
   }
 
-  // Start to decode the new block
-  the_block_decoder.reset();
+  // Reuse the released decoders for the new blocks at the end
+  for (size_t i = 0; i < nopen; ++i) {
+    window_decoder(0).reset();
+    first_slot = (first_slot + 1) % window_size();
+  }
   has_enqueued = false;
   blockno_counter = recv_blockno;
+
+  // The new current block could be already decoded
+  if (has_decoded()) enqueue_partially_decoded();
+}
+
+void lt_decoder::interleave_depth(std::size_t depth) {
+  if (depth < 1)
+    throw std::invalid_argument("The interleave depth must be at least 1");
+  if (uniq_recv_count > 0)
+    throw std::logic_error("Cannot change the interleave depth after receiving");
+  the_interleave_depth = depth;
+  resize_window(the_interleave_depth + the_reorder_window);
+}
+
+std::size_t lt_decoder::interleave_depth() const {
+  return the_interleave_depth;
+}
+
+void lt_decoder::reorder_window(std::size_t n) {
+  if (uniq_recv_count > 0)
+    throw std::logic_error("Cannot change the reorder window after receiving");
+  the_reorder_window = n;
+  resize_window(the_interleave_depth + the_reorder_window);
+}
+
+std::size_t lt_decoder::reorder_window() const {
+  return the_reorder_window;
+}
+
+std::size_t lt_decoder::window_size() const {
+  return the_block_decoders.size();
+}
+
+void lt_decoder::resize_window(std::size_t size) {
+  const block_decoder &proto = *the_block_decoders.front();
+  while (the_block_decoders.size() < size) {
+    the_block_decoders.push_back(
+      std::make_unique<block_decoder>(proto.row_generator().clone()));
+    the_block_decoders.back()->enable_elimination(proto.elimination_limit());
+    the_block_decoders.back()->enable_parallel_peeling(proto.parallel_peeling_threads());
+    the_block_decoders.back()->enable_xor_schedule(proto.xor_schedule_threads());
+    the_block_decoders.back()->set_decoded_callback(proto.get_decoded_callback());
+    the_block_decoders.back()->set_ripple_order(proto.get_ripple_order(),
+						proto.ripple_priorities());
+    the_block_decoders.back()->set_decode_budget(proto.decode_budget());
+    the_block_decoders.back()->enable_attempt_throttling(proto.attempt_step());
+  }
+  the_block_decoders.resize(size);
+  first_slot = 0;
+}
+
+void lt_decoder::release_completed() {
+  while (has_enqueued && has_decoded() && window_size() > 1 &&
+	 window_decoder(1).received_count() > 0) {
+    auto bn(blockno_counter);
+    flush_small_blockno(bn.next());
+  }
+}
+
+void lt_decoder::enable_elimination(std::size_t max_unknowns) {
+  for (auto &bd : the_block_decoders) {
+    bd->enable_elimination(max_unknowns);
+  }
+}
+
+std::size_t lt_decoder::elimination_limit() const {
+  return the_block_decoders.front()->elimination_limit();
+}
+
+void lt_decoder::enable_xor_schedule(std::size_t threads) {
+  for (auto &bd : the_block_decoders) {
+    bd->enable_xor_schedule(threads);
+  }
+}
+
+std::size_t lt_decoder::xor_schedule_threads() const {
+  return window_decoder(0).xor_schedule_threads();
+}
+
+void lt_decoder::enable_parallel_peeling(std::size_t threads) {
+  for (auto &bd : the_block_decoders) {
+    bd->enable_parallel_peeling(threads);
+  }
+}
+
+std::size_t lt_decoder::parallel_peeling_threads() const {
+  return window_decoder(0).parallel_peeling_threads();
+}
+
+void lt_decoder::set_decoded_callback(block_decoder::decoded_callback cb) {
+  for (auto &bd : the_block_decoders) {
+    bd->set_decoded_callback(cb);
+  }
+}
+
+void lt_decoder::set_block_sink(block_sink sink_) {
+  sink = std::move(sink_);
+}
+
+void lt_decoder::set_ripple_order(mp::ripple_order order,
+				  const std::vector<std::size_t> &priorities) {
+  for (auto &bd : the_block_decoders) {
+    bd->set_ripple_order(order, priorities);
+  }
+}
+
+void lt_decoder::set_decode_budget(std::size_t max_decoded) {
+  for (auto &bd : the_block_decoders) {
+    bd->set_decode_budget(max_decoded);
+  }
+}
+
+void lt_decoder::enable_attempt_throttling(double step) {
+  for (auto &bd : the_block_decoders) {
+    bd->enable_attempt_throttling(step);
+  }
+}
+
+double lt_decoder::success_probability(std::size_t extra) const {
+  return window_decoder(0).success_probability(extra);
+}
+
+std::size_t lt_decoder::needed_estimate() const {
+  return window_decoder(0).needed_estimate();
 }
 
 bool lt_decoder::has_decoded() const {
-  return the_block_decoder.has_decoded();
+  return window_decoder(0).has_decoded();
 }
 
 std::size_t lt_decoder::block_size() const {
-  return the_block_decoder.block_size();
+  return window_decoder(0).block_size();
 }
 
 std::size_t lt_decoder::K() const {
@@ -151,15 +282,15 @@ circular_counter<std::size_t> lt_decoder::block_number_counter() const {
 }
 
 int lt_decoder::block_seed() const {
-  return the_block_decoder.seed();
+  return window_decoder(0).seed();
 }
 
 size_t lt_decoder::received_count() const {
-  return the_block_decoder.received_count();
+  return window_decoder(0).received_count();
 }
 
 size_t lt_decoder::decoded_count() const {
-  return the_block_decoder.decoded_count();
+  return window_decoder(0).decoded_count();
 }
 
 size_t lt_decoder::queue_size() const {
@@ -194,13 +325,46 @@ bool lt_decoder::operator!() const {
   return !has_queued_packets();
 }
 
+block_decoder &lt_decoder::window_decoder(std::size_t n) {
+  return *the_block_decoders[(first_slot + n) % the_block_decoders.size()];
+}
+
+const block_decoder &lt_decoder::window_decoder(std::size_t n) const {
+  return *the_block_decoders[(first_slot + n) % the_block_decoders.size()];
+}
+
+void lt_decoder::enqueue_block(block_decoder &dec, std::size_t blockno_) {
+  dec.run_pending();
+  if (sink) {
+    dec.write_block(sink_block);
+    sink(blockno_, sink_block);
+  }
+  else {
+    the_output_queue.push_shallow(dec.partial_begin(),
+				  dec.partial_end());
+  }
+  tot_dec_count += dec.decoded_count();
+  tot_failed_count += K() - dec.decoded_count();
+}
+
+void lt_decoder::enqueue_empty_block(std::size_t blockno_) {
+  if (sink) {
+    sink_block.assign(K(), 0);
+    sink(blockno_, sink_block);
+  }
+  else {
+    const std::vector<packet> empty_block(K());
+    the_output_queue.push_shallow(empty_block.cbegin(),
+				  empty_block.cend());
+  }
+  tot_failed_count += K();
+}
+
 void lt_decoder::enqueue_partially_decoded() {
   if (has_enqueued) return;
 
-  the_output_queue.push_shallow(the_block_decoder.partial_begin(),
-				the_block_decoder.partial_end());
-  tot_dec_count += the_block_decoder.decoded_count();
-  tot_failed_count += K() - the_block_decoder.decoded_count();
+  block_decoder &dec = window_decoder(0);
+  enqueue_block(dec, blockno());
 
   has_enqueued = true;
 
@@ -209,7 +373,7 @@ void lt_decoder::enqueue_partially_decoded() {
 		     << " blockno="
 		     << blockno()
 		     << " decoded_pkts="
-		     << the_block_decoder.decoded_count();
+		     << dec.decoded_count();
     //<< " avg_mp_time="
     //<< the_block_decoder.average_message_passing_time()
     //		     << " avg_mp_setup_time="
@@ -218,7 +382,7 @@ void lt_decoder::enqueue_partially_decoded() {
     //		     << average_push_time();
 #endif
 
-  if (the_block_decoder.has_decoded())
+  if (dec.has_decoded())
     BOOST_LOG_SEV(basic_lg, log::debug) <<
       "Decoder enqueued a fully decoded block";
   else
@@ -227,7 +391,7 @@ void lt_decoder::enqueue_partially_decoded() {
 }
 
 const base_row_generator &lt_decoder::row_generator() const {
-  return the_block_decoder.row_generator();
+  return the_block_decoders.front()->row_generator();
 }
 
 }
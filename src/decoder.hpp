@@ -2,6 +2,9 @@
 #define UEP_DECODER_HPP
 
 #include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
 
 #include "block_decoder.hpp"
 #include "block_queues.hpp"
@@ -20,12 +23,26 @@ namespace uep {
  *  block is manually discarded. The decoded packets are buffered in a
  *  FIFO queue and can be extraced one by one using next_decoded, or
  *  using the iterator pair for the last decoded block.
+ *
+ *  To receive from an interleaved lt_encoder the decoder can keep a
+ *  window of block_decoders, one for each block that may be
+ *  open at the encoder, see interleave_depth(std::size_t). The window
+ *  can be extended by some more blocks to decode the packets that are
+ *  reordered across blocks, see reorder_window(std::size_t). The
+ *  current block is the oldest one in the window and the blocks are
+ *  always released in order: each one as soon as it is decoded and
+ *  all the previous ones are released, or when it leaves the window
+ *  because a newer block is received.
  */
 class lt_decoder {
 public:
   /** The collection of parameters required to setup the decoder. */
   typedef robust_lt_parameter_set parameter_set;
   typedef block_decoder::const_block_iterator const_block_iterator;
+  /** Function called with the block number and the content of each
+   *  released block.
+   */
+  typedef std::function<void(std::size_t, const block_buffer&)> block_sink;
 
   /** Maximum allowed value for the block numbers.
    *  The decoder expects that it loops back to zero after this value.
@@ -91,6 +108,91 @@ public:
    */
   void flush_n_blocks(std::size_t n);
 
+  /** Set the number of consecutive blocks that can receive packets
+   *  at the same time. This must match the interleave depth of the
+   *  encoder and can only be changed before the first packet is
+   *  pushed.
+   */
+  void interleave_depth(std::size_t depth);
+  /** Return the number of consecutive blocks that can receive
+   *  packets at the same time.
+   */
+  std::size_t interleave_depth() const;
+
+  /** Keep `n` more blocks after the interleave depth, so that the
+   *  packets that arrive after some packets of the following blocks
+   *  are still decoded. A block that is not decoded is released when
+   *  a packet more than interleave_depth() + n - 1 blocks ahead is
+   *  received. This can only be changed before the first packet is
+   *  pushed.
+   */
+  void reorder_window(std::size_t n);
+  /** Return the number of blocks added to the window to handle the
+   *  reordering.
+   */
+  std::size_t reorder_window() const;
+
+  /** Solve the residual system of each block by Gaussian elimination
+   *  when the message passing stalls with at most `max_unknowns`
+   *  missing input packets. 0 disables it.
+   *  \sa block_decoder::enable_elimination
+   */
+  void enable_elimination(std::size_t max_unknowns);
+  /** Return the limit set by enable_elimination(). */
+  std::size_t elimination_limit() const;
+  /** Execute the XORs of each block after the peeling with the given
+   *  number of threads. \sa block_decoder::enable_xor_schedule
+   */
+  void enable_xor_schedule(std::size_t threads);
+  /** Return the value used by the current block. */
+  std::size_t xor_schedule_threads() const;
+  /** Peel the large blocks with the given number of threads.
+   *  \sa block_decoder::enable_parallel_peeling
+   */
+  void enable_parallel_peeling(std::size_t threads);
+  /** Return the value used by the current block. */
+  std::size_t parallel_peeling_threads() const;
+
+  /** Call `cb` with the block number, the position and the value of
+   *  each input packet as soon as it is decoded, before the block is
+   *  released by next_decoded().
+   *  \sa block_decoder::set_decoded_callback
+   */
+  void set_decoded_callback(block_decoder::decoded_callback cb);
+
+  /** Pass each released block to `sink` as one contiguous buffer,
+   *  instead of queueing its packets for next_decoded(). The decoded
+   *  packets are evaluated directly into the buffer, which is reused
+   *  for all the blocks. An empty function restores the queue.
+   *  \sa block_decoder::write_block
+   */
+  void set_block_sink(block_sink sink);
+
+  /** Set the ripple order of each block.
+   *  \sa block_decoder::set_ripple_order
+   */
+  void set_ripple_order(mp::ripple_order order,
+			const std::vector<std::size_t> &priorities = {});
+  /** Limit the number of packets of each block decoded after each
+   *  push. \sa block_decoder::set_decode_budget
+   */
+  void set_decode_budget(std::size_t max_decoded);
+  /** Skip the decoding attempts that are unlikely to succeed. The
+   *  buffered packets are decoded before each block is released.
+   *  \sa block_decoder::enable_attempt_throttling
+   */
+  void enable_attempt_throttling(double step);
+
+  /** Estimate the probability that the current block is decoded once
+   *  `extra` more unique packets are received.
+   *  \sa block_decoder::success_probability
+   */
+  double success_probability(std::size_t extra) const;
+  /** Estimate how many more unique packets are needed to decode the
+   *  current block. \sa block_decoder::needed_estimate
+   */
+  std::size_t needed_estimate() const;
+
   /** Return true if the current block has been decoded. */
   bool has_decoded() const;
   /** Return the block size. */
@@ -138,10 +240,22 @@ private:
   log::default_logger basic_lg, perf_lg;
 
   output_block_queue the_output_queue;
-  block_decoder the_block_decoder;
+  /** One decoder for each block in the window, used as a ring
+   *  starting from first_slot.
+   */
+  std::vector<std::unique_ptr<block_decoder>> the_block_decoders;
+  std::size_t first_slot; /**< Index of the decoder of the current
+			   *   block.
+			   */
+  std::size_t the_interleave_depth; /**< Blocks open at the encoder. */
+  std::size_t the_reorder_window; /**< Additional blocks kept to
+				   *   handle the reordering.
+				   */
   circular_counter<std::size_t> blockno_counter;
   bool has_enqueued; /**< Set to true when the current block has been
 			decoded and enqueued in the_output_queue. */
+  block_sink sink; /**< Receives the blocks instead of the queue. */
+  block_buffer sink_block; /**< Buffer passed to the sink. */
 
   std::size_t uniq_recv_count; /**< Total number of unique received
 				  packets. */
@@ -153,10 +267,30 @@ private:
 				     *	 an incoming packet.
 				     */
 
+  /** Return the number of blocks that can receive packets. */
+  std::size_t window_size() const;
+  /** Create or destroy the block_decoders to match the window size. */
+  void resize_window(std::size_t size);
+  /** Move to the next blocks while the current one was released and
+   *  the following one has received some packets.
+   */
+  void release_completed();
+
+  /** Decoder of the block that follows the current one by `n`. */
+  block_decoder &window_decoder(std::size_t n);
+  /** Decoder of the block that follows the current one by `n`. */
+  const block_decoder &window_decoder(std::size_t n) const;
+
   /** If the current block was not yet enqueued, then do it even if it
    *  is not fully decoded. The missing packets will be empty.
    */
   void enqueue_partially_decoded();
+  /** Push the decoded packets of `dec` to the queue, or to the sink,
+   *  leaving empty the missing ones.
+   */
+  void enqueue_block(block_decoder &dec, std::size_t blockno_);
+  /** Push an empty block to the queue, or to the sink. */
+  void enqueue_empty_block(std::size_t blockno_);
 
   /** Used to push incomplete or empty blocks to the queue. This
    *  requires the target blockno to be within the comparison
@@ -199,13 +333,22 @@ void lt_decoder::push(Iter first, Iter last) {
     auto next = std::make_move_iterator(next_b);
 
     // Handle different block number
+    std::size_t offset = 0;
     if (blockno_counter.last() != static_cast<std::size_t>(bn)) {
       auto recv_blockno(blockno_counter);
       recv_blockno.set(bn);
       if (recv_blockno.is_after(blockno_counter)) {
-	BOOST_LOG(perf_lg) << "lt_decoder::push new_block blockno="
-			   << bn;
-	flush_small_blockno(bn); // Then push normally
+	std::size_t depth = window_size();
+	offset = blockno_counter.forward_distance(recv_blockno);
+	if (offset >= depth) {
+	  BOOST_LOG(perf_lg) << "lt_decoder::push new_block blockno="
+			     << bn;
+	  // Slide the window to end at bn, then push normally
+	  auto new_base(blockno_counter);
+	  new_base.next(offset - (depth - 1));
+	  flush_small_blockno(new_base.value());
+	  offset = depth - 1;
+	}
       }
       else {
 	BOOST_LOG(perf_lg) << "lt_decoder::push old_block blockno="
@@ -216,17 +359,18 @@ void lt_decoder::push(Iter first, Iter last) {
       }
     }
 
-    std::size_t pushed = the_block_decoder.push(i, next);
+    std::size_t pushed = window_decoder(offset).push(i, next);
     BOOST_LOG(perf_lg) << "lt_decoder::push uniq_pkts=" << pushed;
     uniq_recv_count += pushed;
     if (pushed != static_cast<std::size_t>(next - i))
       BOOST_LOG(perf_lg) << "lt_decoder::push duplicate_pkts blockno="
 			 << bn;
 
-    // Extract if fully decoded block (just once)
-    if (the_block_decoder) {
+    // Extract if fully decoded current block (just once)
+    if (offset == 0 && window_decoder(0)) {
       enqueue_partially_decoded();
     }
+    release_completed();
 
     i = next;
   }
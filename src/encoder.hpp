@@ -1,14 +1,18 @@
 #ifndef UEP_ENCODER_HPP
 #define UEP_ENCODER_HPP
 
+#include <algorithm>
 #include <chrono>
 #include <limits>
+#include <memory>
 #include <stdexcept>
 #include <utility>
+#include <vector>
 
 #include "block_encoder.hpp"
 #include "block_queues.hpp"
 #include "counter.hpp"
+#include "encoder_state.hpp"
 #include "log.hpp"
 #include "lt_param_set.hpp"
 #include "packets.hpp"
@@ -23,6 +27,12 @@ namespace uep {
  *  next_coded. The packets are XORed according to the rows generated
  *  by an lt_row_generator. The seed for the row generator is produced
  *  at each new block of K packets by an object of class Gen.
+ *
+ *  The encoder can keep more than one block open at once, see
+ *  interleave_depth(std::size_t). In that case the coded packets are
+ *  produced round-robin from the open blocks, so that a burst of
+ *  losses is spread over many blocks. The current block is always
+ *  the oldest open block.
  *  \sa fountain_decoder fountain
  */
 template<class Gen = std::random_device>
@@ -84,10 +94,14 @@ public:
     basic_lg(boost::log::keywords::channel = log::basic),
     perf_lg(boost::log::keywords::channel = log::performance),
     the_input_queue(rg->K()),
-    the_block_encoder(std::move(rg)),
-    seqno_counter(MAX_SEQNO),
+    seqno_counters(1, counter<std::size_t>(MAX_SEQNO)),
+    first_open(0),
+    open_count(0),
+    next_open(0),
+    partial_window(false),
     blockno_counter(MAX_BLOCKNO),
     tot_coded_count(0) {
+    the_block_encoders.push_back(std::make_unique<block_encoder>(std::move(rg)));
     blockno_counter.set(0);
   }
 
@@ -107,16 +121,24 @@ public:
     check_has_block();
   }
 
-  /** Generate the next coded packet from the current block. */
+  /** Generate the next coded packet. Without interleaving this uses
+   *  the current block, otherwise the open blocks take turns.
+   */
   fountain_packet next_coded() {
     using namespace std::chrono;
 
     auto tic = high_resolution_clock::now();
 
-    fountain_packet p(the_block_encoder.next_coded());
-    p.sequence_number(seqno_counter.next());
-    p.block_number(blockno_counter.last());
-    p.block_seed(the_block_encoder.seed());
+    std::size_t slot = open_slot(next_open);
+    block_encoder &enc = *the_block_encoders[slot];
+    auto bnc(blockno_counter);
+    bnc.next(next_open);
+
+    fountain_packet p(enc.next_coded());
+    p.sequence_number(seqno_counters[slot].next());
+    p.block_number(bnc.last());
+    p.block_seed(enc.seed());
+    if (open_count > 0) next_open = (next_open + 1) % open_count;
 
     duration<double> tdiff = high_resolution_clock::now() - tic;
     BOOST_LOG(perf_lg) << "lt_encoder::next_coded"
@@ -127,28 +149,24 @@ public:
   }
 
   /** Added for compatibility with UEP. This just discards the partial
-   *  block.
+   *  block. When interleaving, it also allows to encode with less
+   *  open blocks than the interleave depth, since no more input is
+   *  expected to fill the window.
    */
   void pad_partial_block() {
-    BOOST_LOG_SEV(basic_lg, log::error) <<
-      "pad_partial_block is not implemented by lt_encoder: drop partial block";
-    the_input_queue.clear();
+    if (the_input_queue.size() % K() != 0) {
+      BOOST_LOG_SEV(basic_lg, log::error) <<
+	"pad_partial_block is not implemented by lt_encoder: drop partial block";
+      the_input_queue.drop_partial_block();
+    }
+    partial_window = true;
   }
 
   /** Drop the current block of packets and prepare to encode the next
    *  one.
    */
   void next_block() {
-    BOOST_LOG(perf_lg) << "encoder::next_block coded_pkts="
-		       << coded_count();
-    tot_coded_count += coded_count();
-    the_input_queue.pop_block();
-    the_block_encoder.reset();
-    blockno_counter.next();
-    seqno_counter.reset();
-    BOOST_LOG_SEV(basic_lg, log::debug) << "Encoder skipped to the next block: "
-					<< blockno_counter.value();
-    check_has_block();
+    drop_blocks(1, 1);
   }
 
   /** Drop all the blocks up to the given block number.
@@ -156,27 +174,64 @@ public:
    *  packets to skip.
    */
   void next_block(std::size_t blockno_) {
-    decltype(blockno_counter) wanted_blockno(MAX_BLOCKNO);
-    wanted_blockno.set(blockno_);
-    std::size_t dist = blockno_counter.forward_distance(wanted_blockno);
-    if (dist == 0 || dist > BLOCK_WINDOW) return;
+    std::size_t dist = block_distance(blockno_);
+    if (dist == 0) return;
+    // Drop the current block and dist-1 queued blocks (this can fail)
+    drop_blocks(dist, dist);
+  }
 
-    // Drop dist-1 pkts from the queue (this can fail)
-    for (std::size_t i = 0; i < dist-1; ++i) {
-      the_input_queue.pop_block();
-      blockno_counter.next();
-    }
+  /** Drop the current block and jump to the given block number. The
+   *  packets of the skipped blocks are assumed to be already
+   *  discarded by the caller, so the queue is left untouched. This
+   *  takes constant time regardless of the number of skipped blocks.
+   */
+  void skip_to_block(std::size_t blockno_) {
+    std::size_t dist = block_distance(blockno_);
+    if (dist == 0) return;
+    drop_blocks(std::min(dist, open_count), dist);
+  }
 
-    // Last skip
-    next_block();
+  /** Set the number of blocks that are encoded at the same time. The
+   *  depth can only be changed when there are no open blocks.
+   */
+  void interleave_depth(std::size_t depth) {
+    if (depth < 1)
+      throw std::invalid_argument("The interleave depth must be at least 1");
+    if (open_count > 0)
+      throw std::logic_error("Cannot change the interleave depth with open blocks");
+
+    const block_encoder &proto = *the_block_encoders.front();
+    while (the_block_encoders.size() < depth) {
+      auto enc = std::make_unique<block_encoder>(proto.row_generator().clone());
+      enc->enable_xor_cache(proto.xor_cache_max_size());
+      the_block_encoders.push_back(std::move(enc));
+    }
+    the_block_encoders.resize(depth);
+    seqno_counters.assign(depth, counter<std::size_t>(MAX_SEQNO));
+    first_open = 0;
+    next_open = 0;
+    partial_window = false;
+    check_has_block();
   }
 
-  /** Return true when the encoder has been passed at least K packets
-   *  and is ready to produce a coded packet.
+  /** Return the number of blocks that are encoded at the same time. */
+  std::size_t interleave_depth() const { return the_block_encoders.size(); }
+
+  /** Return the number of blocks that are currently open. */
+  std::size_t open_block_count() const { return open_count; }
+
+  /** Return true when the encoder has been passed enough packets to
+   *  fill the interleaving window and is ready to produce a coded
+   *  packet. After pad_partial_block() one open block is enough.
    */
-  bool has_block() const { return the_block_encoder.can_encode(); }
+  bool has_block() const {
+    return open_count > 0 &&
+      (open_count == the_block_encoders.size() || partial_window);
+  }
   /** The block size. */
-  std::size_t block_size() const { return the_block_encoder.block_size(); }
+  std::size_t block_size() const {
+    return the_block_encoders.front()->block_size();
+  }
   /** Alias of block_size. */
   std::size_t K() const { return block_size(); }
   /** The sequence number of the current block. */
@@ -185,10 +240,12 @@ public:
   circular_counter<std::size_t> block_number_counter() const {
     return blockno_counter;
   }
-  /** The sequence number of the last generated packet. */
-  std::size_t seqno() const { return seqno_counter.last(); }
+  /** The sequence number of the last generated packet of the
+   *  current block.
+   */
+  std::size_t seqno() const { return seqno_counters[first_open].last(); }
   /** The seed used in the current block. */
-  int block_seed() const { return the_block_encoder.seed(); }
+  int block_seed() const { return open_encoder(0).seed(); }
   /** The number of queued packets, excluding the current block. */
   std::size_t queue_size() const { return the_input_queue.queue_size(); }
   /** Total number of packets held by the encoder. */
@@ -196,7 +253,7 @@ public:
 
   /** Return the lt_row_generator used. */
   const base_row_generator &row_generator() const {
-    return the_block_encoder.row_generator();
+    return the_block_encoders.front()->row_generator();
   }
   /** Return a copy of the RNG used to produce the block seeds. */
   seed_generator_type seed_generator() const { return the_seed_gen; }
@@ -214,7 +271,7 @@ public:
    *  current block.
    */
   std::size_t coded_count() const {
-    return the_block_encoder.output_count();
+    return open_encoder(0).output_count();
   }
 
   /** Return the total number of coded packets that were produced. */
@@ -222,6 +279,78 @@ public:
     return tot_coded_count;
   }
 
+  /** Cache the XOR of the pairs of packets that are used more than
+   *  once in a block. \sa block_encoder::enable_xor_cache()
+   */
+  void enable_xor_cache(std::size_t max_bytes) {
+    for (auto &enc : the_block_encoders) {
+      enc->enable_xor_cache(max_bytes);
+    }
+  }
+  /** Return the total number of packet XORs performed. */
+  std::size_t xor_count() const {
+    std::size_t n = 0;
+    for (const auto &enc : the_block_encoders) n += enc->xor_count();
+    return n;
+  }
+  /** Return the total number of packet XORs avoided by the cache. */
+  std::size_t saved_xor_count() const {
+    std::size_t n = 0;
+    for (const auto &enc : the_block_encoders) n += enc->saved_xor_count();
+    return n;
+  }
+  /** Return the fraction of the XOR cache lookups that were hits in
+   *  the encoder of the current block.
+   */
+  double xor_cache_hit_rate() const {
+    return open_encoder(0).xor_cache_hit_rate();
+  }
+
+  /** Return a snapshot of the encoder that can be passed to
+   *  restore_state() to resume the encoding. This is not supported
+   *  when interleaving.
+   */
+  lt_encoder_state save_state() const {
+    check_not_interleaved();
+    lt_encoder_state st;
+    st.blockno = blockno_counter.last();
+    st.block_seed = block_seed();
+    st.coded_count = coded_count();
+    st.total_coded_count = tot_coded_count;
+    st.packets.reserve(the_input_queue.size());
+    for (std::size_t i = 0; i < the_input_queue.size(); ++i) {
+      st.packets.push_back(the_input_queue.at(i));
+    }
+    return st;
+  }
+
+  /** Replace the current state with a snapshot produced by
+   *  save_state(). The next coded packet is the one that the saved
+   *  encoder would have produced.
+   */
+  void restore_state(const lt_encoder_state &st) {
+    check_not_interleaved();
+    the_input_queue.clear();
+    close_blocks(open_count);
+    partial_window = false;
+    for (const packet &p : st.packets) {
+      the_input_queue.push(p);
+    }
+    blockno_counter.set(st.blockno);
+    tot_coded_count = st.total_coded_count;
+
+    check_has_block();
+    if (has_block()) {
+      open_encoder(0).set_seed(st.block_seed);
+      open_encoder(0).skip_rows(st.coded_count);
+      if (st.coded_count > 0)
+	seqno_counters[first_open].set(st.coded_count - 1);
+    }
+    BOOST_LOG_SEV(basic_lg, log::debug) << "Encoder restored at block "
+					<< blockno_counter.value()
+					<< " seqno " << st.coded_count;
+  }
+
   /** Is true when coded packets can be produced. */
   explicit operator bool() const { return has_block(); }
   /** Is true when there is not a full block available. */
@@ -231,22 +360,100 @@ private:
   log::default_logger basic_lg, perf_lg;
 
   input_block_queue the_input_queue;
-  block_encoder the_block_encoder;
+  /** One encoder for each open block, used as a ring starting from
+   *  first_open.
+   */
+  std::vector<std::unique_ptr<block_encoder>> the_block_encoders;
+  /** Sequence number counter of each block encoder. */
+  std::vector<counter<std::size_t>> seqno_counters;
+  std::size_t first_open; /**< Index of the encoder of the current
+			   *   block.
+			   */
+  std::size_t open_count; /**< Number of open blocks. */
+  std::size_t next_open; /**< Offset from the current block of the
+			  *   block that produces the next coded
+			  *   packet.
+			  */
+  bool partial_window; /**< Allow to encode without a full window of
+			*   open blocks.
+			*/
   seed_generator_type the_seed_gen;
-  counter<std::size_t> seqno_counter;
   circular_counter<std::size_t> blockno_counter;
   std::size_t tot_coded_count; /**< Count the total number of coded
 				*   packets.
 				*/
 
-  /** If the block_encoder is empty and the queue has a full block,
-   *  load the block_decoder. Also generate a new block seed.
+  /** Return the forward distance from the current block number to
+   *  the given one, or 0 if it is not in the comparison window.
+   */
+  std::size_t block_distance(std::size_t blockno_) const {
+    decltype(blockno_counter) wanted_blockno(MAX_BLOCKNO);
+    wanted_blockno.set(blockno_);
+    std::size_t dist = blockno_counter.forward_distance(wanted_blockno);
+    if (dist > BLOCK_WINDOW) return 0;
+    return dist;
+  }
+
+  /** Index in the_block_encoders of the n-th open block. */
+  std::size_t open_slot(std::size_t n) const {
+    return (first_open + n) % the_block_encoders.size();
+  }
+
+  /** Encoder of the n-th open block. */
+  block_encoder &open_encoder(std::size_t n) {
+    return *the_block_encoders[open_slot(n)];
+  }
+
+  /** Encoder of the n-th open block. */
+  const block_encoder &open_encoder(std::size_t n) const {
+    return *the_block_encoders[open_slot(n)];
+  }
+
+  /** Throw a logic_error if more than one block can be open. */
+  void check_not_interleaved() const {
+    if (the_block_encoders.size() > 1)
+      throw std::logic_error("Not supported by an interleaved encoder");
+  }
+
+  /** Reset the encoders of the oldest `n` open blocks. */
+  void close_blocks(std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+      tot_coded_count += coded_count();
+      open_encoder(0).reset();
+      seqno_counters[first_open].reset();
+      first_open = open_slot(1);
+    }
+    open_count -= n;
+    next_open = next_open >= n ? next_open - n : 0;
+  }
+
+  /** Pop `npop` blocks from the input queue and advance the block
+   *  number by `nskip`.
+   */
+  void drop_blocks(std::size_t npop, std::size_t nskip) {
+    BOOST_LOG(perf_lg) << "encoder::next_block coded_pkts="
+		       << coded_count()
+		       << " xors=" << xor_count()
+		       << " saved_xors=" << saved_xor_count();
+    close_blocks(std::min(nskip, open_count));
+    the_input_queue.pop_blocks(npop);
+    blockno_counter.next(nskip);
+    BOOST_LOG_SEV(basic_lg, log::debug) << "Encoder skipped to the next block: "
+					<< blockno_counter.value();
+    check_has_block();
+  }
+
+  /** Open the full blocks in the queue until the interleaving window
+   *  is filled. Also generate a new seed for each of them.
    */
   void check_has_block() {
-    if (the_input_queue && !the_block_encoder) {
-      the_block_encoder.set_block_shallow(the_input_queue.block_begin(),
-					  the_input_queue.block_end());
-      the_block_encoder.set_seed(the_seed_gen());
+    while (open_count < the_block_encoders.size() &&
+	   open_count < the_input_queue.block_count()) {
+      block_encoder &enc = open_encoder(open_count);
+      enc.set_block_shallow(the_input_queue.block(open_count));
+      enc.set_seed(the_seed_gen());
+      seqno_counters[open_slot(open_count)].reset();
+      ++open_count;
 
       BOOST_LOG_SEV(basic_lg, log::trace) << "The encoder has a new block";
     }
@@ -0,0 +1,144 @@
+#include "encoder_state.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "rw_utils.hpp"
+
+using namespace std;
+using namespace uep;
+using namespace uep::rw_utils;
+
+namespace {
+
+/** Identifies a checkpoint and its format version. */
+const char checkpoint_magic[] = {'U', 'E', 'P', 'C', 1};
+
+void write_u32(ostream &out, std::uint32_t n) {
+  char b[sizeof(n)];
+  write_hton<std::uint32_t>(n, b, b + sizeof(n));
+  out.write(b, sizeof(n));
+}
+
+std::uint32_t read_u32(istream &in) {
+  char b[sizeof(std::uint32_t)];
+  in.read(b, sizeof(b));
+  if (!in) throw runtime_error("Truncated checkpoint");
+  std::uint32_t n;
+  read_ntoh<std::uint32_t>(n, b, b + sizeof(b));
+  return n;
+}
+
+void write_u64(ostream &out, std::uint64_t n) {
+  write_u32(out, static_cast<std::uint32_t>(n >> 32));
+  write_u32(out, static_cast<std::uint32_t>(n));
+}
+
+std::uint64_t read_u64(istream &in) {
+  std::uint64_t hi = read_u32(in);
+  std::uint64_t lo = read_u32(in);
+  return (hi << 32) | lo;
+}
+
+void write_buffer(ostream &out, const buffer_type &buf) {
+  write_u64(out, buf.size());
+  out.write(buf.data(), buf.size());
+}
+
+buffer_type read_buffer(istream &in) {
+  buffer_type buf(read_u64(in));
+  in.read(buf.data(), buf.size());
+  if (!in) throw runtime_error("Truncated checkpoint");
+  return buf;
+}
+
+void write_fountain_packets(ostream &out,
+			    const vector<fountain_packet> &pkts) {
+  write_u64(out, pkts.size());
+  for (const fountain_packet &fp : pkts) {
+    write_u32(out, fp.getPriority());
+    write_buffer(out, fp.buffer());
+  }
+}
+
+vector<fountain_packet> read_fountain_packets(istream &in) {
+  vector<fountain_packet> pkts(read_u64(in));
+  for (fountain_packet &fp : pkts) {
+    fp.setPriority(read_u32(in));
+    fp.buffer() = read_buffer(in);
+  }
+  return pkts;
+}
+
+void write_sizes(ostream &out, const vector<std::size_t> &v) {
+  write_u64(out, v.size());
+  for (std::size_t n : v) write_u64(out, n);
+}
+
+vector<std::size_t> read_sizes(istream &in) {
+  vector<std::size_t> v(read_u64(in));
+  for (std::size_t &n : v) n = read_u64(in);
+  return v;
+}
+
+}
+
+namespace uep {
+
+void write_checkpoint(std::ostream &out, const stream_checkpoint &cp) {
+  out.write(checkpoint_magic, sizeof(checkpoint_magic));
+
+  const lt_encoder_state &lt = cp.encoder.lt_state;
+  write_u64(out, lt.blockno);
+  write_u32(out, lt.block_seed);
+  write_u64(out, lt.coded_count);
+  write_u64(out, lt.total_coded_count);
+  write_u64(out, lt.packets.size());
+  for (const packet &p : lt.packets) write_buffer(out, p.buffer());
+
+  write_fountain_packets(out, cp.encoder.queued);
+  write_u64(out, cp.encoder.seqno);
+  write_u64(out, cp.encoder.pktsize);
+
+  const nal_reader_state &rd = cp.reader;
+  write_u64(out, static_cast<std::uint64_t>(rd.trace_offset));
+  write_buffer(out, rd.last_nal);
+  write_u64(out, rd.last_prio);
+  write_fountain_packets(out, rd.queued);
+  write_sizes(out, rd.tot_added_oh);
+  write_sizes(out, rd.tot_size);
+
+  if (!out) throw runtime_error("Failed to write the checkpoint");
+}
+
+stream_checkpoint read_checkpoint(std::istream &in) {
+  char magic[sizeof(checkpoint_magic)];
+  in.read(magic, sizeof(magic));
+  if (!in || !equal(magic, magic + sizeof(magic), checkpoint_magic))
+    throw runtime_error("Not a valid checkpoint");
+
+  stream_checkpoint cp;
+  lt_encoder_state &lt = cp.encoder.lt_state;
+  lt.blockno = read_u64(in);
+  lt.block_seed = read_u32(in);
+  lt.coded_count = read_u64(in);
+  lt.total_coded_count = read_u64(in);
+  lt.packets.resize(read_u64(in));
+  for (packet &p : lt.packets) p.buffer() = read_buffer(in);
+
+  cp.encoder.queued = read_fountain_packets(in);
+  cp.encoder.seqno = read_u64(in);
+  cp.encoder.pktsize = read_u64(in);
+
+  nal_reader_state &rd = cp.reader;
+  rd.trace_offset = static_cast<std::int64_t>(read_u64(in));
+  rd.last_nal = read_buffer(in);
+  rd.last_prio = read_u64(in);
+  rd.queued = read_fountain_packets(in);
+  rd.tot_added_oh = read_sizes(in);
+  rd.tot_size = read_sizes(in);
+
+  return cp;
+}
+
+}
@@ -0,0 +1,80 @@
+#ifndef UEP_ENCODER_STATE_HPP
+#define UEP_ENCODER_STATE_HPP
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "base_types.hpp"
+#include "packets.hpp"
+
+namespace uep {
+
+/** Snapshot of the state of an lt_encoder.
+ *  It holds everything that is needed to produce the same coded
+ *  packets that the original encoder would have produced for the
+ *  current block. The state of the seed generator is not saved, so
+ *  the following blocks will use fresh seeds.
+ *  \sa lt_encoder::save_state()
+ */
+struct lt_encoder_state {
+  std::size_t blockno; /**< Current block number. */
+  std::uint32_t block_seed; /**< Seed of the current block. */
+  std::size_t coded_count; /**< Number of coded packets already
+			    *   produced for the current block.
+			    */
+  std::size_t total_coded_count; /**< Total number of coded packets. */
+  std::vector<packet> packets; /**< All the held input packets,
+				*   starting from the current block.
+				*/
+};
+
+/** Snapshot of the state of a uep_encoder.
+ *  \sa uep_encoder::save_state()
+ */
+struct uep_encoder_state {
+  lt_encoder_state lt_state; /**< State of the underlying LT encoder. */
+  std::vector<fountain_packet> queued; /**< Packets waiting in the
+					*   priority queues, with the
+					*   priority set and the UEP
+					*   seqno in the payload.
+					*/
+  std::size_t seqno; /**< Next UEP sequence number. */
+  std::size_t pktsize; /**< Size of the pushed packets. */
+};
+
+/** Position of a nal_reader inside the stream.
+ *  \sa nal_reader::save_state()
+ */
+struct nal_reader_state {
+  std::int64_t trace_offset; /**< Offset of the next trace line, or -1
+			      *   at the end of the trace.
+			      */
+  buffer_type last_nal; /**< NAL read but not yet packed. */
+  std::size_t last_prio; /**< Priority of last_nal. */
+  std::vector<fountain_packet> queued; /**< Packets ready to be
+					*   extracted.
+					*/
+  std::vector<std::size_t> tot_added_oh; /**< Overhead per priority. */
+  std::vector<std::size_t> tot_size; /**< Bytes read per priority. */
+};
+
+/** State of an encoding session, enough to resume a stream at the
+ *  same block.
+ */
+struct stream_checkpoint {
+  uep_encoder_state encoder;
+  nal_reader_state reader;
+};
+
+/** Write the checkpoint to a binary stream. */
+void write_checkpoint(std::ostream &out, const stream_checkpoint &cp);
+/** Read a checkpoint written by write_checkpoint. Throw a
+ *  runtime_error if the data is malformed.
+ */
+stream_checkpoint read_checkpoint(std::istream &in);
+
+}
+
+#endif
@@ -1,10 +1,11 @@
 #ifndef UEP_LAZY_XOR_HPP
 #define UEP_LAZY_XOR_HPP
 
-#include <forward_list>
-#include <memory>
+#include <array>
 #include <stdexcept>
-#include <unordered_set>
+#include <utility>
+
+#include <boost/optional.hpp>
 
 #include "message_passing.hpp"
 #include "utils.hpp"
@@ -14,65 +15,128 @@ namespace uep {
 /** Class used to delay the application of XORs on some other type.
  *  This class accumulates pointers to XOR-able objects and actually
  *  performs the XOR between them either upon a call to evaluate() or
- *  when the pointer list exceeds a maximum size.
+ *  when the number of pending objects exceeds MAX_SIZE.
+ *
+ *  The pointers are kept in a fixed-size array inside the object,
+ *  together with at most one owned value that holds the result of the
+ *  previous evaluations. The XORs are applied in place to the owned
+ *  value, which is never shared, so no heap allocation is needed once
+ *  it exists. The objects pointed to must outlive the lazy_xor and
+ *  all the lazy_xors that XOR with it: they are usually kept in an
+ *  arena owned by the user (see block_decoder).
+ *
+ *  When the object is emptied by a move-assignment from an object
+ *  without an owned value, the storage of the old value is kept and
+ *  reused by the next evaluation, through the copy-assignment of T.
+ *
+ *  The evaluation is memoized: the pending objects are replaced by
+ *  the owned result, so that evaluating again only returns a
+ *  reference to it. Concurrent calls to evaluate() on the same
+ *  object are not safe.
 */
 template <class T, std::size_t MAX_SIZE = 1,
 	  class XorableTraits = utils::symbol_traits<T>>
 class lazy_xor {
+  static_assert(MAX_SIZE > 0, "MAX_SIZE must be positive");
+
 public:
   typedef T base_type;
   typedef XorableTraits xorable_traits;
 
   /* Build an empty lazy_xor. */
-  lazy_xor() : size_(0) {}
+  lazy_xor() : has_value(false), n_ptrs(0) {}
   /* Build a lazy_xor using the intitial value pointed to by initial.
    * The pointer must remain valid during the lifetime of the lazy_xor
    * object.
    */
-  explicit lazy_xor(const T *initial) {
-    to_xor.push_front(initial);
-    size_ = 1;
+  explicit lazy_xor(const T *initial) : has_value(false), n_ptrs(1) {
+    ptrs[0] = initial;
   }
   /** Construct a lazy_xor using a copy of the initial value. */
-  explicit lazy_xor(const T &initial) {
-    shared_to_xor.push_front(std::make_shared<const T>(initial));
-    size_ = 1;
+  explicit lazy_xor(const T &initial) :
+    value(initial), has_value(true), n_ptrs(0) {}
+  /** Construct a lazy_xor by moving from the initial value. The XORs
+   *  will be applied in place to it, so it must not share its data
+   *  with other objects.
+   */
+  explicit lazy_xor(T &&initial) :
+    value(std::move(initial)), has_value(true), n_ptrs(0) {}
+
+  /** Copy-construct a lazy_xor. The owned value is copied. */
+  lazy_xor(const lazy_xor &other) :
+    has_value(other.has_value),
+    ptrs(other.ptrs),
+    n_ptrs(other.n_ptrs) {
+    if (other.has_value) value = *other.value;
   }
-  /** Construct a lazy_xor by moving from the initial value. */
-  explicit lazy_xor(T &&initial) {
-    shared_to_xor.push_front(std::make_shared<const T>(std::move(initial)));
-    size_ = 1;
+  /** Move-construct a lazy_xor, leaving the other one empty. */
+  lazy_xor(lazy_xor &&other) :
+    value(std::move(other.value)),
+    has_value(other.has_value),
+    ptrs(other.ptrs),
+    n_ptrs(other.n_ptrs) {
+    other.value = boost::none;
+    other.clear();
+  }
+
+  /** Copy-assign a lazy_xor. The owned value is copied. */
+  lazy_xor &operator=(const lazy_xor &other) {
+    if (this != &other) {
+      if (other.has_value) assign_value(*other.value);
+      has_value = other.has_value;
+      ptrs = other.ptrs;
+      n_ptrs = other.n_ptrs;
+    }
+    return *this;
+  }
+  /** Move-assign a lazy_xor, leaving the other one empty. The storage
+   *  of the owned value is kept when the other object has none.
+   */
+  lazy_xor &operator=(lazy_xor &&other) {
+    if (this != &other) {
+      if (other.has_value) {
+	value = std::move(other.value);
+	other.value = boost::none;
+      }
+      has_value = other.has_value;
+      ptrs = other.ptrs;
+      n_ptrs = other.n_ptrs;
+      other.clear();
+    }
+    return *this;
   }
 
   /** Swap this with the other lazy_xor. */
   void swap(lazy_xor &other) {
     using std::swap;
-    swap(to_xor, other.to_xor);
-    swap(shared_to_xor, other.shared_to_xor);
-    swap(size_, other.size_);
+    swap(value, other.value);
+    swap(has_value, other.has_value);
+    swap(ptrs, other.ptrs);
+    swap(n_ptrs, other.n_ptrs);
   }
 
-  /** Cumulative XOR with another object.  This only merges the set of
-   *  pointers to the objects that will be XORed at eval time. If the
-   *  list of pointers exceeds MAX_SIZE the evaluation will take place
-   *  immediately.
+  /** Cumulative XOR with another object. The pointers held by the
+   *  other object are added to the pending ones, while its owned
+   *  value, if any, is XORed immediately. If the pending objects
+   *  exceed MAX_SIZE the evaluation will take place immediately.
    */
   void xor_with(const lazy_xor &other) {
-    for (auto i = other.to_xor.cbegin(); i != other.to_xor.cend(); ++i) {
-      to_xor.push_front(*i);
+    if (&other == this) {
+      lazy_xor copy(other);
+      xor_with(copy);
+      return;
     }
-    for (auto i = other.shared_to_xor.cbegin();
-	 i != other.shared_to_xor.cend(); ++i) {
-      shared_to_xor.push_front(*i);
+
+    if (other.has_value) {
+      if (has_value) xorable_traits::inplace_xor(*value, *other.value);
+      else {
+	assign_value(*other.value);
+	has_value = true;
+      }
+      if (size() > MAX_SIZE) collapse();
     }
-    size_ += other.size_;
-
-    if (size_ > MAX_SIZE) {
-      T eval_result = evaluate();
-      to_xor.clear();
-      shared_to_xor.clear();
-      shared_to_xor.push_front(std::make_shared<const T>(std::move(eval_result)));
-      size_ = 1;
+    for (std::size_t i = 0; i < other.n_ptrs; ++i) {
+      push_ptr(other.ptrs[i]);
     }
   }
 
@@ -81,55 +145,97 @@ public:
    *  the lazy_xor object.
    */
   void xor_with(const T *other) {
-    xor_with(lazy_xor(other));
+    push_ptr(other);
   }
 
-  /** Perform the XOR between the underlying objects and return the
-   *  result.  This method throws a runtime_error when called on empty
-   *  objects
+  /** Perform the XOR between the underlying objects and return a
+   *  reference to the result. The result replaces the underlying
+   *  objects, so the reference stays valid until this object is
+   *  modified, moved or destroyed. This method throws a runtime_error
+   *  when called on empty objects.
    */
-  T evaluate() const {
+  const T &evaluate() const {
     if (empty()) throw std::runtime_error("Cannot evaluate an empty lazy_xor");
-    auto i = to_xor.cbegin();
-    auto j = shared_to_xor.cbegin();
+    if (!has_value && n_ptrs == 1) return *ptrs[0];
+    if (n_ptrs > 0) collapse();
+    return *value;
+  }
 
-    T e;
-    if (i != to_xor.cend()) e = *(*i++);
-    else e = *(*j++);
+  /** Perform the XOR between the underlying objects and write the
+   *  result to the range starting at `out`, without building a
+   *  temporary T. The traits must provide copy_to() and xor_to().
+   *  This method throws a runtime_error when called on empty objects.
+   */
+  template <class OutPtr>
+  void evaluate_into(OutPtr out) const {
+    if (empty()) throw std::runtime_error("Cannot evaluate an empty lazy_xor");
+    std::size_t i = 0;
+    if (has_value) xorable_traits::copy_to(out, *value);
+    else xorable_traits::copy_to(out, *ptrs[i++]);
 
-    for (; i != to_xor.cend(); ++i) {
-      xorable_traits::inplace_xor(e, *(*i));
-    }
-    for (; j != shared_to_xor.cend(); ++j) {
-      xorable_traits::inplace_xor(e, *(*j));
+    for (; i < n_ptrs; ++i) {
+      xorable_traits::xor_to(out, *ptrs[i]);
     }
-
-    return e;
   }
 
   /** Return true when the set of objects to XOR is empty. */
-  bool empty() const { return size_ == 0; }
-  /** Return the size of the set of objects to XOR. */
-  std::size_t size() const { return size_; }
+  bool empty() const { return size() == 0; }
+  /** Return the size of the set of objects to XOR, including the
+   *  owned value.
+   */
+  std::size_t size() const { return n_ptrs + (has_value ? 1 : 0); }
+  /** Return the maximum number of objects to XOR before the
+   *  evaluation.
+   */
+  static constexpr std::size_t max_size() { return MAX_SIZE; }
 
   /** Return the same as !empty(). */
   explicit operator bool() const { return !empty(); }
   /** Return the same as empty(). */
   bool operator!() const { return empty(); }
 
-  //friend bool operator==(const lazy_xor<T> &lhs, const lazy_xor<T> &rhs);
-
 private:
+  /** Result of the previous evaluations, owned by this object. When
+   *  has_value is false it can hold some unused storage.
+   */
+  mutable boost::optional<T> value;
+  mutable bool has_value; /**< True when value is part of the XOR. */
   /** Pointers to the objects to xor. */
-  std::forward_list<const T*> to_xor;
-  /** Shared pointers to the objects to xor. This is used because
-   *  `to_xor` is not suitable to hold the automatic evaluation
-   *  results.
+  mutable std::array<const T*, MAX_SIZE> ptrs;
+  mutable std::size_t n_ptrs; /**< Number of valid pointers in ptrs. */
+
+  /** Make the object empty, keeping the storage of the value. */
+  void clear() {
+    has_value = false;
+    n_ptrs = 0;
+  }
+
+  /** Copy x to the owned value, reusing its storage if any. */
+  void assign_value(const T &x) const {
+    if (value) *value = x;
+    else value = x;
+  }
+
+  /** Add a pointer to the objects to XOR, evaluating when needed. */
+  void push_ptr(const T *p) {
+    if (n_ptrs == MAX_SIZE) collapse();
+    ptrs[n_ptrs++] = p;
+    if (size() > MAX_SIZE) collapse();
+  }
+
+  /** XOR the pending objects into the owned value. The value of the
+   *  lazy_xor does not change. If an XOR fails before the owned value
+   *  is set the object is left unchanged.
    */
-  std::forward_list<std::shared_ptr<const T>> shared_to_xor;
-  std::size_t size_; /**< Combined size of the two lists. The
-		      *   forward_list does not keep the size.
-		      */
+  void collapse() const {
+    std::size_t i = 0;
+    if (!has_value) assign_value(*ptrs[i++]);
+    for (; i < n_ptrs; ++i) {
+      xorable_traits::inplace_xor(*value, *ptrs[i]);
+    }
+    has_value = true;
+    n_ptrs = 0;
+  }
 };
 
 /** XOR-equal operator between lazy_xors. \sa lazy_xor::xor_with */
@@ -1,7 +1,12 @@
 #ifndef UEP_LT_PARAM_SET_HPP
 #define UEP_LT_PARAM_SET_HPP
 
+#include <cstdint>
 #include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace uep {
 
@@ -23,6 +28,20 @@ struct robust_lt_parameter_set {
   double delta;
 };
 
+/** Parameter set used to construct the sliding-window encoders and
+ *  decoders. Each coded packet mixes the last W input packets
+ *  according to a robust_soliton_distribution.
+ */
+struct sliding_window_parameter_set {
+  std::size_t W; /**< Number of input packets covered by each coded
+		  *   packet.
+		  */
+  double c; /**< Coefficient c of the robust soltion distribution. */
+  double delta; /**< Failure prob bound of the robust soliton
+		 *   distribution.
+		 */
+};
+
 /** Parameter set used to add redoundancy
 	Repeat factors: one for each priority
 	Expanding factor: applied to the whole sequence
@@ -41,6 +60,10 @@ struct lt_uep_parameter_set {
   double delta; /**< Failure prob bound of the robust soliton
 		 *   distribution.
      */
+  std::vector<double> WPs; /**< Window selection probabilities. When
+			    *   not empty, expanding windows are used
+			    *   instead of the RFs and EF.
+			    */
   //std::string streamName;
 };
 
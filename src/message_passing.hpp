@@ -3,10 +3,13 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <ctime>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <stdexcept>
 #include <type_traits>
-#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -14,6 +17,7 @@
 
 #include "counter.hpp"
 #include "skip_false_iterator.hpp"
+#include "thread_pool.hpp"
 
 namespace uep { namespace mp {
 
@@ -65,6 +69,15 @@ using mp::symbol_traits;
 
 namespace uep { namespace mp {
 
+/** Order in which mp_context processes the outputs of degree one. */
+enum class ripple_order {
+  fifo, /**< In the order they reached degree one. */
+  priority, /**< Most important input symbol first. The importance
+	     *   is given to mp_context::set_ripple_order().
+	     */
+  lowest_index /**< Lowest input symbol index first. */
+};
+
 /** Class used to execute the message-passing algorithm.
  *
  *  The context controls a bipartite graph, which is initialized with
@@ -72,19 +85,38 @@ namespace uep { namespace mp {
  *  from each output symbol, together with its edges. Parallel edges
  *  are allowed and are handled like all the others.
  *
+ *  The graph is stored in flat arrays that are reused after a
+ *  reset(): the symbols are kept in two contiguous vectors, each
+ *  output only keeps its degree and the XOR of the indices of the
+ *  inputs it is still linked to, and the edges are stored in a single
+ *  arena where the edges of each input form a chain. When an output
+ *  reaches degree one the XOR of the indices is the index of its last
+ *  input, so the edges never need to be erased.
+ *
  *  The algorithm can be run many times without losing the previously
  *  decoded packets.
  *
+ *  When the peeling stalls, the context can optionally solve the
+ *  residual system by Gaussian elimination over GF(2) (see
+ *  enable_elimination()). This requires copy-constructible symbols.
+ *
+ *  The XORs of the symbols can also be deferred to the end of each
+ *  run (see enable_xor_schedule()): the peeling then works on the
+ *  graph alone and the recorded XORs are executed in a second phase,
+ *  grouped by target symbol. For very large graphs the peeling
+ *  itself can be split among several threads (see
+ *  enable_parallel_peeling()).
+ *
  *  The generic symbol type `Symbol` is manipulated through the traits
  *  class `SymbolTraits`.
  */
 template <class Symbol, class SymbolTraits = symbol_traits<Symbol>>
 class mp_context {
 private:
-  /** Struct used to carry additional information with the symbols. */
-  struct node;
-  /** Converter from node pointers to a const reference to their symbol. */
-  struct node2sym;
+  /** Wrapper used to store the symbols in a vector. */
+  struct slot;
+  /** Converter from slots to a const reference to their symbol. */
+  struct slot2sym;
 public:
   /** The type used to represent the symbols. */
   typedef Symbol symbol_type;
@@ -92,24 +124,30 @@ public:
   typedef SymbolTraits symbol_traits;
   /** Constant iterator over the input symbols. */
   typedef boost::transform_iterator<
-    node2sym,
-    typename std::vector<std::unique_ptr<node>>::const_iterator
+    slot2sym,
+    typename std::vector<slot>::const_iterator
     > inputs_iterator;
   /** Constant iterator that skips false (empty) symbols. */
   typedef utils::skip_false_iterator<inputs_iterator> decoded_iterator;
+  /** Function called with the index and the value of each decoded
+   *  input symbol.
+   */
+  typedef std::function<void(std::size_t, const symbol_type&)> decoded_callback;
 
   /** Construct a context with in_size default-constructed input symbols. */
   explicit mp_context(std::size_t in_size);
 
   /** Copy constructor. */
-  mp_context(const mp_context &other);
+  mp_context(const mp_context &other) = default;
   /** Move constructor. */
-  mp_context(mp_context &&other);
+  mp_context(mp_context &&other) = default;
 
-  /** Copy-assignment operator. */
-  mp_context &operator=(const mp_context &other);
+  /** Copy-assignment operator. The storage of this context is reused
+   *  when it is large enough.
+   */
+  mp_context &operator=(const mp_context &other) = default;
   /** Move-assignment operator. */
-  mp_context &operator=(mp_context &&other);
+  mp_context &operator=(mp_context &&other) = default;
 
   /** Auto-generated destructor. */
   ~mp_context() = default;
@@ -136,13 +174,102 @@ public:
    */
   void run();
 
-  /** Reset the context to the initial state. */
+  /** Solve the residual system with Gaussian elimination when the
+   *  peeling stalls with at most `max_unknowns` undecoded input
+   *  symbols. A value of 0 disables the elimination, which is the
+   *  default. The elimination is attempted again only after new
+   *  output symbols are added.
+   */
+  void enable_elimination(std::size_t max_unknowns);
+  /** Return the limit set by enable_elimination(). */
+  std::size_t elimination_limit() const;
+  /** Return the number of input symbols decoded by the Gaussian
+   *  elimination since the last reset.
+   */
+  std::size_t eliminated_count() const;
+
+  /** Set the order in which the outputs of degree one are processed.
+   *  With ripple_order::priority, `priorities` must give a value for
+   *  each input symbol, where lower values are more important. The
+   *  order matters when the peeling is stopped early by the decode
+   *  budget. The default is ripple_order::fifo.
+   */
+  void set_ripple_order(ripple_order order,
+			std::vector<std::size_t> priorities = {});
+  /** Return the order set by set_ripple_order(). */
+  ripple_order get_ripple_order() const;
+  /** Return the priorities set by set_ripple_order(). */
+  const std::vector<std::size_t> &ripple_priorities() const;
+  /** Stop each run() after the peeling decodes `max_decoded` input
+   *  symbols. The next run() resumes from the remaining outputs of
+   *  degree one. A value of 0 removes the limit, which is the
+   *  default. The parallel peeling is not used when a budget is set.
+   */
+  void set_decode_budget(std::size_t max_decoded);
+  /** Return the budget set by set_decode_budget(). */
+  std::size_t decode_budget() const;
+  /** Return the number of outputs of degree one still waiting to be
+   *  processed.
+   */
+  std::size_t ripple_size() const;
+
+  /** Call `cb` from run() as soon as the value of each input symbol
+   *  is known. The symbols are notified once, in decoding order, and
+   *  always from the thread that calls run(). An empty function
+   *  disables the notifications.
+   */
+  void set_decoded_callback(decoded_callback cb);
+
+  /** Split run() in two phases. The peeling updates only the graph
+   *  and records which symbols must be XOR-ed, then the recorded
+   *  schedule is executed before run() returns: each target symbol
+   *  is XOR-ed with all its sources at once, and the targets that do
+   *  not depend on each other are split among `threads` threads. A
+   *  value of 0 XORs the symbols during the peeling, which is the
+   *  default.
+   */
+  void enable_xor_schedule(std::size_t threads);
+  /** Return the number of threads set by enable_xor_schedule(). */
+  std::size_t xor_schedule_threads() const;
+  /** Return the part of the last run_duration() spent executing the
+   *  XOR schedule.
+   */
+  double schedule_duration() const;
+
+  /** Peel the graph with `threads` threads when it has at least
+   *  `min_inputs` input symbols. All the outputs of degree one are
+   *  processed together, as a wavefront, and the outputs and inputs
+   *  are sharded among the threads so that each one updates only its
+   *  own part of the graph. This enables the XOR schedule with the
+   *  same number of threads if it was disabled. A value of 0 or 1
+   *  keeps the sequential peeling, which is the default.
+   */
+  void enable_parallel_peeling(std::size_t threads,
+			       std::size_t min_inputs = DEFAULT_PARALLEL_MIN_INPUTS);
+  /** Return the number of threads set by enable_parallel_peeling(). */
+  std::size_t parallel_peeling_threads() const;
+
+  /** Default minimum number of input symbols for the parallel peeling. */
+  static constexpr std::size_t DEFAULT_PARALLEL_MIN_INPUTS = 8192;
+
+  /** Reset the context to the initial state. The allocated storage is
+   *  kept to build the next graph.
+   */
   void reset();
 
+  /** Reserve the storage for the given number of output symbols and
+   *  edges.
+   */
+  void reserve(std::size_t out_size, std::size_t edge_count);
+
   /** Return the number of input symbols. */
   std::size_t input_size() const;
   /** Return the number of output symbols. */
   std::size_t output_size() const;
+  /** Return the number of output symbols that are still linked to
+   *  some undecoded input symbol.
+   */
+  std::size_t residual_output_count() const;
   /** Return the number of input symbols that have been correctly
    *  decoded up to the last call to run().
    */
@@ -179,27 +306,125 @@ public:
   decoded_iterator decoded_symbols_end() const;
 
 private:
-  /** Pointers to the input nodes. These manage the lifetime of the
-   *  nodes.
-   */
-  std::vector<std::unique_ptr<node>> inputs;
-  /** Pointers to the output nodes. These manage the lifetime of the
-   *  nodes.
-   */
-  std::vector<std::unique_ptr<node>> outputs;
-
-  node *degone_first; /**< Start of the linked list of nodes with
-		       *   degree one.
+  /** Edge between an input and an output symbol. */
+  struct edge {
+    std::size_t output; /**< Index of the output symbol. */
+    std::size_t next; /**< Next edge of the same input symbol, or
+		       *   no_edge.
 		       */
-  node *degone_last; /**< End of the linked list of nodes with
-		      *   degree one.
-		      */
-  std::size_t degone_size; /**< Size of the list of nodes with degree
-			    *   one.
+  };
+
+  /** Marks the end of a chain of edges. */
+  static constexpr std::size_t no_edge =
+    std::numeric_limits<std::size_t>::max();
+  /** Minimum number of independent targets given to each thread
+   *  while executing the XOR schedule.
+   */
+  static constexpr std::size_t min_thread_targets = 16;
+
+  std::vector<slot> inputs; /**< The input symbols. */
+  std::vector<std::size_t> in_first_edge; /**< Index of the first
+					   *   edge of each input in
+					   *   the arena, or no_edge.
+					   */
+  std::vector<slot> outputs; /**< The output symbols. */
+  std::vector<symbol_type> spare_outputs; /**< Output symbols removed
+					   *   by reset(), kept to
+					   *   reuse their storage.
+					   */
+  std::vector<std::size_t> out_degree; /**< Number of undecoded inputs
+					*   linked to each output.
+					*/
+  std::vector<std::size_t> out_xor; /**< XOR of the indices of the
+				     *   undecoded inputs linked to
+				     *   each output.
+				     */
+  std::vector<edge> edges; /**< Arena holding all the edges. */
+
+  std::vector<std::size_t> degone; /**< FIFO queue of the outputs that
+				    *   reached degree one. The ones
+				    *   whose degree changed again are
+				    *   skipped.
+				    */
+  std::size_t degone_head; /**< Position of the first element of
+			    *   degone.
 			    */
+  std::size_t degone_size; /**< Number of outputs with degree one. */
+  ripple_order order_; /**< Order of the outputs of degree one. */
+  std::vector<std::size_t> in_priority; /**< Importance of each input
+					 *   for ripple_order::priority.
+					 */
+  std::vector<std::pair<std::size_t,std::size_t>> degone_heap; /**<
+   * Min-heap of (key, output) pairs of degree one, used instead of
+   * degone when the order is not FIFO.
+   */
+  std::size_t decode_budget_; /**< Max decoded inputs per run, or 0. */
   std::size_t decoded_count_; /**< Number of currenlty decoded
 			       *   packets.
 			       */
+  std::size_t max_unknowns_; /**< Limit for the Gaussian elimination. */
+  std::size_t eliminated_count_; /**< Number of inputs decoded by the
+				  *   Gaussian elimination.
+				  */
+  std::size_t elim_outputs; /**< Number of outputs when the last
+			     *   elimination failed.
+			     */
+
+  std::size_t xor_threads; /**< Threads used to execute the XOR
+			    *   schedule, or 0 to XOR immediately.
+			    */
+  std::vector<std::size_t> in_level; /**< Dependency level of the
+				      *   inputs decoded in the pending
+				      *   schedule, or no_edge.
+				      */
+  std::vector<std::pair<std::size_t,std::size_t>> sched_decoded; /**<
+   * Pending (input, output) pairs, where the output symbol becomes
+   * the input symbol, in decoding order.
+   */
+  std::vector<std::pair<std::size_t,std::size_t>> sched_xor; /**<
+   * Pending (output, input) XORs.
+   */
+  std::vector<std::pair<std::size_t,std::size_t>> sched_done; /**<
+   * Entries of the last executed schedule, to be notified.
+   */
+  std::vector<std::size_t> sched_order; /**< Decoded entries sorted by
+					 *   level.
+					 */
+  std::vector<std::size_t> sched_targets; /**< Outputs that still need
+					   *   the pending XORs.
+					   */
+  std::vector<std::size_t> sched_level_first; /**< Start of each level
+					       *   in sched_order.
+					       */
+  std::vector<std::size_t> sched_level_pos; /**< Next free position of
+					     *   each level while
+					     *   filling sched_order.
+					     */
+
+  /** Per-thread state of the parallel peeling. */
+  struct wave_shard {
+    /** Pairs sent to each other shard by this one. */
+    std::vector<std::vector<std::pair<std::size_t,std::size_t>>> to;
+    /** (input, output) pairs decoded by this shard. */
+    std::vector<std::pair<std::size_t,std::size_t>> decoded;
+    /** (output, input) XORs recorded by this shard. */
+    std::vector<std::pair<std::size_t,std::size_t>> xors;
+    /** Outputs of this shard that reached degree one. */
+    std::vector<std::size_t> next;
+  };
+
+  std::size_t peel_threads; /**< Threads used by the peeling. */
+  std::size_t parallel_min_inputs; /**< Minimum input size for the
+				    *   parallel peeling.
+				    */
+  std::vector<wave_shard> shards; /**< State of the peeling threads. */
+  std::vector<std::size_t> wavefront; /**< Outputs of degree one
+				       *   processed together.
+				       */
+  std::shared_ptr<thread_pool> pool; /**< Threads used by the
+				      *   parallel sections. Shared by
+				      *   the copies of the context.
+				      */
 
   double last_run_time; /**< The time that the
 			 *   last call to run
@@ -212,20 +437,50 @@ private:
   stat::average_counter _avg_run_time; /**< Mesaure the average ripple
 				       *   size since the last reset.
 				       */
+  double last_schedule_time; /**< Time spent in execute_schedule()
+			      *   by the last run.
+			      */
+  decoded_callback decoded_cb; /**< Called for each decoded input. */
+
+  /** Append an output to the queue of degree one outputs. */
+  void insert_degone(std::size_t out);
+  /** Remove and return the next output from the queue of degree one
+   *  outputs, or no_edge if it is empty.
+   */
+  std::size_t pop_degone();
 
-  /** Insert an output node in the list of degree one nodes. */
-  void insert_degone(node *np);
-  /** Remove an output node from the list of degree one nodes. */
-  void remove_degone(node *np);
-
-  /** Decode a symbol with output degree one and return it. If there
-   *  are no decodable symbols return nullptr.
+  /** Decode a symbol with output degree one and return its index. If
+   *  there are no decodable symbols return no_edge.
+   */
+  std::size_t decode_degree_one();
+  /** Process the last decoded input symbol to XOR it with the
+   *  connected output symbols and lower their degree.
+   */
+  void process_ripple(std::size_t last_decoded);
+  /** Try to decode the residual system with Gaussian elimination and
+   *  propagate the decoded inputs. Return the number of decoded
+   *  inputs.
    */
-  node *decode_degree_one();
-  /** Process the last decoded input symbol to remove its edges and
-   *  XOR it with the connected output symbols.
+  std::size_t eliminate(std::true_type copyable);
+  /** Do nothing when the symbols cannot be copied. */
+  std::size_t eliminate(std::false_type copyable);
+  /** Execute the pending XOR schedule so that all the decoded inputs
+   *  and the outputs still in the graph hold their actual value.
    */
-  void process_ripple(node *last_decoded);
+  void execute_schedule();
+  /** Call f(i) for i in [0, n), splitting the range among the
+   *  schedule threads when it is large enough.
+   */
+  template <class F>
+  void parallel_for(std::size_t n, F f);
+  /** Pass the decoded input symbol to the callback, if any. */
+  void notify_decoded(std::size_t in);
+  /** Make sure the pool has at least n threads. */
+  void ensure_pool(std::size_t n);
+  /** Peel all the current outputs of degree one in parallel, one
+   *  wavefront at a time, recording the XOR schedule.
+   */
+  void peel_wavefronts();
 
 public: // old typedefs
   typedef inputs_iterator input_symbols_iterator;
@@ -233,125 +488,50 @@ public: // old typedefs
 };
 
 template <class Symbol, class SymbolTraits>
-struct mp_context<Symbol,SymbolTraits>::node {
-  symbol_type symbol; /**< The symbol carried by this node. */
-  std::size_t position; /**< The position of this node in the inputs
-			 *   or outputs list.
-			 */
-  node *next; /**< Pointer to the next node in a linked list. Is used
-	       *   by the degone list.
-	       */
-  node *prev; /**< Pointer to the previous node in a linked list. Is
-	       *   used by the degone list.
-	       */
-  std::unordered_multiset<std::size_t> edges; /**< Indices of the nodes
-					       *   connected to this.
-					       */
+struct mp_context<Symbol,SymbolTraits>::slot {
+  symbol_type symbol; /**< The symbol. */
 };
 
 template <class Symbol, class SymbolTraits>
-struct mp_context<Symbol,SymbolTraits>::node2sym {
-  const symbol_type &operator()(const std::unique_ptr<node> &np) const {
-    return np->symbol;
+struct mp_context<Symbol,SymbolTraits>::slot2sym {
+  const symbol_type &operator()(const slot &s) const {
+    return s.symbol;
   }
 };
 
 //// mp_context<Symbol,SymbolTraits> template definitions ////
 
+template <class Symbol, class SymbolTraits>
+constexpr std::size_t mp_context<Symbol,SymbolTraits>::no_edge;
+
+template <class Symbol, class SymbolTraits>
+constexpr std::size_t mp_context<Symbol,SymbolTraits>::min_thread_targets;
+
+template <class Symbol, class SymbolTraits>
+constexpr std::size_t mp_context<Symbol,SymbolTraits>::DEFAULT_PARALLEL_MIN_INPUTS;
+
 template <class Symbol, class SymbolTraits>
 mp_context<Symbol,SymbolTraits>::mp_context(std::size_t in_size) :
-  degone_first(nullptr),
-  degone_last(nullptr),
+  in_first_edge(in_size, no_edge),
+  degone_head(0),
   degone_size(0),
+  order_(ripple_order::fifo),
+  decode_budget_(0),
   decoded_count_(0),
-  last_run_time(0) {
-  // Build in_size empty input nodes
-  inputs.resize(in_size);
-  std::size_t pos = 0;
-  for (std::unique_ptr<node> &np : inputs) {
-    np = std::make_unique<node>();
-    np->symbol = symbol_traits::create_empty();
-    np->position = pos++;
-  }
-}
-
-template <class Symbol, class SymbolTraits>
-mp_context<Symbol,SymbolTraits>::mp_context(mp_context &&other) :
-  inputs(std::move(other.inputs)),
-  outputs(std::move(other.outputs)),
-  degone_first(std::move(other.degone_first)),
-  degone_last(std::move(other.degone_last)),
-  degone_size(std::move(other.degone_size)),
-  decoded_count_(std::move(other.decoded_count_)),
-  last_run_time(std::move(other.last_run_time)),
-  _ripple_size(std::move(other._ripple_size)),
-  _avg_run_time(std::move(other._avg_run_time)) {
-
-}
-
-template <class Symbol, class SymbolTraits>
-mp_context<Symbol,SymbolTraits>::mp_context(const mp_context &other) :
-  inputs(other.inputs.size()), // copied after
-  outputs(other.outputs.size()), // copied after
-  degone_first(nullptr), // The list must be rebuilt
-  degone_last(nullptr), // The list must be rebuilt
-  degone_size(0), // The list must be rebuilt
-  decoded_count_(other.decoded_count_),
-  last_run_time(other.last_run_time),
-  _ripple_size(other._ripple_size),
-  _avg_run_time(other._avg_run_time) {
-  std::transform(other.inputs.cbegin(), other.inputs.cend(), inputs.begin(),
-		 [](const std::unique_ptr<node> &p){
-		   return std::make_unique<node>(*p);
-		 });
-  std::transform(other.outputs.cbegin(), other.outputs.cend(), outputs.begin(),
-		 [this](const std::unique_ptr<node> &p){
-		   auto p_new = std::make_unique<node>(*p);
-		   if (p_new->edges.size() == 1) {
-		     insert_degone(p_new.get());
-		   }
-		   return p_new;
-		 });
-}
-
-template <class Symbol, class SymbolTraits>
-mp_context<Symbol,SymbolTraits> &mp_context<Symbol,SymbolTraits>::operator=(mp_context &&other) {
-  inputs = std::move(other.inputs);
-  outputs = std::move(other.outputs);
-  degone_first = std::move(other.degone_first);
-  degone_last = std::move(other.degone_last);
-  degone_size = std::move(other.degone_size);
-  decoded_count_ = std::move(other.decoded_count_);
-  last_run_time = std::move(other.last_run_time);
-  _ripple_size = std::move(other._ripple_size);
-  _avg_run_time = std::move(other._avg_run_time);
-  return *this;
-}
-
-template <class Symbol, class SymbolTraits>
-mp_context<Symbol,SymbolTraits> &mp_context<Symbol,SymbolTraits>::operator=(const mp_context &other) {
-  inputs.resize(other.inputs.size()); // copied after
-  outputs.resize(other.outputs.size()); // copied after
-  degone_first = nullptr; // The list must be rebuilt
-  degone_last = nullptr; // The list must be rebuilt
-  degone_size = 0; // The list must be rebuilt
-  decoded_count_ = other.decoded_count_;
-  last_run_time = other.last_run_time;
-  _ripple_size = other._ripple_size;
-  _avg_run_time = other._avg_run_time;
-  std::transform(other.inputs.cbegin(), other.inputs.cend(), inputs.begin(),
-		 [](const std::unique_ptr<node> &p){
-		   return std::make_unique<node>(*p);
-		 });
-  std::transform(other.outputs.cbegin(), other.outputs.cend(), outputs.begin(),
-		 [this](const std::unique_ptr<node> &p){
-		   auto p_new = std::make_unique<node>(*p);
-		   if (p_new->edges.size() == 1) {
-		     insert_degone(p_new.get());
-		   }
-		   return p_new;
-		 });
-  return *this;
+  max_unknowns_(0),
+  eliminated_count_(0),
+  elim_outputs(0),
+  xor_threads(0),
+  in_level(in_size, no_edge),
+  peel_threads(0),
+  parallel_min_inputs(DEFAULT_PARALLEL_MIN_INPUTS),
+  last_run_time(0),
+  last_schedule_time(0) {
+  // Build in_size empty input symbols
+  inputs.reserve(in_size);
+  for (std::size_t i = 0; i < in_size; ++i) {
+    inputs.push_back(slot{symbol_traits::create_empty()});
+  }
 }
 
 template <class Symbol, class SymbolTraits>
@@ -366,77 +546,105 @@ template <class Symbol, class SymbolTraits>
 template <class EdgeIter>
 void mp_context<Symbol,SymbolTraits>::add_output(symbol_type &&s,
 						 EdgeIter edges_begin, EdgeIter edges_end) {
-  // Move the new symbol in an output node
-  outputs.push_back(std::make_unique<node>());
-  std::unique_ptr<node> &np = outputs.back();
-  np->symbol = std::move(s);
-  np->position = outputs.size() - 1;
+  std::size_t out = outputs.size();
+  if (spare_outputs.empty()) {
+    outputs.push_back(slot{std::move(s)});
+  }
+  else {
+    outputs.push_back(slot{std::move(spare_outputs.back())});
+    spare_outputs.pop_back();
+    outputs.back().symbol = std::move(s);
+  }
+  symbol_type &out_sym = outputs.back().symbol;
+  std::size_t degree = 0;
+  std::size_t xor_idx = 0;
   // Add the edges
   for (EdgeIter i = edges_begin; i != edges_end; ++i) {
-    std::unique_ptr<node> &inp = inputs.at(*i);
-    if (!symbol_traits::is_empty(inp->symbol)) {
+    std::size_t in = *i;
+    const symbol_type &in_sym = inputs.at(in).symbol;
+    if (!symbol_traits::is_empty(in_sym)) {
       // input is already decoded, ignore edge and XOR the new output
-      symbol_traits::inplace_xor(np->symbol, inp->symbol);
+      symbol_traits::inplace_xor(out_sym, in_sym);
     }
-    else {
-      np->edges.insert(*i); // Allow parallel edges
-      inp->edges.insert(np->position);
+    else { // Allow parallel edges
+      edges.push_back(edge{out, in_first_edge[in]});
+      in_first_edge[in] = edges.size() - 1;
+      ++degree;
+      xor_idx ^= in;
     }
   }
+  out_degree.push_back(degree);
+  out_xor.push_back(xor_idx);
   // Check if degree one
-  if (np->edges.size() == 1) {
-    insert_degone(np.get());
+  if (degree == 1) {
+    insert_degone(out);
   }
 }
 
 template <class Symbol, class SymbolTraits>
-typename mp_context<Symbol,SymbolTraits>::node *
-mp_context<Symbol,SymbolTraits>::decode_degree_one() {
-  for (node *out = degone_first; out != nullptr; out = out->next) {
-    std::size_t inp_index = *(out->edges.cbegin());
-    std::unique_ptr<node> &inp = inputs[inp_index];
-
-    // Remove the edge
-    out->edges.clear();
-    inp->edges.erase(out->position); // Ok with parallel: must be a single edge
-
-    remove_degone(out);
-
-    if (symbol_traits::is_empty(inp->symbol)) { // Not already decoded
-      symbol_traits::swap(inp->symbol, out->symbol);
+std::size_t mp_context<Symbol,SymbolTraits>::decode_degree_one() {
+  for (;;) {
+    std::size_t out = pop_degone();
+    if (out == no_edge) break;
+    if (out_degree[out] != 1) continue; // Already processed
+
+    // Remove the last edge: the input is given by the XOR
+    out_degree[out] = 0;
+    --degone_size;
+    std::size_t in = out_xor[out];
+
+    symbol_type &in_sym = inputs[in].symbol;
+    if (symbol_traits::is_empty(in_sym) &&
+	in_level[in] == no_edge) { // Not already decoded
+      if (xor_threads > 0) {
+	in_level[in] = 0;
+	sched_decoded.emplace_back(in, out);
+      }
+      else {
+	symbol_traits::swap(in_sym, outputs[out].symbol);
+	notify_decoded(in);
+      }
       ++decoded_count_;
-      return inp.get();
+      return in;
     }
   }
-  return nullptr;
+  degone.clear();
+  degone_head = 0;
+  return no_edge;
 }
 
 template <class Symbol, class SymbolTraits>
-void mp_context<Symbol,SymbolTraits>::process_ripple(node *last_decoded) {
+void mp_context<Symbol,SymbolTraits>::process_ripple(std::size_t last_decoded) {
+  const symbol_type &in_sym = inputs[last_decoded].symbol;
   // Follow each edge of the decoded input
-  for (auto i = last_decoded->edges.cbegin();
-       i != last_decoded->edges.cend();
-       ++i) {
-    std::unique_ptr<node> &outp = outputs[*i];
-
-    // Update the output symbol
-    symbol_traits::inplace_xor(outp->symbol, last_decoded->symbol);
-
-    // Remove the edge (in <- out)
-    auto e = outp->edges.find(last_decoded->position);
-    outp->edges.erase(e); // Delete only one edge
+  for (std::size_t e = in_first_edge[last_decoded];
+       e != no_edge;
+       e = edges[e].next) {
+    std::size_t out = edges[e].output;
+    // Skip the output that decoded the input
+    if (out_degree[out] == 0) continue;
+
+    // Update the output symbol and remove the edge (in <- out)
+    if (xor_threads > 0) {
+      sched_xor.emplace_back(out, last_decoded);
+    }
+    else {
+      symbol_traits::inplace_xor(outputs[out].symbol, in_sym);
+    }
+    out_xor[out] ^= last_decoded;
+    std::size_t degree = --out_degree[out];
 
-    // Update degree one list
-    if (outp->edges.size() == 1) {
-      insert_degone(outp.get());
+    // Update degree one queue
+    if (degree == 1) {
+      insert_degone(out);
     }
-    else if (outp->edges.size() == 0) {
-      remove_degone(outp.get());
+    else if (degree == 0) {
+      --degone_size;
     }
   }
 
   // Remove all edges (in -> out)
-  last_decoded->edges.clear();
+  in_first_edge[last_decoded] = no_edge;
 }
 
 template <class Symbol, class SymbolTraits>
@@ -447,20 +655,394 @@ void mp_context<Symbol,SymbolTraits>::run() {
   }
 
   std::clock_t t = std::clock();
+  last_schedule_time = 0;
 
+  if (peel_threads > 1 && input_size() >= parallel_min_inputs &&
+      decode_budget_ == 0) {
+    peel_wavefronts();
+  }
+
+  std::size_t budget_left = decode_budget_ > 0 ? decode_budget_ : no_edge;
   for (;;) {
+    if (budget_left == 0) break;
     _ripple_size.add_sample(degone_size);
-    node *last_decoded = decode_degree_one();
-    if (has_decoded() || last_decoded == nullptr) {
+    std::size_t last_decoded = decode_degree_one();
+    if (has_decoded()) {
+      break;
+    }
+    if (last_decoded != no_edge) {
+      process_ripple(last_decoded);
+      --budget_left;
+      continue;
+    }
+
+    // The peeling stalled: try the elimination on the new outputs
+    if (input_size() - decoded_count_ > max_unknowns_ ||
+	output_size() == elim_outputs) {
+      break;
+    }
+    elim_outputs = output_size();
+    execute_schedule();
+    if (eliminate(std::is_copy_constructible<symbol_type>()) == 0) {
       break;
     }
-    process_ripple(last_decoded);
   }
+  execute_schedule();
 
   last_run_time = static_cast<double>(std::clock() - t) / CLOCKS_PER_SEC;
   _avg_run_time.add_sample(last_run_time);
 }
 
+template <class Symbol, class SymbolTraits>
+std::size_t mp_context<Symbol,SymbolTraits>::eliminate(std::false_type) {
+  return 0;
+}
+
+template <class Symbol, class SymbolTraits>
+std::size_t mp_context<Symbol,SymbolTraits>::eliminate(std::true_type) {
+  typedef std::uint64_t word_t;
+  constexpr std::size_t word_bits = std::numeric_limits<word_t>::digits;
+
+  // Map the undecoded inputs to the columns
+  std::vector<std::size_t> col_input;
+  for (std::size_t i = 0; i < inputs.size(); ++i) {
+    if (symbol_traits::is_empty(inputs[i].symbol)) col_input.push_back(i);
+  }
+  const std::size_t n_cols = col_input.size();
+  const std::size_t n_words = (n_cols + word_bits - 1) / word_bits;
+
+  // Build the bit-packed rows from the remaining edges. The parallel
+  // edges cancel out.
+  std::vector<std::size_t> out_row(outputs.size(), no_edge);
+  std::vector<std::size_t> row_output;
+  std::vector<word_t> bits;
+  for (std::size_t c = 0; c < n_cols; ++c) {
+    for (std::size_t e = in_first_edge[col_input[c]];
+	 e != no_edge;
+	 e = edges[e].next) {
+      std::size_t out = edges[e].output;
+      if (out_degree[out] == 0) continue;
+      if (out_row[out] == no_edge) {
+	out_row[out] = row_output.size();
+	row_output.push_back(out);
+	bits.resize(bits.size() + n_words, 0);
+      }
+      bits[out_row[out] * n_words + c / word_bits] ^=
+	word_t(1) << (c % word_bits);
+    }
+  }
+  const std::size_t n_rows = row_output.size();
+  if (n_rows == 0) return 0;
+
+  // Gauss-Jordan elimination on the bits only, the row operations
+  // are recorded and applied to the symbols later
+  auto row_bits = [&bits, n_words](std::size_t r) {
+    return bits.data() + r * n_words;
+  };
+  std::vector<std::size_t> order(n_rows);
+  for (std::size_t r = 0; r < n_rows; ++r) order[r] = r;
+  std::vector<std::size_t> pivot(n_cols, no_edge);
+  std::vector<bool> is_pivot(n_rows, false);
+  std::vector<std::pair<std::size_t,std::size_t>> ops; // (dst, src)
+  std::size_t rank = 0;
+  for (std::size_t c = 0; c < n_cols; ++c) {
+    const std::size_t w = c / word_bits;
+    const word_t mask = word_t(1) << (c % word_bits);
+    std::size_t k = rank;
+    while (k < n_rows && !(row_bits(order[k])[w] & mask)) ++k;
+    if (k == n_rows) continue; // Not determined by the received rows
+    std::swap(order[rank], order[k]);
+    const std::size_t pr = order[rank];
+    const word_t *prow = row_bits(pr);
+    for (std::size_t j = 0; j < n_rows; ++j) {
+      const std::size_t r = order[j];
+      word_t *row = row_bits(r);
+      if (r == pr || !(row[w] & mask)) continue;
+      for (std::size_t x = w; x < n_words; ++x) row[x] ^= prow[x];
+      ops.emplace_back(r, pr);
+    }
+    pivot[c] = pr;
+    is_pivot[pr] = true;
+    ++rank;
+  }
+
+  // A pivot row with a single bit gives the value of its column
+  std::vector<bool> solves(n_rows, false);
+  std::size_t n_solved = 0;
+  for (std::size_t c = 0; c < n_cols; ++c) {
+    if (pivot[c] == no_edge) continue;
+    const word_t *row = row_bits(pivot[c]);
+    std::size_t ones = 0;
+    for (std::size_t x = 0; x < n_words && ones < 2; ++x) {
+      for (word_t v = row[x]; v != 0 && ones < 2; v &= v - 1) ++ones;
+    }
+    if (ones == 1) {
+      solves[pivot[c]] = true;
+      ++n_solved;
+    }
+  }
+  if (n_solved == 0) return 0;
+
+  // Apply the schedule to copies of the output symbols, skipping the
+  // rows that are never used as pivots
+  std::vector<slot> scratch;
+  scratch.reserve(n_rows);
+  for (std::size_t r = 0; r < n_rows; ++r) {
+    scratch.push_back(outputs[row_output[r]]);
+  }
+  for (const auto &op : ops) {
+    if (!is_pivot[op.first]) continue;
+    symbol_traits::inplace_xor(scratch[op.first].symbol,
+			       scratch[op.second].symbol);
+  }
+
+  // Store the decoded inputs, then propagate them to the outputs
+  std::vector<std::size_t> solved;
+  for (std::size_t c = 0; c < n_cols; ++c) {
+    if (pivot[c] == no_edge || !solves[pivot[c]]) continue;
+    std::size_t in = col_input[c];
+    inputs[in].symbol = std::move(scratch[pivot[c]].symbol);
+    solved.push_back(in);
+  }
+  decoded_count_ += solved.size();
+  eliminated_count_ += solved.size();
+  for (std::size_t in : solved) {
+    process_ripple(in);
+  }
+  for (std::size_t in : solved) {
+    notify_decoded(in);
+  }
+  return solved.size();
+}
+
+template <class Symbol, class SymbolTraits>
+void mp_context<Symbol,SymbolTraits>::execute_schedule() {
+  if (sched_decoded.empty() && sched_xor.empty()) return;
+  std::clock_t t = std::clock();
+
+  // Group the pending XORs by output, with the sources sorted
+  std::sort(sched_xor.begin(), sched_xor.end());
+  auto sources = [this](std::size_t out) {
+    return std::equal_range(sched_xor.cbegin(), sched_xor.cend(),
+			    std::make_pair(out, std::size_t(0)),
+			    [](const std::pair<std::size_t,std::size_t> &a,
+			       const std::pair<std::size_t,std::size_t> &b) {
+			      return a.first < b.first;
+			    });
+  };
+
+  // An input depends on the inputs XOR-ed into the output that
+  // decoded it, which are always decoded before it
+  std::size_t n_levels = 0;
+  for (const auto &d : sched_decoded) {
+    std::size_t level = 0;
+    auto r = sources(d.second);
+    for (auto i = r.first; i != r.second; ++i) {
+      std::size_t src_level = in_level[i->second];
+      if (src_level != no_edge) level = std::max(level, src_level + 1);
+    }
+    in_level[d.first] = level;
+    n_levels = std::max(n_levels, level + 1);
+  }
+
+  // Sort the decoded inputs by level
+  std::vector<std::size_t> &level_first = sched_level_first;
+  level_first.assign(n_levels + 1, 0);
+  for (const auto &d : sched_decoded) ++level_first[in_level[d.first] + 1];
+  for (std::size_t l = 0; l < n_levels; ++l) {
+    level_first[l + 1] += level_first[l];
+  }
+  sched_order.resize(sched_decoded.size());
+  sched_level_pos.assign(level_first.cbegin(), level_first.cend() - 1);
+  for (std::size_t k = 0; k < sched_decoded.size(); ++k) {
+    sched_order[sched_level_pos[in_level[sched_decoded[k].first]]++] = k;
+  }
+
+  // The inputs of the same level are independent
+  for (std::size_t l = 0; l < n_levels; ++l) {
+    const std::size_t *level_k = sched_order.data() + level_first[l];
+    parallel_for(level_first[l + 1] - level_first[l],
+		 [this, level_k, &sources](std::size_t k) {
+		   const auto &d = sched_decoded[level_k[k]];
+		   symbol_type &in_sym = inputs[d.first].symbol;
+		   symbol_traits::swap(in_sym, outputs[d.second].symbol);
+		   auto r = sources(d.second);
+		   for (auto i = r.first; i != r.second; ++i) {
+		     symbol_traits::inplace_xor(in_sym, inputs[i->second].symbol);
+		   }
+		 });
+  }
+
+  // Update the outputs that are still in the graph. The ones that
+  // reached degree zero are never used again.
+  sched_targets.clear();
+  for (auto i = sched_xor.cbegin(); i != sched_xor.cend(); ++i) {
+    if (out_degree[i->first] > 0 &&
+	(sched_targets.empty() || sched_targets.back() != i->first)) {
+      sched_targets.push_back(i->first);
+    }
+  }
+  parallel_for(sched_targets.size(), [this, &sources](std::size_t k) {
+      std::size_t out = sched_targets[k];
+      symbol_type &out_sym = outputs[out].symbol;
+      auto r = sources(out);
+      for (auto i = r.first; i != r.second; ++i) {
+	symbol_traits::inplace_xor(out_sym, inputs[i->second].symbol);
+      }
+    });
+
+  for (const auto &d : sched_decoded) in_level[d.first] = no_edge;
+  sched_done.swap(sched_decoded);
+  sched_decoded.clear();
+  sched_xor.clear();
+  last_schedule_time += static_cast<double>(std::clock() - t) / CLOCKS_PER_SEC;
+
+  for (const auto &d : sched_done) notify_decoded(d.first);
+}
+
+template <class Symbol, class SymbolTraits>
+template <class F>
+void mp_context<Symbol,SymbolTraits>::parallel_for(std::size_t n, F f) {
+  const std::size_t n_threads = std::min(xor_threads, n / min_thread_targets);
+  if (n_threads <= 1) {
+    for (std::size_t i = 0; i < n; ++i) f(i);
+    return;
+  }
+
+  ensure_pool(n_threads);
+  pool->run([n, n_threads, &f](std::size_t w) {
+      if (w >= n_threads) return;
+      for (std::size_t i = w * n / n_threads; i < (w + 1) * n / n_threads; ++i) {
+	f(i);
+      }
+    });
+}
+
+template <class Symbol, class SymbolTraits>
+void mp_context<Symbol,SymbolTraits>::notify_decoded(std::size_t in) {
+  if (decoded_cb) decoded_cb(in, inputs[in].symbol);
+}
+
+template <class Symbol, class SymbolTraits>
+void mp_context<Symbol,SymbolTraits>::ensure_pool(std::size_t n) {
+  if (!pool || pool->size() < n) {
+    pool = std::make_shared<thread_pool>(n);
+  }
+}
+
+template <class Symbol, class SymbolTraits>
+void mp_context<Symbol,SymbolTraits>::peel_wavefronts() {
+  const std::size_t n_shards = peel_threads;
+  ensure_pool(n_shards);
+  shards.resize(n_shards);
+  for (wave_shard &sh : shards) sh.to.resize(n_shards);
+
+  // Each shard owns a contiguous range of inputs and of outputs
+  const std::size_t in_chunk = (inputs.size() + n_shards - 1) / n_shards;
+  const std::size_t out_chunk = (outputs.size() + n_shards - 1) / n_shards;
+  auto in_owner = [in_chunk](std::size_t in) { return in / in_chunk; };
+  auto out_owner = [out_chunk](std::size_t out) { return out / out_chunk; };
+
+  wavefront.clear();
+  for (std::size_t out = pop_degone(); out != no_edge; out = pop_degone()) {
+    if (out_degree[out] == 1) wavefront.push_back(out);
+  }
+  degone.clear();
+  degone_head = 0;
+  degone_size = 0;
+
+  // Small wavefronts are processed by this thread, shard by shard
+  bool parallel = false;
+  auto step = [this, n_shards, &parallel](const std::function<void(std::size_t)> &f) {
+    if (parallel) {
+      pool->run([n_shards, &f](std::size_t w) { if (w < n_shards) f(w); });
+    }
+    else {
+      for (std::size_t w = 0; w < n_shards; ++w) f(w);
+    }
+  };
+
+  while (!wavefront.empty() && !has_decoded()) {
+    _ripple_size.add_sample(wavefront.size());
+    parallel = wavefront.size() >= n_shards * min_thread_targets;
+
+    // Take the last edge of each output and send it to the owner of
+    // the input
+    step([&](std::size_t w) {
+	wave_shard &sh = shards[w];
+	const std::size_t n = wavefront.size();
+	for (std::size_t k = w * n / n_shards; k < (w + 1) * n / n_shards; ++k) {
+	  std::size_t out = wavefront[k];
+	  if (out_degree[out] != 1) continue;
+	  out_degree[out] = 0;
+	  std::size_t in = out_xor[out];
+	  sh.to[in_owner(in)].emplace_back(in, out);
+	}
+      });
+
+    // The first output that reaches an undecoded input decodes it,
+    // then the edges of the input are sent to the owners of the outputs
+    step([&](std::size_t w) {
+	wave_shard &sh = shards[w];
+	sh.decoded.clear();
+	for (wave_shard &src : shards) {
+	  for (const auto &p : src.to[w]) {
+	    std::size_t in = p.first;
+	    if (!symbol_traits::is_empty(inputs[in].symbol) ||
+		in_level[in] != no_edge) continue;
+	    in_level[in] = 0;
+	    sh.decoded.push_back(p);
+	  }
+	  src.to[w].clear();
+	}
+      });
+    step([&](std::size_t w) {
+	wave_shard &sh = shards[w];
+	for (const auto &d : sh.decoded) {
+	  std::size_t in = d.first;
+	  for (std::size_t e = in_first_edge[in]; e != no_edge; e = edges[e].next) {
+	    std::size_t out = edges[e].output;
+	    sh.to[out_owner(out)].emplace_back(out, in);
+	  }
+	  in_first_edge[in] = no_edge;
+	}
+      });
+
+    // Remove the edges from the outputs and collect the next wavefront
+    step([&](std::size_t w) {
+	wave_shard &sh = shards[w];
+	for (wave_shard &src : shards) {
+	  for (const auto &p : src.to[w]) {
+	    std::size_t out = p.first;
+	    if (out_degree[out] == 0) continue;
+	    out_xor[out] ^= p.second;
+	    sh.xors.push_back(p);
+	    if (--out_degree[out] == 1) sh.next.push_back(out);
+	  }
+	  src.to[w].clear();
+	}
+      });
+
+    wavefront.clear();
+    for (wave_shard &sh : shards) {
+      sched_decoded.insert(sched_decoded.end(),
+			   sh.decoded.cbegin(), sh.decoded.cend());
+      decoded_count_ += sh.decoded.size();
+      sched_xor.insert(sched_xor.end(), sh.xors.cbegin(), sh.xors.cend());
+      wavefront.insert(wavefront.end(), sh.next.cbegin(), sh.next.cend());
+      sh.decoded.clear();
+      sh.xors.clear();
+      sh.next.clear();
+    }
+  }
+
+  // Give the remaining outputs of degree one back to the sequential
+  // peeling
+  for (std::size_t out : wavefront) {
+    if (out_degree[out] == 1) insert_degone(out);
+  }
+}
+
 template <class Symbol, class SymbolTraits>
 std::size_t mp_context<Symbol,SymbolTraits>::input_size() const {
   return inputs.size();
@@ -471,6 +1053,12 @@ std::size_t mp_context<Symbol,SymbolTraits>::output_size() const {
   return outputs.size();
 }
 
+template <class Symbol, class SymbolTraits>
+std::size_t mp_context<Symbol,SymbolTraits>::residual_output_count() const {
+  return std::count_if(out_degree.cbegin(), out_degree.cend(),
+		       [](std::size_t d) { return d > 0; });
+}
+
 template <class Symbol, class SymbolTraits>
 std::size_t mp_context<Symbol,SymbolTraits>::decoded_count() const {
   return decoded_count_;
@@ -484,13 +1072,13 @@ bool mp_context<Symbol,SymbolTraits>::has_decoded() const {
 template <class Symbol, class SymbolTraits>
 typename mp_context<Symbol,SymbolTraits>::inputs_iterator
 mp_context<Symbol,SymbolTraits>::input_symbols_begin() const {
-  return inputs_iterator(inputs.cbegin(), node2sym());
+  return inputs_iterator(inputs.cbegin(), slot2sym());
 }
 
 template <class Symbol, class SymbolTraits>
 typename mp_context<Symbol,SymbolTraits>::inputs_iterator
 mp_context<Symbol,SymbolTraits>::input_symbols_end() const {
-  return inputs_iterator(inputs.cend(), node2sym());
+  return inputs_iterator(inputs.cend(), slot2sym());
 }
 
 template <class Symbol, class SymbolTraits>
@@ -508,64 +1096,183 @@ mp_context<Symbol,SymbolTraits>::decoded_symbols_end() const {
 }
 
 template <class Symbol, class SymbolTraits>
-void mp_context<Symbol,SymbolTraits>::insert_degone(node *np) {
-  // Insert at the end
-  if (degone_first != nullptr) {
-    np->prev = degone_last;
-    np->next = nullptr;
-    degone_last = np;
-    np->prev->next = np;
-  }
-  else { // Empty list
-    degone_first = np;
-    degone_last = np;
-    np->next = nullptr;
-    np->prev = nullptr;
+void mp_context<Symbol,SymbolTraits>::insert_degone(std::size_t out) {
+  switch (order_) {
+  case ripple_order::fifo:
+    degone.push_back(out);
+    break;
+  case ripple_order::priority:
+    degone_heap.emplace_back(in_priority[out_xor[out]], out);
+    std::push_heap(degone_heap.begin(), degone_heap.end(),
+		   std::greater<std::pair<std::size_t,std::size_t>>());
+    break;
+  case ripple_order::lowest_index:
+    degone_heap.emplace_back(out_xor[out], out);
+    std::push_heap(degone_heap.begin(), degone_heap.end(),
+		   std::greater<std::pair<std::size_t,std::size_t>>());
+    break;
   }
   ++degone_size;
 }
 
 template <class Symbol, class SymbolTraits>
-void mp_context<Symbol,SymbolTraits>::remove_degone(node *np) {
-  // Remove from middle
-  if (degone_first != np && degone_last != np) {
-    np->next->prev = np->prev;
-    np->prev->next = np->next;
-  }
-  // Remove from head
-  else if (degone_first == np && degone_last != np) {
-    np->next->prev = nullptr;
-    degone_first = np->next;
-  }
-  // Remove from tail
-  else if (degone_first != np && degone_last == np) {
-    np->prev->next = nullptr;
-    degone_last = np->prev;
-  }
-  // Is the only element
-  else {
-    degone_first = nullptr;
-    degone_last = nullptr;
+std::size_t mp_context<Symbol,SymbolTraits>::pop_degone() {
+  if (order_ == ripple_order::fifo) {
+    if (degone_head == degone.size()) return no_edge;
+    return degone[degone_head++];
   }
-  --degone_size;
+  if (degone_heap.empty()) return no_edge;
+  std::pop_heap(degone_heap.begin(), degone_heap.end(),
+		std::greater<std::pair<std::size_t,std::size_t>>());
+  std::size_t out = degone_heap.back().second;
+  degone_heap.pop_back();
+  return out;
 }
 
 template <class Symbol, class SymbolTraits>
 void mp_context<Symbol,SymbolTraits>::reset() {
-  degone_first = nullptr;
-  degone_last = nullptr;
+  degone.clear();
+  degone_heap.clear();
+  degone_head = 0;
   degone_size = 0;
   decoded_count_ = 0;
+  eliminated_count_ = 0;
+  elim_outputs = 0;
   last_run_time = 0;
-  for (std::unique_ptr<node> &n : inputs) {
-    n->symbol = symbol_traits::create_empty();
-    n->edges.clear();
+  last_schedule_time = 0;
+  sched_decoded.clear();
+  sched_xor.clear();
+  std::fill(in_level.begin(), in_level.end(), no_edge);
+  for (slot &s : inputs) {
+    s.symbol = symbol_traits::create_empty();
+  }
+  std::fill(in_first_edge.begin(), in_first_edge.end(), no_edge);
+  for (slot &s : outputs) {
+    spare_outputs.push_back(std::move(s.symbol));
   }
   outputs.clear();
+  out_degree.clear();
+  out_xor.clear();
+  edges.clear();
   _ripple_size.reset();
   _avg_run_time.reset();
 }
 
+template <class Symbol, class SymbolTraits>
+void mp_context<Symbol,SymbolTraits>::enable_elimination(std::size_t max_unknowns) {
+  if (max_unknowns > 0 && !std::is_copy_constructible<symbol_type>::value) {
+    throw std::logic_error("The elimination requires copyable symbols");
+  }
+  max_unknowns_ = max_unknowns;
+  elim_outputs = 0;
+}
+
+template <class Symbol, class SymbolTraits>
+std::size_t mp_context<Symbol,SymbolTraits>::elimination_limit() const {
+  return max_unknowns_;
+}
+
+template <class Symbol, class SymbolTraits>
+std::size_t mp_context<Symbol,SymbolTraits>::eliminated_count() const {
+  return eliminated_count_;
+}
+
+template <class Symbol, class SymbolTraits>
+void mp_context<Symbol,SymbolTraits>::set_ripple_order(ripple_order order,
+						       std::vector<std::size_t> priorities) {
+  if (order == ripple_order::priority && priorities.size() != inputs.size()) {
+    throw std::invalid_argument("The priorities must match the input size");
+  }
+
+  // Move the pending outputs to the new queue
+  std::vector<std::size_t> pending;
+  for (std::size_t out = pop_degone(); out != no_edge; out = pop_degone()) {
+    if (out_degree[out] == 1) pending.push_back(out);
+  }
+  degone.clear();
+  degone_heap.clear();
+  degone_head = 0;
+  degone_size = 0;
+
+  order_ = order;
+  in_priority = std::move(priorities);
+  for (std::size_t out : pending) insert_degone(out);
+}
+
+template <class Symbol, class SymbolTraits>
+ripple_order mp_context<Symbol,SymbolTraits>::get_ripple_order() const {
+  return order_;
+}
+
+template <class Symbol, class SymbolTraits>
+const std::vector<std::size_t> &
+mp_context<Symbol,SymbolTraits>::ripple_priorities() const {
+  return in_priority;
+}
+
+template <class Symbol, class SymbolTraits>
+void mp_context<Symbol,SymbolTraits>::set_decode_budget(std::size_t max_decoded) {
+  decode_budget_ = max_decoded;
+}
+
+template <class Symbol, class SymbolTraits>
+std::size_t mp_context<Symbol,SymbolTraits>::decode_budget() const {
+  return decode_budget_;
+}
+
+template <class Symbol, class SymbolTraits>
+std::size_t mp_context<Symbol,SymbolTraits>::ripple_size() const {
+  return degone_size;
+}
+
+template <class Symbol, class SymbolTraits>
+void mp_context<Symbol,SymbolTraits>::set_decoded_callback(decoded_callback cb) {
+  decoded_cb = std::move(cb);
+}
+
+template <class Symbol, class SymbolTraits>
+void mp_context<Symbol,SymbolTraits>::enable_xor_schedule(std::size_t threads) {
+  xor_threads = threads;
+}
+
+template <class Symbol, class SymbolTraits>
+void mp_context<Symbol,SymbolTraits>::enable_parallel_peeling(std::size_t threads,
+							      std::size_t min_inputs) {
+  peel_threads = threads;
+  parallel_min_inputs = min_inputs;
+  if (threads > 1 && xor_threads == 0) xor_threads = threads;
+}
+
+template <class Symbol, class SymbolTraits>
+std::size_t mp_context<Symbol,SymbolTraits>::parallel_peeling_threads() const {
+  return peel_threads;
+}
+
+template <class Symbol, class SymbolTraits>
+std::size_t mp_context<Symbol,SymbolTraits>::xor_schedule_threads() const {
+  return xor_threads;
+}
+
+template <class Symbol, class SymbolTraits>
+double mp_context<Symbol,SymbolTraits>::schedule_duration() const {
+  return last_schedule_time;
+}
+
+template <class Symbol, class SymbolTraits>
+void mp_context<Symbol,SymbolTraits>::reserve(std::size_t out_size,
+					      std::size_t edge_count) {
+  outputs.reserve(out_size);
+  out_degree.reserve(out_size);
+  out_xor.reserve(out_size);
+  if (order_ == ripple_order::fifo) {
+    degone.reserve(out_size);
+  }
+  else {
+    degone_heap.reserve(out_size);
+  }
+  edges.reserve(edge_count);
+}
+
 template <class Symbol, class SymbolTraits>
 double mp_context<Symbol,SymbolTraits>::run_duration() const {
   return last_run_time;
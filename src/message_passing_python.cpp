@@ -1,19 +1,10 @@
-#include "message_passing.hpp"
+#include "presence_context.hpp"
 
 #include <Python.h>
 #include <structmember.h>
 
-namespace uep { namespace mp {
-/** Specialize the xor between bool symbols. A decoded symbol always
- *  remains decoded.
- */
-template<>
-void symbol_traits<bool>::inplace_xor(bool &lhs, const bool &rhs) {
-  if (!lhs) lhs = rhs;
-}
-}}
-
-using mp_ctx_t = uep::mp::mp_context<bool>;
+/** The simulations only need to know which symbols are decoded. */
+using mp_ctx_t = uep::mp::presence_context;
 
 extern "C" {
 
@@ -107,8 +98,7 @@ static PyObject *mp_context_add_output(mp_ctx_py *self, PyObject *args) {
     return NULL;
   }
 
-  self->mp_ctx->add_output(true,
-			   sequence_iterator(seq),
+  self->mp_ctx->add_output(sequence_iterator(seq),
 			   sequence_iterator(seq, PySequence_Size(seq)));
   Py_RETURN_NONE;
 }
@@ -159,11 +149,8 @@ static PyObject *mp_context_average_run_duration(mp_ctx_py *self) {
 static PyObject *mp_context_input_symbols(mp_ctx_py *self) {
   const mp_ctx_t &mp_ctx = *(self->mp_ctx);
   PyObject *out = PyList_New(mp_ctx.input_size());
-  std::size_t j = 0;
-  for (auto i = mp_ctx.input_symbols_begin();
-       i != mp_ctx.input_symbols_end();
-       ++i) {
-    PyList_SET_ITEM(out, j++, PyBool_FromLong(*i ? 1 : 0));
+  for (std::size_t i = 0; i < mp_ctx.input_size(); ++i) {
+    PyList_SET_ITEM(out, i, PyBool_FromLong(mp_ctx.is_decoded(i) ? 1 : 0));
   }
   return out;
 }
@@ -698,6 +698,45 @@ void nal_reader::use_end_of_stream(bool use) {
   use_eos = use;
 }
 
+nal_reader_state nal_reader::save_state() const {
+  nal_reader_state st;
+  st.trace_offset = trace.eof() ? -1 : static_cast<std::int64_t>(trace.tellg());
+  st.last_nal = last_nal;
+  st.last_prio = last_prio;
+  std::queue<fountain_packet> q_copy(pkt_queue);
+  while (!q_copy.empty()) {
+    st.queued.push_back(std::move(q_copy.front()));
+    q_copy.pop();
+  }
+  st.tot_added_oh = _tot_added_oh;
+  st.tot_size = _tot_size;
+  return st;
+}
+
+void nal_reader::restore_state(const nal_reader_state &st) {
+  trace.clear();
+  if (st.trace_offset < 0) {
+    trace.seekg(0, ios_base::end);
+    trace.peek(); // Set eofbit
+  }
+  else {
+    trace.seekg(st.trace_offset);
+  }
+  if (trace.bad()) throw ios_base::failure("Failed to seek the trace file");
+
+  last_nal = st.last_nal;
+  last_prio = st.last_prio;
+  pkt_queue = std::queue<fountain_packet>();
+  for (const fountain_packet &fp : st.queued) {
+    pkt_queue.push(fp);
+  }
+  _tot_added_oh = st.tot_added_oh;
+  _tot_size = st.tot_size;
+
+  BOOST_LOG_SEV(basic_lg, log::debug) << "NAL reader restored at trace offset "
+				      << st.trace_offset;
+}
+
 const std::vector<std::size_t> &nal_reader::total_overhead() const {
   return _tot_added_oh;
 }
@@ -6,6 +6,7 @@
 #include <queue>
 #include <sstream>
 
+#include "encoder_state.hpp"
 #include "log.hpp"
 #include "lt_param_set.hpp"
 #include "packets.hpp"
@@ -101,6 +102,15 @@ public:
 
   const std::vector<std::size_t> &total_overhead() const;
   const std::vector<std::size_t> &total_read() const;
+
+  /** Return the current position inside the stream, along with the
+   *  packets that were read but not yet extracted.
+   */
+  nal_reader_state save_state() const;
+  /** Move to a position saved by save_state(). The reader must be
+   *  reading the same stream.
+   */
+  void restore_state(const nal_reader_state &st);
 private:
   log::default_logger basic_lg, perf_lg;
 
@@ -29,7 +29,8 @@ nal_writer::nal_writer(std::ostream &out) :
   basic_lg(boost::log::keywords::channel = log::basic),
   perf_lg(boost::log::keywords::channel = log::performance),
   file(out),
-  buf_prio(0) {
+  buf_prio(0),
+  eos_recvd(false) {
   BOOST_LOG_SEV(basic_lg, log::trace) << "Create a NAL writer with a given ostream";
 }
 
@@ -68,6 +69,31 @@ void nal_writer::push(const fountain_packet &p) {
   }
 }
 
+void nal_writer::push(const block_buffer &b) {
+  if (eos_recvd) {
+    throw std::runtime_error("The EOS was received");
+  }
+
+  std::size_t appended = 0;
+  std::size_t i = 0;
+  while (i < b.block_size()) {
+    if (!b.has_packet(i)) {
+      ++i;
+      continue;
+    }
+    std::size_t j = i + 1;
+    while (j < b.block_size() && b.has_packet(j)) ++j;
+    const char *first = b.packet_data(i);
+    const char *last = first + (j - i) * b.packet_size();
+    nal_buf.insert(nal_buf.end(), first, last);
+    appended += last - first;
+    i = j;
+  }
+  BOOST_LOG_SEV(basic_lg, log::trace) << "Appended " << appended
+				      << " bytes from a block to the nal_buf";
+  enqueue_nals(false);
+}
+
 void nal_writer::flush() {
   enqueue_nals(true);
   file.flush();
@@ -6,6 +6,7 @@
 #include <ostream>
 #include <sstream>
 
+#include "block_queues.hpp"
 #include "log.hpp"
 #include "lt_param_set.hpp"
 #include "nal_reader.hpp"
@@ -32,6 +33,11 @@ public:
   ~nal_writer();
 
   void push(const fountain_packet &p);
+  /** Append the present packets of a block, with the priority of the
+   *  NALs already in the buffer. Each run of consecutive packets is
+   *  copied at once from the block buffer.
+   */
+  void push(const block_buffer &b);
   void flush();
 
   // Can always be pushed to. Remove this?
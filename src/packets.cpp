@@ -40,7 +40,9 @@ packet::packet(const packet &p) :
   shared_data(new vector<char>(*p.shared_data)) {}
 
 packet &packet::operator=(const packet &p) {
-  shared_data = make_shared< vector<char> >(*p.shared_data);
+  // Reuse the buffer when no other packet can see it
+  if (shared_data.use_count() == 1) *shared_data = *p.shared_data;
+  else shared_data = make_shared< vector<char> >(*p.shared_data);
   return *this;
 }
 
@@ -2,6 +2,7 @@
 #define UEP_PACKETS_HPP
 
 #include <cstdint>
+#include <cstring>
 #include <memory>
 #include <ostream>
 #include <random>
@@ -26,6 +27,16 @@ public:
   static void inplace_xor(buffer_type &lhs, const buffer_type &rhs) {
     uep::inplace_xor(lhs,rhs);
   }
+
+  /** Copy the bytes of s to the range starting at dst. */
+  static void copy_to(char *dst, const buffer_type &s) {
+    std::memcpy(dst, s.data(), s.size());
+  }
+
+  /** XOR the bytes of s into the range starting at dst. */
+  static void xor_to(char *dst, const buffer_type &s) {
+    uep::inplace_xor(dst, s.data(), s.size());
+  }
 };
 }
 
@@ -73,7 +84,9 @@ public:
    */
   virtual ~packet() = default;
 
-  /** Assign a duplicate of the data from another packet. */
+  /** Assign a duplicate of the data from another packet. The current
+   *  buffer is reused when it is not shared with other packets.
+   */
   packet &operator=(const packet &p);
   /** Assign the same shared data from another packet rvalue. */
   packet &operator=(packet &&p) = default;
@@ -175,6 +188,43 @@ packet &operator^=(packet &a, const packet &b);
  */
 packet operator^(const packet &a, const packet &b);
 
+/** Specialization of symbol_traits for packets. */
+namespace uep { namespace mp {
+template<>
+class symbol_traits<packet> {
+public:
+  /** Create an empty packet. */
+  static packet create_empty() {
+    return packet();
+  }
+
+  /** True when the packet has no data. */
+  static bool is_empty(const packet &s) {
+    return s.empty();
+  }
+
+  /** XOR the data of rhs into lhs. */
+  static void inplace_xor(packet &lhs, const packet &rhs) {
+    lhs.xor_data(rhs);
+  }
+
+  /** Swap two packets. */
+  static void swap(packet &lhs, packet &rhs) {
+    std::swap(lhs, rhs);
+  }
+
+  /** Copy the bytes of s to the range starting at dst. */
+  static void copy_to(char *dst, const packet &s) {
+    std::memcpy(dst, s.data(), s.size());
+  }
+
+  /** XOR the bytes of s into the range starting at dst. */
+  static void xor_to(char *dst, const packet &s) {
+    uep::inplace_xor(dst, s.data(), s.size());
+  }
+};
+}}
+
 /** Packet class used to represent an LT-coded packet.
  *  This kind of packets holds, in addition to the data, a block
  *  number and sequence number to order it and a seed to allow the
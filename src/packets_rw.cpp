@@ -112,3 +112,33 @@ std::size_t parse_raw_ack_packet(const std::vector<char> &rp) {
   uint16_t blockno = extract_ntoh_uint16(i);
   return blockno;
 }
+
+std::vector<char> build_raw_need_more(std::size_t blockno, std::size_t count) {
+  vector<char> out;
+  out.reserve(need_more_size);
+
+  out.push_back(raw_packet_type::need_more);
+
+  uint16_t bn = numeric_cast<uint16_t>(blockno);
+  append_hton_int(out, bn);
+
+  uint16_t cnt = static_cast<uint16_t>(std::min<std::size_t>(count, 0xffff));
+  append_hton_int(out, cnt);
+
+  return out;
+}
+
+std::pair<std::size_t, std::size_t>
+parse_raw_need_more_packet(const std::vector<char> &rp) {
+  if (rp.size() < need_more_size)
+    throw runtime_error("The packet is too short");
+  auto i = rp.cbegin();
+
+  char type = *i++;
+  if (type != raw_packet_type::need_more)
+    throw runtime_error("Not a need-more packet");
+
+  uint16_t blockno = extract_ntoh_uint16(i);
+  uint16_t count = extract_ntoh_uint16(i);
+  return std::make_pair(blockno, count);
+}
@@ -13,6 +13,7 @@
 #include <stdexcept>
 #include <streambuf>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <boost/numeric/conversion/cast.hpp>
@@ -20,13 +21,16 @@
 /** Byte used to identify the type of packet. */
 enum raw_packet_type : char {
   data = 0,
-  block_ack = 1
+  block_ack = 1,
+  need_more = 2
 };
 
 /** Total size of the header of a data packet. */
 const std::size_t data_header_size = 11;
 /** Total size of the header of an ACK packet. */
 const std::size_t ack_header_size = 3;
+/** Total size of a "need more" packet. */
+const std::size_t need_more_size = 5;
 
 /** Build a raw packet, with network-endian fields, from a
  *  fountain_packet.
@@ -40,5 +44,14 @@ std::vector<char> build_raw_ack(std::size_t blockno);
 fountain_packet parse_raw_data_packet(const std::vector<char> &rp);
 /** Parse a raw ACK packet to get the block number carried by it. */
 std::size_t parse_raw_ack_packet(const std::vector<char> &rp);
+/** Build a raw packet that asks for `count` more packets of the
+ *  given block.
+ */
+std::vector<char> build_raw_need_more(std::size_t blockno, std::size_t count);
+/** Parse a raw "need more" packet to get the block number and the
+ *  number of requested packets. The count saturates at 0xffff.
+ */
+std::pair<std::size_t, std::size_t>
+parse_raw_need_more_packet(const std::vector<char> &rp);
 
 #endif
@@ -0,0 +1,271 @@
+#ifndef UEP_MP_PRESENCE_CONTEXT_HPP
+#define UEP_MP_PRESENCE_CONTEXT_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "counter.hpp"
+
+namespace uep { namespace mp {
+
+/** Message-passing decoder that only tracks which input symbols can
+ *  be decoded, without any payload.
+ *
+ *  It gives the same decoded set as an mp_context with the same
+ *  outputs and is meant for the simulations that run millions of
+ *  blocks. The decoded inputs are kept in a bitset, the outputs are
+ *  stored as rows in compressed form and the adjacency of the inputs
+ *  is rebuilt by a counting sort at each run(). All the storage is
+ *  reused after a reset(), whose cost is proportional to the number
+ *  of edges.
+ */
+class presence_context {
+public:
+  /** Construct a context with in_size undecoded input symbols. */
+  explicit presence_context(std::size_t in_size);
+
+  /** Add an output symbol connected with the input symbols given by
+   *  the iterator pair. Parallel edges are allowed.
+   */
+  template <class EdgeIter>
+  void add_output(EdgeIter edges_begin, EdgeIter edges_end);
+
+  /** Run the message-passing algorithm. Successive calls resume from
+   *  the previously decoded inputs.
+   */
+  void run();
+
+  /** Reset the context to the initial state, keeping the storage. */
+  void reset();
+  /** Reserve the storage for the given number of output symbols and
+   *  edges.
+   */
+  void reserve(std::size_t out_size, std::size_t edge_count);
+
+  /** Return the number of input symbols. */
+  std::size_t input_size() const;
+  /** Return the number of output symbols. */
+  std::size_t output_size() const;
+  /** Return the number of decoded input symbols. */
+  std::size_t decoded_count() const;
+  /** True when all the input symbols have been decoded. */
+  bool has_decoded() const;
+  /** True when the input symbol i has been decoded. */
+  bool is_decoded(std::size_t i) const;
+  /** Return the time it took to complete the last call to run. */
+  double run_duration() const;
+  /** Return the average ripple size since the last reset. */
+  double average_ripple_size() const;
+  /** Return the average run duration since the last reset. */
+  double average_run_duration() const;
+
+private:
+  typedef std::uint64_t word_t;
+  static constexpr std::size_t word_bits =
+    std::numeric_limits<word_t>::digits;
+
+  std::size_t in_size; /**< Number of input symbols. */
+  std::vector<word_t> decoded; /**< Bitset of the decoded inputs. */
+  std::size_t decoded_count_; /**< Number of decoded inputs. */
+
+  std::vector<std::size_t> out_first; /**< Start of the row of each
+				       *   output in out_edges, plus
+				       *   the end of the last one.
+				       */
+  std::vector<std::size_t> out_edges; /**< Inputs linked to each output. */
+  std::vector<std::size_t> out_degree; /**< Number of undecoded inputs
+					*   linked to each output.
+					*/
+  std::vector<std::size_t> out_xor; /**< XOR of the indices of the
+				     *   undecoded inputs linked to
+				     *   each output.
+				     */
+
+  std::vector<std::size_t> in_first; /**< Start of the outputs of each
+				      *   input in in_edges.
+				      */
+  std::vector<std::size_t> in_edges; /**< Outputs linked to each
+				      *   undecoded input.
+				      */
+  std::vector<std::size_t> ripple; /**< Outputs that reached degree one. */
+
+  double last_run_time; /**< Duration of the last run. */
+  stat::average_counter _ripple_size; /**< Average ripple size. */
+  stat::average_counter _avg_run_time; /**< Average run duration. */
+
+  /** Mark an input as decoded. */
+  void set_decoded(std::size_t i);
+  /** Build the adjacency of the undecoded inputs. */
+  void build_inputs();
+};
+
+//// presence_context definitions ////
+
+inline presence_context::presence_context(std::size_t in_size_) :
+  in_size(in_size_),
+  decoded((in_size_ + word_bits - 1) / word_bits, 0),
+  decoded_count_(0),
+  out_first(1, 0),
+  in_first(in_size_ + 1, 0),
+  last_run_time(0) {
+}
+
+template <class EdgeIter>
+void presence_context::add_output(EdgeIter edges_begin, EdgeIter edges_end) {
+  std::size_t degree = 0;
+  std::size_t xor_idx = 0;
+  for (EdgeIter i = edges_begin; i != edges_end; ++i) {
+    std::size_t in = *i;
+    if (in >= in_size) throw std::out_of_range("Input index out of range");
+    if (is_decoded(in)) continue;
+    out_edges.push_back(in);
+    ++degree;
+    xor_idx ^= in;
+  }
+  out_first.push_back(out_edges.size());
+  out_degree.push_back(degree);
+  out_xor.push_back(xor_idx);
+}
+
+inline void presence_context::build_inputs() {
+  // Count the edges of each input, then place them
+  std::fill(in_first.begin(), in_first.end(), 0);
+  for (std::size_t out = 0; out < out_degree.size(); ++out) {
+    if (out_degree[out] == 0) continue;
+    for (std::size_t e = out_first[out]; e < out_first[out+1]; ++e) {
+      std::size_t in = out_edges[e];
+      if (!is_decoded(in)) ++in_first[in + 1];
+    }
+  }
+  for (std::size_t in = 0; in < in_size; ++in) {
+    in_first[in + 1] += in_first[in];
+  }
+  in_edges.resize(in_first[in_size]);
+  for (std::size_t out = 0; out < out_degree.size(); ++out) {
+    if (out_degree[out] == 0) continue;
+    for (std::size_t e = out_first[out]; e < out_first[out+1]; ++e) {
+      std::size_t in = out_edges[e];
+      if (!is_decoded(in)) in_edges[in_first[in]++] = out;
+    }
+  }
+  // Shift back the starts moved by the placement
+  for (std::size_t in = in_size; in > 0; --in) {
+    in_first[in] = in_first[in - 1];
+  }
+  in_first[0] = 0;
+}
+
+inline void presence_context::run() {
+  if (has_decoded()) {
+    last_run_time = 0;
+    return;
+  }
+
+  std::clock_t t = std::clock();
+
+  build_inputs();
+  ripple.clear();
+  std::size_t ripple_size = 0;
+  for (std::size_t out = 0; out < out_degree.size(); ++out) {
+    if (out_degree[out] == 1) {
+      ripple.push_back(out);
+      ++ripple_size;
+    }
+  }
+
+  for (std::size_t head = 0; head < ripple.size() && !has_decoded(); ++head) {
+    _ripple_size.add_sample(ripple_size);
+    std::size_t out = ripple[head];
+    if (out_degree[out] != 1) continue; // Already processed
+    out_degree[out] = 0;
+    --ripple_size;
+    std::size_t in = out_xor[out];
+    if (is_decoded(in)) continue;
+    set_decoded(in);
+
+    for (std::size_t e = in_first[in]; e < in_first[in+1]; ++e) {
+      std::size_t o = in_edges[e];
+      if (out_degree[o] == 0) continue;
+      out_xor[o] ^= in;
+      std::size_t degree = --out_degree[o];
+      if (degree == 1) {
+	ripple.push_back(o);
+	++ripple_size;
+      }
+      else if (degree == 0) {
+	--ripple_size;
+      }
+    }
+  }
+
+  last_run_time = static_cast<double>(std::clock() - t) / CLOCKS_PER_SEC;
+  _avg_run_time.add_sample(last_run_time);
+}
+
+inline void presence_context::reset() {
+  std::fill(decoded.begin(), decoded.end(), 0);
+  decoded_count_ = 0;
+  out_first.resize(1);
+  out_edges.clear();
+  out_degree.clear();
+  out_xor.clear();
+  ripple.clear();
+  last_run_time = 0;
+  _ripple_size.reset();
+  _avg_run_time.reset();
+}
+
+inline void presence_context::reserve(std::size_t out_size,
+				      std::size_t edge_count) {
+  out_first.reserve(out_size + 1);
+  out_degree.reserve(out_size);
+  out_xor.reserve(out_size);
+  ripple.reserve(out_size);
+  out_edges.reserve(edge_count);
+  in_edges.reserve(edge_count);
+}
+
+inline void presence_context::set_decoded(std::size_t i) {
+  decoded[i / word_bits] |= word_t(1) << (i % word_bits);
+  ++decoded_count_;
+}
+
+inline std::size_t presence_context::input_size() const {
+  return in_size;
+}
+
+inline std::size_t presence_context::output_size() const {
+  return out_degree.size();
+}
+
+inline std::size_t presence_context::decoded_count() const {
+  return decoded_count_;
+}
+
+inline bool presence_context::has_decoded() const {
+  return decoded_count_ == in_size;
+}
+
+inline bool presence_context::is_decoded(std::size_t i) const {
+  return (decoded[i / word_bits] >> (i % word_bits)) & 1;
+}
+
+inline double presence_context::run_duration() const {
+  return last_run_time;
+}
+
+inline double presence_context::average_ripple_size() const {
+  return _ripple_size.value();
+}
+
+inline double presence_context::average_run_duration() const {
+  return _avg_run_time.value();
+}
+
+}}
+
+#endif
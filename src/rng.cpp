@@ -2,6 +2,7 @@
 
 #include <cmath>
 #include <set>
+#include <stdexcept>
 
 using namespace std;
 using namespace std::placeholders;
@@ -109,8 +110,14 @@ lt_row_generator::lt_row_generator(const degree_distribution &deg,
 }
 
 lt_row_generator::row_type lt_row_generator::next_row() {
-  size_t degree = degree_distr(rng);
   row_type s;
+  fill_row(s);
+  return s;
+}
+
+void lt_row_generator::fill_row(row_type &s) {
+  size_t degree = degree_distr(rng);
+  s.clear();
   s.reserve(degree);
   for (size_t i = 0; i < degree; ++i) {
     size_t si;
@@ -120,7 +127,10 @@ lt_row_generator::row_type lt_row_generator::next_row() {
     s.push_back(si);
   }
   ++sel_count;
-  return s;
+}
+
+void base_row_generator::fill_row(row_type &row) {
+  row = next_row();
 }
 
 std::size_t base_row_generator::generated_rows() const {
@@ -131,6 +141,10 @@ std::size_t lt_row_generator::K() const {
   return degree_distr.K();
 }
 
+std::unique_ptr<base_row_generator> lt_row_generator::clone() const {
+  return std::make_unique<lt_row_generator>(*this);
+}
+
 base_row_generator::rng_type::result_type base_row_generator::seed() const {
   return last_seed;
 }
@@ -148,8 +162,8 @@ lt_row_generator make_robust_lt_row_generator(std::size_t K, double c, double de
 namespace uep {
 
 base_row_generator::row_type uep_row_generator::next_row() {
-  row_type s_mapped;
-  row_type s;
+  if (expanding_windows()) return next_window_row();
+
 
   std::size_t degree;
   do {
@@ -166,10 +180,28 @@ base_row_generator::row_type uep_row_generator::next_row() {
   return row_type(row.cbegin(), row.cend());
 }
 
+base_row_generator::row_type uep_row_generator::next_window_row() {
+  std::size_t w = _win_dist(rng);
+  std::size_t degree = _win_deg_dists[w](rng);
+  std::uniform_int_distribution<std::size_t> pos_dist(0, _win_ends[w] - 1);
+
+  std::set<std::size_t> row;
+  while (row.size() < degree) {
+    row.insert(pos_dist(rng));
+  }
+
+  ++sel_count;
+  return row_type(row.cbegin(), row.cend());
+}
+
 std::size_t uep_row_generator::K() const {
   return _k_in;
 }
 
+std::unique_ptr<base_row_generator> uep_row_generator::clone() const {
+  return std::make_unique<uep_row_generator>(*this);
+}
+
 std::size_t uep_row_generator::K_in() const {
   return _k_in;
 }
@@ -198,4 +230,48 @@ double uep_row_generator::delta() const {
   return _delta;
 }
 
+std::unique_ptr<uep_row_generator>
+make_uep_row_generator(const lt_uep_parameter_set &ps) {
+  if (ps.WPs.empty()) {
+    return std::make_unique<uep_row_generator>(ps.Ks.begin(), ps.Ks.end(),
+					       ps.RFs.begin(), ps.RFs.end(),
+					       ps.EF,
+					       ps.c,
+					       ps.delta);
+  }
+  else {
+    return std::make_unique<uep_row_generator>(ps.Ks.begin(), ps.Ks.end(),
+					       ps.WPs.begin(), ps.WPs.end(),
+					       ps.c,
+					       ps.delta);
+  }
+}
+
+const std::vector<double> &uep_row_generator::WPs() const {
+  return _wps;
+}
+
+bool uep_row_generator::expanding_windows() const {
+  return !_wps.empty();
+}
+
+base_row_generator::row_type
+sliding_window_row(base_row_generator &rg,
+		   base_row_generator::rng_type::result_type seed,
+		   std::size_t end) {
+  if (end == 0)
+    throw std::invalid_argument("The window must contain at least one packet");
+
+  std::size_t K = rg.K();
+  rg.reset(seed);
+  base_row_generator::row_type abs_row;
+  while (abs_row.empty()) {
+    base_row_generator::row_type row = rg.next_row();
+    for (std::size_t i : row) {
+      if (i + end >= K) abs_row.push_back(i + end - K);
+    }
+  }
+  return abs_row;
+}
+
 }
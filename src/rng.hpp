@@ -3,9 +3,13 @@
 
 #include <algorithm>
 #include <functional>
+#include <memory>
+#include <numeric>
 #include <random>
 #include <vector>
 
+#include "lt_param_set.hpp"
+
 /** Implement a discrete distribution with elements in [1,K] according
  *  to a specified PMD.
  */
@@ -79,8 +83,16 @@ public:
 
   /** Generate the next row. This must be implemented by a subclass. */
   virtual row_type next_row() = 0;
+  /** Generate the next row into `row`, reusing its storage. The
+   *  default implementation assigns the result of next_row().
+   */
+  virtual void fill_row(row_type &row);
   /** Return the block size. This must be implemented by a subclass. */
   virtual std::size_t K() const = 0;
+  /** Return a copy of the generator, including the RNG state. This
+   *  must be implemented by a subclass.
+   */
+  virtual std::unique_ptr<base_row_generator> clone() const = 0;
 
   /** Reset the random generator using the given seed. */
   virtual void reset(rng_type::result_type seed = rng_type::default_seed);
@@ -118,8 +130,14 @@ public:
 
   /** Generate the next packet selection. */
   virtual row_type next_row() override;
+  /** Generate the next packet selection without allocating when
+   *  `row` has enough capacity.
+   */
+  virtual void fill_row(row_type &row) override;
   /** Return the input blocksize */
   virtual std::size_t K() const override;
+  /** Return a copy of this lt_row_generator. */
+  virtual std::unique_ptr<base_row_generator> clone() const override;
 
 private:
   degree_distribution degree_distr;
@@ -170,23 +188,41 @@ private:
   std::vector<std::size_t> map;
 };
 
-/** Generate row indices according to the UEP method. */
+/** Generate row indices according to the UEP method.
+ *  The rows are generated either over the block expanded with the
+ *  RFs and EF factors, or with expanding windows: each row first
+ *  selects the window made of the first i+1 sub-blocks with
+ *  probability WPs[i], then samples a robust-soliton row inside it.
+ */
 class uep_row_generator : public base_row_generator {
   using base_row_generator::rng_type;
   using base_row_generator::row_type;
 
 public:
+  /** Construct a generator that expands the block by repeating each
+   *  sub-block RFs times and the whole block EF times.
+   */
   template<typename KsIter, typename RFsIter>
   explicit uep_row_generator(KsIter ks_begin, KsIter ks_end,
 			     RFsIter rfs_begin, RFsIter rfs_end,
 			     std::size_t ef,
 			     double c,
 			     double delta);
+  /** Construct a generator that uses expanding windows. The window
+   *  `i` covers the first `Ks[0]+...+Ks[i]` packets and is selected
+   *  with probability proportional to `WPs[i]`.
+   */
+  template<typename KsIter, typename WPsIter>
+  explicit uep_row_generator(KsIter ks_begin, KsIter ks_end,
+			     WPsIter wps_begin, WPsIter wps_end,
+			     double c,
+			     double delta);
 
   virtual ~uep_row_generator() override = default;
 
   virtual row_type next_row() override;
   virtual std::size_t K() const override;
+  virtual std::unique_ptr<base_row_generator> clone() const override;
 
   std::size_t K_in() const;
   std::size_t K_out() const;
@@ -195,6 +231,12 @@ public:
   std::size_t EF() const;
   double c() const;
   double delta() const;
+  /** Window selection probabilities, empty if the expanding windows
+   *  are not used.
+   */
+  const std::vector<double> &WPs() const;
+  /** True if the rows are generated with expanding windows. */
+  bool expanding_windows() const;
 private:
   std::vector<std::size_t> _ks;
   std::vector<std::size_t> _rfs;
@@ -208,8 +250,27 @@ private:
   robust_soliton_distribution _deg_dist;
   std::uniform_int_distribution<std::size_t> _p_dist;
   position_mapper _pos_map;
+
+  std::vector<double> _wps;
+  std::vector<std::size_t> _win_ends; /**< Size of each window. */
+  std::vector<robust_soliton_distribution> _win_deg_dists;
+  std::discrete_distribution<std::size_t> _win_dist;
+
+  /** Generate a row using the expanding windows. */
+  row_type next_window_row();
 };
 
+/** Generate the row of a sliding-window coded packet. The row
+ *  generator is reset with `seed` and its indices in [0,K) are mapped
+ *  to the absolute input positions [end-K, end). The positions before
+ *  the start of the stream are dropped and rows left empty are drawn
+ *  again, so the encoder and the decoder always agree on the result.
+ */
+base_row_generator::row_type
+sliding_window_row(base_row_generator &rg,
+		   base_row_generator::rng_type::result_type seed,
+		   std::size_t end);
+
 }
 
 /** Shorthand to build an lt_row_generator using a
@@ -217,6 +278,17 @@ private:
  */
 lt_row_generator make_robust_lt_row_generator(std::size_t K, double c, double delta);
 
+namespace uep {
+
+/** Shorthand to build a uep_row_generator from a parameter set. The
+ *  expanding windows are used when `ps.WPs` is not empty, otherwise
+ *  the block is expanded with `ps.RFs` and `ps.EF`.
+ */
+std::unique_ptr<uep_row_generator>
+make_uep_row_generator(const lt_uep_parameter_set &ps);
+
+}
+
 // Template definitions
 
 template<class Gen>
@@ -250,6 +322,40 @@ _pos_map(ks_begin, ks_end, rfs_begin, rfs_end, ef) {
     throw std::invalid_argument("Empty Ks, RFs");
 }
 
+template<typename KsIter, typename WPsIter>
+uep_row_generator::uep_row_generator(KsIter ks_begin, KsIter ks_end,
+				     WPsIter wps_begin, WPsIter wps_end,
+				     double c,
+				     double delta) :
+_ks(ks_begin, ks_end),
+_rfs(_ks.size(), 1),
+_ef(1),
+_c(c),
+_delta(delta),
+_k_in(std::accumulate(_ks.cbegin(), _ks.cend(), 0)),
+_k_out(_k_in),
+_deg_dist(_k_out, _c, _delta),
+_p_dist(0, _k_out - 1),
+_pos_map(_ks.cbegin(), _ks.cend(), _rfs.cbegin(), _rfs.cend(), 1),
+_wps(wps_begin, wps_end),
+_win_dist(_wps.cbegin(), _wps.cend()) {
+  if (_ks.size() != _wps.size())
+    throw std::invalid_argument("Ks, WPs size mismatch");
+  if (_ks.empty())
+    throw std::invalid_argument("Empty Ks, WPs");
+  if (std::any_of(_wps.cbegin(), _wps.cend(),
+		  [](double p){ return p < 0; }) ||
+      std::accumulate(_wps.cbegin(), _wps.cend(), 0.0) <= 0)
+    throw std::invalid_argument("The WPs must be non-negative with a positive sum");
+
+  std::size_t end = 0;
+  for (std::size_t Ki : _ks) {
+    end += Ki;
+    _win_ends.push_back(end);
+    _win_deg_dists.emplace_back(end, _c, _delta);
+  }
+}
+
 }
 
 #endif
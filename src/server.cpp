@@ -37,7 +37,10 @@ const uep_server_parameters DEFAULT_SERVER_PARAMETERS{
   0,
   "12312",
   true,
-  uep_encoder<>::MAX_SEQNO
+  uep_encoder<>::MAX_SEQNO,
+  {},
+  1,
+  0
 };
 
 std::shared_ptr<control_connection>
@@ -66,6 +69,7 @@ control_connection::control_connection(boost::asio::io_service& io_service,
   proto_rd(io, socket_),
   proto_wr(io, socket_),
   ds(io),
+  shared_ds(io),
   srv_params(sp) {
 }
 
@@ -127,15 +131,33 @@ void control_connection::handle_new_message(const boost::system::error_code &ec,
 void control_connection::handle_stream_name() {
   std::cout << "Stream name received from client: \"" << streamName << "\"\n";
 
+  if (srv_params.shared_per_block > 0) {
+    cache = parent_srv.shared_stream(streamName);
+    shared_ds.setup_encoder(cache);
+    shared_ds.setup_source();
+    shared_ds.target_send_rate(srv_params.sendRate);
+    shared_ds.enable_ack(srv_params.ack);
+    shared_ds.max_sequence_number(srv_params.max_n_per_block);
+    return;
+  }
+
   /* CREATION OF DATA SERVER */
   //BOOST_LOG_SEV(basic_lg, debug) << "Creation of encoder...\n";
   std::cout << "Creation of encoder...\n";
   // setup the encoder inside the data_server
-  ds.setup_encoder(srv_params.Ks.begin(), srv_params.Ks.end(),
-		   srv_params.RFs.begin(), srv_params.RFs.end(),
-		   srv_params.EF,
-		   srv_params.c,
-		   srv_params.delta);
+  if (srv_params.WPs.empty()) {
+    ds.setup_encoder(srv_params.Ks.begin(), srv_params.Ks.end(),
+		     srv_params.RFs.begin(), srv_params.RFs.end(),
+		     srv_params.EF,
+		     srv_params.c,
+		     srv_params.delta);
+  }
+  else {
+    ds.setup_encoder(srv_params.Ks.begin(), srv_params.Ks.end(),
+		     srv_params.WPs.begin(), srv_params.WPs.end(),
+		     srv_params.c,
+		     srv_params.delta);
+  }
   // setup the source  inside the data_server
   ds.setup_source(streamName, srv_params.packet_size);
   ds.source().use_end_of_stream(true);
@@ -143,6 +165,7 @@ void control_connection::handle_stream_name() {
   ds.target_send_rate(srv_params.sendRate);
   ds.enable_ack(srv_params.ack);
   ds.max_sequence_number(srv_params.max_n_per_block);
+  ds.interleave_depth(srv_params.interleave_depth);
 }
 
 void control_connection::send_client_params() {
@@ -164,12 +187,17 @@ void control_connection::send_client_params() {
   cp.set_delta(srv_params.delta);
 
   cp.set_ef(srv_params.EF);
+  for (double p : srv_params.WPs) {
+    cp.add_wps(p);
+  }
   cp.set_ack(srv_params.ack);
+  cp.set_interleavedepth(srv_params.interleave_depth);
 
-  const buffer_type &hdr = ds.source().header();
+  const src_t &src = cache ? cache->source() : ds.source();
+  const buffer_type &hdr = src.header();
   cp.set_header(hdr.data(), hdr.size());
   cp.set_headersize(hdr.size());
-  cp.set_filesize(ds.source().totLength());
+  cp.set_filesize(src.totLength());
 
   BOOST_LOG_SEV(basic_lg, log::trace) << "Sending the client parameters";
   auto h = strand.wrap([this](const boost::system::error_code &ec,
@@ -188,11 +216,14 @@ void control_connection::handle_client_port() {
   ip::udp::endpoint remote_ep{remote_addr, clientPort};
   BOOST_LOG_SEV(basic_lg, log::debug) << "Opening UDP server for client "
 				      << remote_ep;
-  ds.open(remote_ep);
+  if (cache) shared_ds.open(remote_ep);
+  else ds.open(remote_ep);
 }
 
 void control_connection::send_server_port() {
-  unsigned short sp = ds.server_endpoint().port();
+  unsigned short sp = cache ?
+    shared_ds.server_endpoint().port() :
+    ds.server_endpoint().port();
   out_msg.set_server_port(sp);
   BOOST_LOG_SEV(basic_lg, log::trace) << "Sending the server port ("
 				      << sp << ")";
@@ -207,7 +238,8 @@ void control_connection::send_server_port() {
 }
 
 void control_connection::handle_start() {
-  ds.start();
+  if (cache) shared_ds.start();
+  else ds.start();
 }
 
 control_server::control_server(boost::asio::io_service& io_service,
@@ -252,6 +284,46 @@ void control_server::forget_connection(const control_connection &c) {
   }
 }
 
+std::shared_ptr<control_server::cache_type>
+control_server::shared_stream(const std::string &name) {
+  std::lock_guard<std::mutex> lock(streams_mutex);
+  std::shared_ptr<cache_type> c = shared_streams[name].lock();
+  if (c && c->can_join()) {
+    BOOST_LOG_SEV(basic_lg, log::debug) << "Join the shared stream \""
+					<< name << "\"";
+    return c;
+  }
+
+  std::unique_ptr<uep_encoder<>> enc;
+  if (server_params.WPs.empty()) {
+    enc = std::make_unique<uep_encoder<>>(server_params.Ks.begin(),
+					  server_params.Ks.end(),
+					  server_params.RFs.begin(),
+					  server_params.RFs.end(),
+					  server_params.EF,
+					  server_params.c,
+					  server_params.delta);
+  }
+  else {
+    enc = std::make_unique<uep_encoder<>>(server_params.Ks.begin(),
+					  server_params.Ks.end(),
+					  server_params.WPs.begin(),
+					  server_params.WPs.end(),
+					  server_params.c,
+					  server_params.delta);
+  }
+  auto src = std::make_unique<nal_reader>(name, server_params.packet_size);
+  src->use_end_of_stream(true);
+
+  std::size_t per_block = std::min(server_params.shared_per_block,
+				   server_params.max_n_per_block);
+  c = std::make_shared<cache_type>(std::move(enc), std::move(src), per_block);
+  shared_streams[name] = c;
+  BOOST_LOG_SEV(basic_lg, log::debug) << "New shared stream \""
+				      << name << "\"";
+  return c;
+}
+
 void control_server::start_accept() {
   using namespace std::placeholders;
 
@@ -301,7 +373,7 @@ int main(int argc, char **argv) {
 
   int c;
   opterr = 0;
-  while ((c = getopt(argc, argv, "p:r:n:lK:R:E:c:d:L:")) != -1) {
+  while ((c = getopt(argc, argv, "p:r:n:lK:R:E:W:c:d:L:I:S:")) != -1) {
     switch (c) {
     case 'p':
       srv_params.tcp_port_num = optarg;
@@ -330,6 +402,11 @@ int main(int argc, char **argv) {
       srv_params.EF = std::strtoull(optarg, nullptr, 10);
       break;
     }
+    case 'W': {
+      std::istringstream iss(optarg);
+      iss >> srv_params.WPs;
+      break;
+    }
     case 'c': {
       srv_params.c = std::strtod(optarg, nullptr);
       break;
@@ -341,6 +418,12 @@ int main(int argc, char **argv) {
     case 'L':
       srv_params.packet_size = std::strtoull(optarg, nullptr, 10);
       break;
+    case 'I':
+      srv_params.interleave_depth = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'S':
+      srv_params.shared_per_block = std::strtoull(optarg, nullptr, 10);
+      break;
     default:
       std::cerr << "Usage: " << argv[0]
 		<< " [-p <local control port>]"
@@ -350,14 +433,22 @@ int main(int argc, char **argv) {
 		<< " [-K '[<K0>, <K1>, ...]']"
 		<< " [-R '[<RF0>, <RF1>, ...]']"
 		<< " [-E <EF>]"
+		<< " [-W '[<WP0>, <WP1>, ...]']"
 		<< " [-c <c>]"
 		<< " [-d <delta>]"
 		<< " [-L <pktsize>]"
+		<< " [-I <interleave depth>]"
+		<< " [-S <shared pkts per block>]"
 		<< std::endl;
       return 2;
     }
   }
 
+  if (srv_params.shared_per_block > 0 && srv_params.interleave_depth != 1) {
+    std::cerr << "A shared stream cannot be interleaved" << std::endl;
+    return 2;
+  }
+
   // We need to create a server object to accept incoming client connections.
   boost::asio::io_service io_service;
 
@@ -7,6 +7,8 @@
 #include <fstream>
 #include <initializer_list>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <ostream>
 #include <set>
 #include <sstream>
@@ -20,6 +22,7 @@
 #include "lt_param_set.hpp"
 #include "nal_reader.hpp"
 #include "protobuf_rw.hpp"
+#include "stream_cache.hpp"
 #include "uep_encoder.hpp"
 #include "utils.hpp"
 
@@ -40,6 +43,17 @@ struct uep_server_parameters{
   std::string tcp_port_num;
   bool oneshot;
   std::size_t max_n_per_block;
+  std::vector<double> WPs; /**< Expanding window probabilities, if
+			    *   not empty they replace RFs and EF.
+			    */
+  std::size_t interleave_depth; /**< Number of blocks sent at the
+				 *   same time.
+				 */
+  std::size_t shared_per_block; /**< Number of coded packets per block
+				 *   cached for the clients of the
+				 *   same stream, or 0 to use a
+				 *   separate encoder for each client.
+				 */
 };
 
 /** Default values for the server parameters. */
@@ -56,6 +70,9 @@ class control_connection {
   using enc_t = uep_encoder<>;
   using src_t = nal_reader;
   using ds_type = data_server<enc_t, src_t>;
+  using cache_type = stream_cache<enc_t, src_t>;
+  using shared_ds_type = data_server<stream_session<enc_t, src_t>,
+				     null_source>;
 
   /** Enum used to keep track of the current state of the server. */
   enum connection_state {
@@ -90,6 +107,10 @@ private:
   protobuf_reader proto_rd;
   protobuf_writer proto_wr;
   ds_type ds;
+  std::shared_ptr<cache_type> cache; /**< Shared encoder, if enabled. */
+  shared_ds_type shared_ds; /**< Used instead of ds with the shared
+			     *   encoder.
+			     */
   uep_server_parameters srv_params;
 
   uep::protobuf::ControlMessage last_msg; /**< Last received message. */
@@ -124,9 +145,14 @@ private:
  *
  *  This class holds a shared pointer to every new connection. They
  *  must be deleted using forget_connection.
+ *
+ *  When uep_server_parameters::shared_per_block is not zero the
+ *  connections that request the same stream share a single encoder.
  */
 class control_server {
 public:
+  using cache_type = stream_cache<uep_encoder<>, nal_reader>;
+
   /** Builds using the given io_service. The server parameters will be
    *  used for each new connection.
    */
@@ -139,6 +165,12 @@ public:
    */
   void forget_connection(const control_connection &c);
 
+  /** Return the shared encoder for a stream. A new one is built if
+   *  no other client is receiving the stream or if it is too late to
+   *  join it from the start.
+   */
+  std::shared_ptr<cache_type> shared_stream(const std::string &name);
+
 private:
   log::default_logger basic_lg, perf_lg;
 
@@ -147,6 +179,8 @@ private:
   boost::asio::ip::tcp::acceptor acceptor;
   uep_server_parameters server_params;
   std::list<std::shared_ptr<control_connection>> active_conns;
+  std::mutex streams_mutex; /**< Protects shared_streams. */
+  std::map<std::string, std::weak_ptr<cache_type>> shared_streams;
 
   /** Wait for a new connection attempt. */
   void start_accept();
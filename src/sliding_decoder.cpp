@@ -0,0 +1,257 @@
+#include "sliding_decoder.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace uep {
+
+sliding_window_decoder::sliding_window_decoder(const parameter_set &ps) :
+  sliding_window_decoder(ps.W, ps.c, ps.delta) {
+}
+
+sliding_window_decoder::sliding_window_decoder(std::size_t W, double c,
+					       double delta) :
+  sliding_window_decoder(std::make_unique<lt_row_generator>(
+			   make_robust_lt_row_generator(W, c, delta))) {
+}
+
+sliding_window_decoder::sliding_window_decoder(std::unique_ptr<base_row_generator> &&rg) :
+  basic_lg(boost::log::keywords::channel = log::basic),
+  perf_lg(boost::log::keywords::channel = log::performance),
+  rowgen(std::move(rg)),
+  base(0),
+  release_pos(0),
+  newest_end(0),
+  has_received(false),
+  next_eq_id(0),
+  tot_recv_count(0),
+  tot_dec_count(0),
+  tot_failed_count(0) {
+}
+
+void sliding_window_decoder::push(const fountain_packet &p) {
+  fountain_packet p_copy(p);
+  push(move(p_copy));
+}
+
+void sliding_window_decoder::push(fountain_packet &&p) {
+  auto tic = high_resolution_clock::now();
+
+  std::size_t end = unwrap_end(p.block_number());
+  std::size_t start = end >= W() ? end - W() : 0;
+  if (end == 0 || (has_received && start < base)) {
+    BOOST_LOG(perf_lg) << "sliding_window_decoder::push old_window end="
+		       << p.block_number();
+    return;
+  }
+
+  if (!has_received) {
+    base = start;
+    release_pos = start;
+    newest_end = start;
+    has_received = true;
+  }
+  if (end > newest_end) {
+    slots.resize(end - base);
+    newest_end = end;
+  }
+  ++tot_recv_count;
+
+  auto seed = static_cast<base_row_generator::rng_type::result_type>(
+    p.block_seed());
+  base_row_generator::row_type row = sliding_window_row(*rowgen, seed, end);
+
+  // Reduce the packet by the known input packets
+  equation eq;
+  eq.data = move(p);
+  for (std::size_t pos : row) {
+    slot &s = slot_at(pos);
+    if (s.known)
+      eq.data ^= s.data;
+    else
+      eq.unknowns.push_back(pos);
+  }
+
+  if (eq.unknowns.size() == 1) {
+    solve(eq.unknowns.front(), move(eq.data));
+  }
+  else if (eq.unknowns.size() > 1) {
+    std::size_t id = next_eq_id++;
+    for (std::size_t pos : eq.unknowns) {
+      slot_at(pos).eqs.push_back(id);
+    }
+    pending.emplace(id, move(eq));
+  }
+
+  release();
+
+  duration<double> tdiff = high_resolution_clock::now() - tic;
+  BOOST_LOG(perf_lg) << "sliding_window_decoder::push"
+		     << " window_end=" << newest_end
+		     << " release_pos=" << release_pos
+		     << " pending_eqs=" << pending.size()
+		     << " push_time=" << tdiff.count();
+}
+
+fountain_packet sliding_window_decoder::next_decoded() {
+  fountain_packet p(std::move(out_queue.front()));
+  out_queue.pop();
+  return p;
+}
+
+void sliding_window_decoder::flush() {
+  while (release_pos < base + slots.size()) {
+    release_one();
+  }
+  slots.clear();
+  pending.clear();
+  base = release_pos;
+}
+
+std::size_t sliding_window_decoder::window_size() const {
+  return rowgen->K();
+}
+
+std::size_t sliding_window_decoder::W() const {
+  return window_size();
+}
+
+std::size_t sliding_window_decoder::release_position() const {
+  return release_pos;
+}
+
+std::size_t sliding_window_decoder::window_end() const {
+  return newest_end;
+}
+
+std::size_t sliding_window_decoder::pending_count() const {
+  return pending.size();
+}
+
+std::size_t sliding_window_decoder::queue_size() const {
+  return out_queue.size();
+}
+
+bool sliding_window_decoder::has_queued_packets() const {
+  return !out_queue.empty();
+}
+
+std::size_t sliding_window_decoder::total_received_count() const {
+  return tot_recv_count;
+}
+
+std::size_t sliding_window_decoder::total_decoded_count() const {
+  return tot_dec_count;
+}
+
+std::size_t sliding_window_decoder::total_failed_count() const {
+  return tot_failed_count;
+}
+
+double sliding_window_decoder::average_release_delay() const {
+  return avg_delay.value();
+}
+
+sliding_window_decoder::operator bool() const {
+  return has_queued_packets();
+}
+
+bool sliding_window_decoder::operator!() const {
+  return !has_queued_packets();
+}
+
+const base_row_generator &sliding_window_decoder::row_generator() const {
+  return *rowgen;
+}
+
+std::size_t sliding_window_decoder::unwrap_end(std::size_t wrapped) const {
+  if (!has_received) return wrapped;
+
+  const std::size_t mod = MAX_BLOCKNO + 1;
+  std::size_t fwd = (wrapped % mod + mod - newest_end % mod) % mod;
+  if (fwd <= BLOCK_WINDOW) return newest_end + fwd;
+  std::size_t back = mod - fwd;
+  // Before the start of the stream: treat as an old window
+  if (back > newest_end) return 0;
+  return newest_end - back;
+}
+
+sliding_window_decoder::slot &sliding_window_decoder::slot_at(std::size_t pos) {
+  return slots.at(pos - base);
+}
+
+void sliding_window_decoder::solve(std::size_t pos, packet &&p) {
+  std::vector<std::pair<std::size_t, packet>> ripple;
+  ripple.emplace_back(pos, move(p));
+
+  while (!ripple.empty()) {
+    std::size_t dec_pos = ripple.back().first;
+    packet dec_data(move(ripple.back().second));
+    ripple.pop_back();
+
+    slot &s = slot_at(dec_pos);
+    if (s.known) continue;
+    s.known = true;
+    s.data = move(dec_data);
+
+    std::vector<std::size_t> eqs;
+    eqs.swap(s.eqs);
+    for (std::size_t id : eqs) {
+      auto i = pending.find(id);
+      if (i == pending.end()) continue;
+
+      equation &e = i->second;
+      e.data ^= s.data;
+      e.unknowns.erase(std::find(e.unknowns.begin(), e.unknowns.end(),
+				 dec_pos));
+      if (e.unknowns.size() == 1)
+	ripple.emplace_back(e.unknowns.front(), move(e.data));
+      if (e.unknowns.size() <= 1)
+	pending.erase(i);
+    }
+  }
+}
+
+void sliding_window_decoder::release() {
+  // No future packet can cover the positions before the horizon
+  std::size_t horizon = newest_end >= W() ? newest_end - W() : 0;
+
+  while (release_pos < base + slots.size()) {
+    const slot &s = slot_at(release_pos);
+    if (!s.known && release_pos >= horizon) break;
+    release_one();
+  }
+
+  // Keep the decoded packets that can still reduce future packets
+  while (base < release_pos && base < horizon) {
+    slot &s = slots.front();
+    if (!s.known) {
+      for (std::size_t id : s.eqs) pending.erase(id);
+    }
+    slots.pop_front();
+    ++base;
+  }
+}
+
+void sliding_window_decoder::release_one() {
+  slot &s = slot_at(release_pos);
+  if (s.known) {
+    out_queue.emplace(s.data);
+    ++tot_dec_count;
+    avg_delay.add_sample(newest_end - release_pos);
+  }
+  else {
+    out_queue.emplace();
+    ++tot_failed_count;
+    BOOST_LOG_SEV(basic_lg, log::debug) << "Sliding window decoder lost packet "
+					<< release_pos;
+  }
+  ++release_pos;
+}
+
+}
@@ -0,0 +1,161 @@
+#ifndef UEP_SLIDING_DECODER_HPP
+#define UEP_SLIDING_DECODER_HPP
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <queue>
+#include <vector>
+
+#include "counter.hpp"
+#include "log.hpp"
+#include "lt_param_set.hpp"
+#include "packets.hpp"
+#include "rng.hpp"
+
+namespace uep {
+
+/** Sliding-window LT-code decoder.
+ *  The decoder keeps the equations of the received packets that are
+ *  not yet solved and runs the peeling algorithm incrementally as
+ *  each packet arrives. The input packets are released in order as
+ *  soon as they are decoded, or as empty packets when no future coded
+ *  packet can cover them anymore (i.e. they are more than W packets
+ *  behind the most recent window).
+ *  \sa sliding_window_encoder
+ */
+class sliding_window_decoder {
+public:
+  /** The collection of parameters required to setup the decoder. */
+  typedef sliding_window_parameter_set parameter_set;
+
+  /** Maximum allowed value for the window positions. The decoder
+   *  expects that they loop back to zero after this value.
+   */
+  static constexpr std::size_t MAX_BLOCKNO = 0xffff;
+  /** Maximum forward distance for a window to be considered more
+   *  recent.
+   */
+  static constexpr std::size_t BLOCK_WINDOW = MAX_BLOCKNO / 2;
+
+  /** Construct using the given parameter set. */
+  explicit sliding_window_decoder(const parameter_set &ps);
+  /** Construct using a robust_soliton_distribution with the given
+   *  parameters.
+   */
+  explicit sliding_window_decoder(std::size_t W, double c, double delta);
+  /** Construct using the given row generator. The window size is
+   *  rg->K().
+   */
+  explicit sliding_window_decoder(std::unique_ptr<base_row_generator> &&rg);
+
+  /** Pass a received packet. \sa push(fountain_packet&&) */
+  void push(const fountain_packet &p);
+  /** Pass a received packet.
+   *  The packet is reduced by the known input packets in its window
+   *  and the peeling algorithm is run on the new equation. Packets
+   *  whose window starts before the oldest buffered input packet are
+   *  discarded.
+   */
+  void push(fountain_packet &&p);
+
+  /** Extract the oldest released packet from the FIFO queue. */
+  fountain_packet next_decoded();
+
+  /** Release all the buffered input packets, either decoded or
+   *  empty, up to the end of the most recent window.
+   */
+  void flush();
+
+  /** The maximum number of packets in a window. */
+  std::size_t window_size() const;
+  /** Alias of window_size. */
+  std::size_t W() const;
+  /** Position of the next input packet that will be released. */
+  std::size_t release_position() const;
+  /** Position just past the end of the most recent received window. */
+  std::size_t window_end() const;
+  /** Number of received packets whose equation is not solved yet. */
+  std::size_t pending_count() const;
+  /** Number of output queued packets. */
+  std::size_t queue_size() const;
+  /** True if there are released packets still in the queue. */
+  bool has_queued_packets() const;
+  /** Return the total number of received packets. */
+  std::size_t total_received_count() const;
+  /** Return the total number of decoded packets that were released. */
+  std::size_t total_decoded_count() const;
+  /** Return the total number of empty packets that were released. */
+  std::size_t total_failed_count() const;
+  /** Return the average number of input packets between the end of
+   *  the window and a decoded packet when it is released.
+   */
+  double average_release_delay() const;
+
+  /** True if there are released packets still in the queue. */
+  explicit operator bool() const;
+  /** True if all the released packets have been extracted. */
+  bool operator!() const;
+
+  const base_row_generator &row_generator() const;
+
+private:
+  /** A received packet that still depends on more than one unknown
+   *  input packet.
+   */
+  struct equation {
+    packet data; /**< XOR of the unknown input packets. */
+    std::vector<std::size_t> unknowns; /**< Positions of the unknown
+					*   input packets.
+					*/
+  };
+
+  /** An input packet inside the buffered window. */
+  struct slot {
+    slot() : known(false) {}
+
+    packet data; /**< The decoded packet, empty if still unknown. */
+    bool known; /**< True when the packet has been decoded. */
+    std::vector<std::size_t> eqs; /**< Ids of the equations that
+				   *   depend on this packet.
+				   */
+  };
+
+  log::default_logger basic_lg, perf_lg;
+
+  std::unique_ptr<base_row_generator> rowgen;
+  std::deque<slot> slots; /**< Input packets in [base, base+size). */
+  std::size_t base; /**< Position of slots.front(). */
+  std::size_t release_pos; /**< Next position to release. */
+  std::size_t newest_end; /**< End of the most recent window. */
+  bool has_received; /**< True after the first packet. */
+  std::map<std::size_t, equation> pending; /**< Unsolved equations. */
+  std::size_t next_eq_id;
+  std::queue<fountain_packet> out_queue;
+
+  std::size_t tot_recv_count;
+  std::size_t tot_dec_count;
+  std::size_t tot_failed_count;
+  stat::average_counter avg_delay; /**< Average release delay. */
+
+  /** Convert the wrapped window end of a packet to an absolute
+   *  position.
+   */
+  std::size_t unwrap_end(std::size_t wrapped) const;
+  /** Return the slot at the absolute position `pos`. */
+  slot &slot_at(std::size_t pos);
+  /** Store `p` as the decoded input packet at `pos` and propagate it
+   *  through the pending equations.
+   */
+  void solve(std::size_t pos, packet &&p);
+  /** Release the decoded or unreachable packets and drop the input
+   *  packets that cannot be referenced anymore.
+   */
+  void release();
+  /** Release the packet at release_pos and advance. */
+  void release_one();
+};
+
+}
+
+#endif
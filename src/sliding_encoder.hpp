@@ -0,0 +1,161 @@
+#ifndef UEP_SLIDING_ENCODER_HPP
+#define UEP_SLIDING_ENCODER_HPP
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <random>
+#include <utility>
+
+#include "counter.hpp"
+#include "log.hpp"
+#include "lt_param_set.hpp"
+#include "packets.hpp"
+#include "rng.hpp"
+
+namespace uep {
+
+/** Sliding-window LT-code encoder.
+ *  Instead of coding fixed blocks of K packets, each coded packet
+ *  mixes a subset of the last W input packets pushed to the
+ *  encoder. The block_number field of the coded packets holds the
+ *  (wrapped) position just past the end of the window, while the
+ *  block_seed field holds the seed of the row. This allows a
+ *  sliding_window_decoder to release each input packet as soon as it
+ *  is solved, with a latency bounded by W packets.
+ *  \sa sliding_window_decoder
+ */
+template<class Gen = std::random_device>
+class sliding_window_encoder {
+public:
+  /** The collection of parameters required to setup the encoder. */
+  typedef sliding_window_parameter_set parameter_set;
+  /** The type of the object called to seed the row generator at each
+   *  coded packet.
+   */
+  typedef Gen seed_generator_type;
+
+  /** Maximum allowed value for the sequence numbers. They loop back
+   *  to zero after this value.
+   */
+  static constexpr std::size_t MAX_SEQNO = 0xffff;
+  /** Maximum allowed value for the window positions sent in the
+   *  block_number field. They loop back to zero after this value.
+   */
+  static constexpr std::size_t MAX_BLOCKNO = 0xffff;
+
+  /** Construct using the given parameter set. */
+  explicit sliding_window_encoder(const parameter_set &ps) :
+    sliding_window_encoder(ps.W, ps.c, ps.delta) {}
+
+  /** Construct using a robust_soliton_distribution with parameters W,
+   *  c, delta.
+   */
+  explicit sliding_window_encoder(std::size_t W, double c, double delta) :
+    sliding_window_encoder(std::make_unique<lt_row_generator>(
+			     make_robust_lt_row_generator(W, c, delta))) {}
+
+  /** Construct with the row_generator rg. The window size is rg->K(). */
+  explicit sliding_window_encoder(std::unique_ptr<base_row_generator> &&rg) :
+    basic_lg(boost::log::keywords::channel = log::basic),
+    perf_lg(boost::log::keywords::channel = log::performance),
+    rowgen(std::move(rg)),
+    seqno_counter(MAX_SEQNO),
+    in_count(0),
+    tot_coded_count(0) {
+  }
+
+  /** Append packet p to the window. \sa push(packet&&) */
+  void push(const packet &p) {
+    packet p_copy(p);
+    push(std::move(p_copy));
+  }
+
+  /** Append packet p to the window. The oldest packet is dropped when
+   *  the window is full.
+   */
+  void push(packet &&p) {
+    window.push_back(std::move(p));
+    if (window.size() > window_size()) window.pop_front();
+    ++in_count;
+  }
+
+  /** Generate the next coded packet from the current window. */
+  fountain_packet next_coded() {
+    using namespace std::chrono;
+
+    if (!has_block())
+      throw std::runtime_error("The window is empty");
+
+    auto tic = high_resolution_clock::now();
+
+    auto seed = static_cast<base_row_generator::rng_type::result_type>(
+      the_seed_gen());
+    base_row_generator::row_type row =
+      sliding_window_row(*rowgen, seed, in_count);
+
+    std::size_t start = window_start();
+    fountain_packet p(window.at(row[0] - start));
+    for (auto i = row.cbegin() + 1; i != row.cend(); ++i) {
+      p ^= window.at(*i - start);
+    }
+    p.sequence_number(seqno_counter.next());
+    p.block_number(in_count % (MAX_BLOCKNO + 1));
+    p.block_seed(seed);
+    ++tot_coded_count;
+
+    duration<double> tdiff = high_resolution_clock::now() - tic;
+    BOOST_LOG(perf_lg) << "sliding_window_encoder::next_coded"
+		       << " new_coded_packet=" << p
+		       << " encode_time=" << tdiff.count();
+
+    return p;
+  }
+
+  /** Return true when the window holds at least one packet. */
+  bool has_block() const { return !window.empty(); }
+  /** The maximum number of packets in the window. */
+  std::size_t window_size() const { return rowgen->K(); }
+  /** Alias of window_size. */
+  std::size_t W() const { return window_size(); }
+  /** Position of the first packet in the current window. */
+  std::size_t window_start() const { return in_count - window.size(); }
+  /** Position just past the last packet in the current window. */
+  std::size_t window_end() const { return in_count; }
+  /** The sequence number of the last generated packet. */
+  std::size_t seqno() const { return seqno_counter.last(); }
+  /** Number of packets currently held in the window. */
+  std::size_t size() const { return window.size(); }
+  /** Total number of packets that were pushed to the encoder. */
+  std::size_t total_input_count() const { return in_count; }
+  /** Total number of coded packets that were produced. */
+  std::size_t total_coded_count() const { return tot_coded_count; }
+
+  /** Return the row generator used. */
+  const base_row_generator &row_generator() const { return *rowgen; }
+  /** Return a copy of the RNG used to produce the row seeds. */
+  seed_generator_type seed_generator() const { return the_seed_gen; }
+
+  /** Is true when coded packets can be produced. */
+  explicit operator bool() const { return has_block(); }
+  /** Is true when the window is empty. */
+  bool operator!() const { return !has_block(); }
+
+private:
+  log::default_logger basic_lg, perf_lg;
+
+  std::unique_ptr<base_row_generator> rowgen;
+  std::deque<packet> window; /**< The last W input packets. */
+  seed_generator_type the_seed_gen;
+  circular_counter<std::size_t> seqno_counter;
+  std::size_t in_count; /**< Number of pushed packets, also the
+			 *   position just past the window.
+			 */
+  std::size_t tot_coded_count; /**< Count the total number of coded
+				*   packets.
+				*/
+};
+
+}
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef UEP_UTILS_SPAN_HPP
+#define UEP_UTILS_SPAN_HPP
+
+#include <cstddef>
+#include <stdexcept>
+
+namespace uep { namespace utils {
+
+/** Non-owning view over a contiguous sequence of elements.
+ *  The viewed elements must outlive the span.
+ */
+template <class T>
+class span {
+public:
+  typedef T element_type;
+  typedef T *iterator;
+  typedef std::size_t size_type;
+
+  /** Construct an empty span. */
+  span() : ptr(nullptr), count(0) {}
+  /** Construct a view over the `n` elements starting at `p`. */
+  span(T *p, size_type n) : ptr(p), count(n) {}
+
+  /** Allow the conversion from span<U> to span<const U>. */
+  template <class U>
+  span(const span<U> &other) : ptr(other.data()), count(other.size()) {}
+
+  /** Pointer to the first element. */
+  T *data() const { return ptr; }
+  /** Number of elements in the view. */
+  size_type size() const { return count; }
+  /** True when the view has no elements. */
+  bool empty() const { return count == 0; }
+
+  iterator begin() const { return ptr; }
+  iterator end() const { return ptr + count; }
+
+  /** Access an element without bounds checking. */
+  T &operator[](size_type i) const { return ptr[i]; }
+  /** Access an element, throwing std::out_of_range if `i` is not
+   *  less than size().
+   */
+  T &at(size_type i) const {
+    if (i >= count) throw std::out_of_range("Span index out of range");
+    return ptr[i];
+  }
+
+private:
+  T *ptr;
+  size_type count;
+};
+
+}}
+
+#endif
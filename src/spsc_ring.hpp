@@ -0,0 +1,115 @@
+#ifndef UEP_SPSC_RING_HPP
+#define UEP_SPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace uep {
+
+/** Bounded lock-free queue with a single producer and a single
+ *  consumer.
+ *
+ *  The elements are stored in a fixed array of slots that is
+ *  allocated at construction. The producer thread can only call
+ *  try_push() and full(), the consumer thread can only call
+ *  front(), try_pop(), clear() and empty(). The other methods give
+ *  an approximate value when the queue is in use by both threads.
+ */
+template <class T>
+class spsc_ring {
+public:
+  typedef T value_type;
+  typedef std::size_t size_type;
+
+  /** Construct a ring that can hold up to `capacity` elements. */
+  explicit spsc_ring(size_type capacity) :
+    slots(capacity), head(0), tail(0) {
+    if (capacity == 0)
+      throw std::invalid_argument("The ring capacity must be positive");
+  }
+
+  spsc_ring(const spsc_ring&) = delete;
+  spsc_ring &operator=(const spsc_ring&) = delete;
+
+  /** Move an element at the back of the ring. Return false, without
+   *  touching the element, if the ring is full. Producer only.
+   */
+  bool try_push(T &&x) {
+    size_type t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == slots.size())
+      return false;
+    slots[t % slots.size()] = std::move(x);
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** Move the element at the front of the ring into `x`. Return
+   *  false if the ring is empty. Consumer only.
+   */
+  bool try_pop(T &x) {
+    size_type h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire))
+      return false;
+    x = std::move(slots[h % slots.size()]);
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** Return a pointer to the element at the front of the ring, or
+   *  nullptr if the ring is empty. Consumer only.
+   */
+  T *front() {
+    size_type h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire))
+      return nullptr;
+    return &slots[h % slots.size()];
+  }
+
+  /** Drop all the elements in the ring. Return the number of
+   *  dropped elements. Consumer only.
+   */
+  size_type clear() {
+    size_type h = head.load(std::memory_order_relaxed);
+    size_type t = tail.load(std::memory_order_acquire);
+    head.store(t, std::memory_order_release);
+    return t - h;
+  }
+
+  /** True if the ring has no elements. */
+  bool empty() const {
+    return head.load(std::memory_order_acquire) ==
+      tail.load(std::memory_order_acquire);
+  }
+
+  /** True if the ring has no free slots. */
+  bool full() const {
+    return size() == slots.size();
+  }
+
+  /** Number of elements in the ring. */
+  size_type size() const {
+    size_type h = head.load(std::memory_order_acquire);
+    return tail.load(std::memory_order_acquire) - h;
+  }
+
+  /** Maximum number of elements that the ring can hold. */
+  size_type capacity() const {
+    return slots.size();
+  }
+
+private:
+  std::vector<T> slots; /**< Fixed storage for the elements. */
+  std::atomic<size_type> head; /**< Number of popped elements. Only
+				*   written by the consumer.
+				*/
+  std::atomic<size_type> tail; /**< Number of pushed elements. Only
+				*   written by the producer.
+				*/
+};
+
+}
+
+#endif
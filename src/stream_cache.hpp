@@ -0,0 +1,452 @@
+#ifndef UEP_STREAM_CACHE_HPP
+#define UEP_STREAM_CACHE_HPP
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "counter.hpp"
+#include "log.hpp"
+#include "packets.hpp"
+
+namespace uep {
+
+/** Encoder shared by all the clients of the same stream.
+ *
+ *  The cache owns an encoder and the source that feeds it. Each block
+ *  is encoded only once, when the first stream_session asks for its
+ *  packets, and the coded packets are kept in a bounded cache so that
+ *  the other sessions can send the same packets later, each at its
+ *  own rate. Since any coded packet of a block is useful to any
+ *  client, the sessions do not need to be synchronized.
+ *
+ *  At most `per_block` coded packets are generated for each block.
+ *  When a session moves past the most recent block, the encoder skips
+ *  to the next one; if some other session has not yet reached the
+ *  end of the old block, the latter is first filled up to
+ *  `per_block` packets. At most `max_blocks` blocks are cached: the
+ *  sessions that fall behind the oldest one jump forward.
+ *
+ *  All the methods are thread-safe.
+ *  \sa stream_session
+ */
+template <class Encoder, class Source>
+class stream_cache {
+public:
+  typedef Encoder encoder_type;
+  typedef Source source_type;
+
+  /** Default number of cached blocks. */
+  static constexpr std::size_t DEFAULT_MAX_BLOCKS = 16;
+
+  /** Result of a call to fetch(). */
+  enum fetch_result {
+    fetched, /**< The packet was copied to the output. */
+    end_of_block, /**< No more packets for the requested block. */
+    end_of_stream, /**< The requested block will never be produced. */
+    evicted /**< The requested block was dropped from the cache. */
+  };
+
+  /** Construct a cache that takes the input packets from `src` and
+   *  encodes them with `enc`.
+   */
+  explicit stream_cache(std::unique_ptr<Encoder> &&enc,
+			std::unique_ptr<Source> &&src,
+			std::size_t per_block,
+			std::size_t max_blocks = DEFAULT_MAX_BLOCKS) :
+    basic_lg(boost::log::keywords::channel = log::basic),
+    perf_lg(boost::log::keywords::channel = log::performance),
+    encoder_(std::move(enc)),
+    source_(std::move(src)),
+    per_block_(std::min(per_block, std::size_t(Encoder::MAX_SEQNO))),
+    max_blocks_(max_blocks),
+    first_index(0),
+    ended(false) {
+    if (per_block_ == 0)
+      throw std::invalid_argument("Must cache at least one packet per block");
+    if (max_blocks_ == 0)
+      throw std::invalid_argument("Must cache at least one block");
+    load_block();
+    if (*encoder_) blocks.emplace_back(encoder_->blockno());
+    else ended = true;
+  }
+
+  /** Copy the `i`-th coded packet of the block with index `bi` to
+   *  `out`. The block indices count the blocks from the start of the
+   *  stream, without wrapping around. The blocks up to `bi` are
+   *  encoded if needed.
+   */
+  fetch_result fetch(std::size_t bi, std::size_t i, fountain_packet &out) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (bi < first_index) return evicted;
+    while (!ended && bi >= end_index()) open_next_block();
+    if (bi >= end_index()) return end_of_stream;
+
+    cached_block &b = blocks[bi - first_index];
+    if (i >= per_block_) return end_of_block;
+    if (i >= b.pkts.size()) {
+      if (b.closed) return end_of_block;
+      fill(b, i + 1);
+    }
+    out = b.pkts[i].shallow_copy();
+    return fetched;
+  }
+
+  /** Return true if fetch() can return a packet of the block `bi`
+   *  starting from the `i`-th one, or of a following block. The
+   *  blocks up to `bi` are encoded if needed.
+   */
+  bool has_packets(std::size_t bi, std::size_t i) {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (;;) {
+      if (bi < first_index) {
+	bi = first_index;
+	i = 0;
+      }
+      while (!ended && bi >= end_index()) open_next_block();
+      if (bi >= end_index()) return false;
+
+      const cached_block &b = blocks[bi - first_index];
+      if (i < per_block_ && (!b.closed || i < b.pkts.size())) return true;
+      ++bi;
+      i = 0;
+    }
+  }
+
+  /** Register the current block index of a session. It is used to
+   *  decide whether a block must be filled before it is closed.
+   */
+  void set_position(const void *session, std::size_t bi) {
+    std::lock_guard<std::mutex> lock(mtx);
+    positions[session] = bi;
+  }
+
+  /** Remove a session registered by set_position(). */
+  void forget_position(const void *session) {
+    std::lock_guard<std::mutex> lock(mtx);
+    positions.erase(session);
+  }
+
+  /** Block number sent in the packets of the block with index `bi`. */
+  std::size_t blockno(std::size_t bi) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    circular_counter<std::size_t> bn(Encoder::MAX_BLOCKNO);
+    if (blocks.empty()) return bn.value();
+    if (bi < first_index)
+      throw std::invalid_argument("The block was evicted");
+    std::size_t offset = bi - first_index;
+    if (offset < blocks.size()) return blocks[offset].blockno;
+    bn.set(blocks.back().blockno);
+    bn.next(offset - blocks.size() + 1);
+    return bn.value();
+  }
+
+  /** Index of the oldest cached block. */
+  std::size_t oldest_block() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return first_index;
+  }
+
+  /** True if a new session can still receive the stream from the
+   *  start.
+   */
+  bool can_join() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return first_index == 0 && !blocks.empty();
+  }
+
+  /** Maximum number of coded packets generated for each block. */
+  std::size_t per_block() const {
+    return per_block_;
+  }
+
+  /** Maximum number of cached blocks. */
+  std::size_t max_blocks() const {
+    return max_blocks_;
+  }
+
+  /** Number of input packets in each block. */
+  std::size_t K() const {
+    return encoder_->K();
+  }
+
+  /** Total number of coded packets that were encoded. */
+  std::size_t encoded_count() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return encoder_->total_coded_count();
+  }
+
+  /** Return a reference to the source. Only the properties that do
+   *  not change while reading (e.g. the stream header) can be
+   *  accessed without synchronization.
+   */
+  const Source &source() const {
+    return *source_;
+  }
+
+private:
+  /** The coded packets of a block. */
+  struct cached_block {
+    explicit cached_block(std::size_t bn) : blockno(bn), closed(false) {}
+
+    std::size_t blockno; /**< Block number of the packets. */
+    std::vector<fountain_packet> pkts; /**< Coded packets in order. */
+    bool closed; /**< Set when the encoder has moved past the block. */
+  };
+
+  log::default_logger basic_lg, perf_lg;
+
+  mutable std::mutex mtx; /**< Protects all the members below. */
+  std::unique_ptr<Encoder> encoder_;
+  std::unique_ptr<Source> source_;
+  std::size_t per_block_;
+  std::size_t max_blocks_;
+  std::deque<cached_block> blocks; /**< Cached blocks, the last one
+				    *   is being encoded unless it is
+				    *   closed.
+				    */
+  std::size_t first_index; /**< Index of blocks.front(). */
+  bool ended; /**< Set when the source and encoder are empty. */
+  std::map<const void*, std::size_t> positions; /**< Current block
+						 *   index of each
+						 *   session.
+						 */
+
+  /** Index past the most recent cached block. */
+  std::size_t end_index() const {
+    return first_index + blocks.size();
+  }
+
+  /** Load the encoder until it has a full block, padding the last
+   *  one.
+   */
+  void load_block() {
+    while (*source_ && !encoder_->has_block()) {
+      encoder_->push(source_->next_packet());
+    }
+    if (!encoder_->has_block() && encoder_->size() > 0) {
+      BOOST_LOG_SEV(basic_lg, log::debug) <<
+	"Stream cache left with partial data: padding";
+      encoder_->pad_partial_block();
+    }
+  }
+
+  /** Encode the packets of the current block up to `n`. */
+  void fill(cached_block &b, std::size_t n) {
+    while (b.pkts.size() < n) {
+      b.pkts.push_back(encoder_->next_coded());
+    }
+  }
+
+  /** Close the most recent block and start encoding the next one. */
+  void open_next_block() {
+    cached_block &last = blocks.back();
+    std::size_t last_index = end_index() - 1;
+    bool needed = std::any_of(positions.cbegin(), positions.cend(),
+			      [last_index](const auto &p) {
+				return p.second <= last_index;
+			      });
+    if (needed) fill(last, per_block_);
+    last.closed = true;
+
+    encoder_->next_block();
+    load_block();
+    if (!*encoder_) {
+      ended = true;
+      return;
+    }
+    blocks.emplace_back(encoder_->blockno());
+    if (blocks.size() > max_blocks_) {
+      blocks.pop_front();
+      ++first_index;
+    }
+    BOOST_LOG(perf_lg) << "stream_cache::open_next_block"
+		       << " blockno=" << encoder_->blockno()
+		       << " filled_prev=" << needed;
+  }
+};
+
+/** Per-client view of a stream_cache.
+ *
+ *  This class can be used as the Encoder of a data_server: it
+ *  returns the cached coded packets in order, moving to the next
+ *  block when the cached ones are exhausted, and skips blocks on
+ *  next_block(). It does not accept input packets, so it must be used
+ *  together with a null_source. Interleaving is not supported.
+ */
+template <class Encoder, class Source>
+class stream_session {
+public:
+  typedef stream_cache<Encoder, Source> cache_type;
+  typedef typename Encoder::parameter_set parameter_set;
+
+  static constexpr std::size_t MAX_SEQNO = Encoder::MAX_SEQNO;
+  static constexpr std::size_t MAX_BLOCKNO = Encoder::MAX_BLOCKNO;
+  static constexpr std::size_t BLOCK_WINDOW = Encoder::BLOCK_WINDOW;
+
+  /** Construct a session that starts from the oldest cached block. */
+  explicit stream_session(std::shared_ptr<cache_type> cache) :
+    basic_lg(boost::log::keywords::channel = log::basic),
+    cache_(std::move(cache)),
+    index(cache_->oldest_block()),
+    count(0),
+    total_count(0) {
+    cache_->set_position(this, index);
+  }
+
+  stream_session(const stream_session&) = delete;
+  stream_session &operator=(const stream_session&) = delete;
+
+  ~stream_session() {
+    cache_->forget_position(this);
+  }
+
+  /** Not supported: the packets come from the shared source. */
+  template <class P>
+  void push(P&&) {
+    throw std::logic_error("Cannot push packets to a stream_session");
+  }
+
+  /** Do nothing: the shared encoder pads its last block. */
+  void pad_partial_block() {}
+
+  /** Return the next cached coded packet. */
+  fountain_packet next_coded() {
+    fountain_packet p;
+    for (;;) {
+      switch (cache_->fetch(index, count, p)) {
+      case cache_type::fetched:
+	++count;
+	++total_count;
+	return p;
+      case cache_type::end_of_block:
+	move_to(index + 1);
+	break;
+      case cache_type::evicted:
+	BOOST_LOG_SEV(basic_lg, log::debug) << "Session fell behind the cache";
+	move_to(cache_->oldest_block());
+	break;
+      case cache_type::end_of_stream:
+	throw std::runtime_error("The stream has no more packets");
+      }
+    }
+  }
+
+  /** Skip to the next block. */
+  void next_block() {
+    move_to(index + 1);
+  }
+
+  /** Skip to the block number `bn`, unless it is an old one. */
+  void next_block(std::size_t bn) {
+    circular_counter<std::size_t> curr(MAX_BLOCKNO), target(MAX_BLOCKNO);
+    curr.set(blockno());
+    target.set(bn);
+    std::size_t dist = curr.forward_distance(target);
+    if (dist == 0 || dist > BLOCK_WINDOW) return;
+    move_to(index + dist);
+  }
+
+  /** Return 1. */
+  std::size_t interleave_depth() const {
+    return 1;
+  }
+
+  /** Throw unless `depth` is 1. */
+  void interleave_depth(std::size_t depth) {
+    if (depth != 1)
+      throw std::invalid_argument("A stream_session cannot interleave blocks");
+  }
+
+  /** True while there are packets to send. */
+  bool has_block() const {
+    return cache_->has_packets(index, count);
+  }
+
+  /** Block number of the current block. */
+  std::size_t blockno() const {
+    std::size_t oldest = cache_->oldest_block();
+    return cache_->blockno(std::max(index, oldest));
+  }
+
+  /** Number of input packets in each block. */
+  std::size_t K() const {
+    return cache_->K();
+  }
+
+  /** Always 0: the input packets are held by the shared encoder. */
+  std::size_t size() const {
+    return 0;
+  }
+
+  /** Number of coded packets sent for the current block. */
+  std::size_t coded_count() const {
+    return count;
+  }
+
+  /** Total number of coded packets sent by this session. */
+  std::size_t total_coded_count() const {
+    return total_count;
+  }
+
+  /** Return the shared cache. */
+  const cache_type &cache() const {
+    return *cache_;
+  }
+
+  /** Is true when coded packets can be produced. */
+  explicit operator bool() const {
+    return has_block();
+  }
+
+  /** Is true when there are no more coded packets. */
+  bool operator!() const {
+    return !has_block();
+  }
+
+private:
+  log::default_logger basic_lg;
+
+  std::shared_ptr<cache_type> cache_;
+  std::size_t index; /**< Index of the current block in the cache. */
+  std::size_t count; /**< Packets sent for the current block. */
+  std::size_t total_count; /**< Packets sent for all the blocks. */
+
+  /** Set the current block index. */
+  void move_to(std::size_t bi) {
+    index = bi;
+    count = 0;
+    cache_->set_position(this, index);
+  }
+};
+
+/** Source that never has packets, used together with a
+ *  stream_session.
+ */
+class null_source {
+public:
+  struct parameter_set {};
+
+  /** Always throws. */
+  fountain_packet next_packet() {
+    throw std::logic_error("A null_source has no packets");
+  }
+
+  /** Always false. */
+  explicit operator bool() const {
+    return false;
+  }
+
+  /** Always true. */
+  bool operator!() const {
+    return true;
+  }
+};
+
+}
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef UEP_THREAD_POOL_HPP
+#define UEP_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace uep {
+
+/** Fixed set of threads that execute the same job in parallel.
+ *
+ *  A pool of size n starts n-1 threads: the thread that calls run()
+ *  takes part in the job as the first worker. Concurrent calls to
+ *  run() are serialized.
+ */
+class thread_pool {
+public:
+  /** Construct a pool with `n_threads` workers, including the caller. */
+  explicit thread_pool(std::size_t n_threads) :
+    n_workers(n_threads),
+    generation(0),
+    pending(0),
+    stopping(false) {
+    if (n_threads == 0)
+      throw std::invalid_argument("The pool needs at least one thread");
+    errors.resize(n_threads);
+    threads.reserve(n_threads - 1);
+    for (std::size_t w = 1; w < n_threads; ++w) {
+      threads.emplace_back(&thread_pool::worker_loop, this, w);
+    }
+  }
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool &operator=(const thread_pool&) = delete;
+
+  /** Stop and join all the threads. */
+  ~thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(jobs_mutex);
+      stopping = true;
+    }
+    start_cv.notify_all();
+    for (std::thread &t : threads) t.join();
+  }
+
+  /** Return the number of workers, including the caller. */
+  std::size_t size() const {
+    return n_workers;
+  }
+
+  /** Call f(w) once for each worker index w in [0, size()) and wait
+   *  until all the calls return. The first exception thrown by f is
+   *  rethrown here after all the workers are done.
+   */
+  void run(const std::function<void(std::size_t)> &f) {
+    std::lock_guard<std::mutex> run_lock(run_mutex);
+    {
+      std::lock_guard<std::mutex> lock(jobs_mutex);
+      job = &f;
+      pending = n_workers - 1;
+      ++generation;
+    }
+    start_cv.notify_all();
+
+    call_job(0);
+
+    std::unique_lock<std::mutex> lock(jobs_mutex);
+    done_cv.wait(lock, [this]{ return pending == 0; });
+    job = nullptr;
+    for (std::exception_ptr &e : errors) {
+      if (e) {
+	std::exception_ptr first = e;
+	for (std::exception_ptr &x : errors) x = nullptr;
+	std::rethrow_exception(first);
+      }
+    }
+  }
+
+private:
+  const std::size_t n_workers; /**< Number of workers, including the
+				*   caller of run().
+				*/
+  std::vector<std::thread> threads; /**< The started threads. */
+  std::mutex run_mutex; /**< Serializes the calls to run(). */
+  std::mutex jobs_mutex; /**< Protects the job state. */
+  std::condition_variable start_cv; /**< Signals a new job. */
+  std::condition_variable done_cv; /**< Signals the end of a job. */
+  const std::function<void(std::size_t)> *job; /**< Current job. */
+  std::size_t generation; /**< Number of started jobs. */
+  std::size_t pending; /**< Threads still running the current job. */
+  bool stopping; /**< Set when the pool is destroyed. */
+  std::vector<std::exception_ptr> errors; /**< Exception thrown by
+					   *   each worker.
+					   */
+
+  /** Run the current job as worker w, saving any exception. */
+  void call_job(std::size_t w) {
+    try {
+      (*job)(w);
+    }
+    catch (...) {
+      errors[w] = std::current_exception();
+    }
+  }
+
+  /** Loop executed by each started thread. */
+  void worker_loop(std::size_t w) {
+    std::size_t seen = 0;
+    for (;;) {
+      {
+	std::unique_lock<std::mutex> lock(jobs_mutex);
+	start_cv.wait(lock, [this, seen]{
+	    return stopping || generation != seen;
+	  });
+	if (stopping) return;
+	seen = generation;
+      }
+
+      call_job(w);
+
+      std::lock_guard<std::mutex> lock(jobs_mutex);
+      if (--pending == 0) done_cv.notify_one();
+    }
+  }
+};
+
+}
+
+#endif
@@ -5,11 +5,29 @@ using namespace std;
 namespace uep {
 
 uep_decoder::uep_decoder(const parameter_set &ps) :
-  uep_decoder(ps.Ks.begin(), ps.Ks.end(),
-	      ps.RFs.begin(), ps.RFs.end(),
-	      ps.EF,
-	      ps.c,
-	      ps.delta) {
+  uep_decoder(make_uep_row_generator(ps)) {
+}
+
+uep_decoder::uep_decoder(std::unique_ptr<uep_row_generator> &&uep_rowgen) :
+  basic_lg(boost::log::keywords::channel = log::basic),
+  perf_lg(boost::log::keywords::channel = log::performance),
+  empty_queued_count(0),
+  seqno_ctr(std::numeric_limits<uep_packet::seqno_type>::max()),
+  tot_dec_count(0),
+  tot_fail_count(0) {
+  out_queues.resize(uep_rowgen->Ks().size());
+
+  std_dec = std::make_unique<lt_decoder>(std::move(uep_rowgen));
+
+  seqno_ctr.set(0);
+
+  BOOST_LOG_SEV(basic_lg, log::debug) << "Constructed a uep_decoder."
+				      << " Ks=" << row_generator().Ks()
+				      << " RFs=" << row_generator().RFs()
+				      << " EF=" << row_generator().EF()
+				      << " WPs=" << row_generator().WPs()
+				      << " c=" << row_generator().c()
+				      << " delta=" << row_generator().delta();
 }
 
 void uep_decoder::push(const fountain_packet &p) {
@@ -74,6 +92,94 @@ void uep_decoder::flush_n_blocks(std::size_t n) {
   deduplicate_queued();
 }
 
+void uep_decoder::interleave_depth(std::size_t depth) {
+  std_dec->interleave_depth(depth);
+}
+
+std::size_t uep_decoder::interleave_depth() const {
+  return std_dec->interleave_depth();
+}
+
+void uep_decoder::reorder_window(std::size_t n) {
+  std_dec->reorder_window(n);
+}
+
+std::size_t uep_decoder::reorder_window() const {
+  return std_dec->reorder_window();
+}
+
+void uep_decoder::enable_elimination(std::size_t max_unknowns) {
+  std_dec->enable_elimination(max_unknowns);
+}
+
+std::size_t uep_decoder::elimination_limit() const {
+  return std_dec->elimination_limit();
+}
+
+void uep_decoder::enable_xor_schedule(std::size_t threads) {
+  std_dec->enable_xor_schedule(threads);
+}
+
+std::size_t uep_decoder::xor_schedule_threads() const {
+  return std_dec->xor_schedule_threads();
+}
+
+void uep_decoder::enable_parallel_peeling(std::size_t threads) {
+  std_dec->enable_parallel_peeling(threads);
+}
+
+std::size_t uep_decoder::parallel_peeling_threads() const {
+  return std_dec->parallel_peeling_threads();
+}
+
+void uep_decoder::set_decoded_callback(decoded_callback cb) {
+  if (!cb) {
+    std_dec->set_decoded_callback(block_decoder::decoded_callback());
+    return;
+  }
+  // End of each sub-block in the input positions
+  const auto &Ks = row_generator().Ks();
+  std::vector<std::size_t> ends(Ks.size());
+  std::partial_sum(Ks.cbegin(), Ks.cend(), ends.begin());
+  std_dec->set_decoded_callback([cb, ends](std::size_t blockno,
+					   std::size_t i,
+					   const packet &p) {
+      uep_packet up = uep_packet::from_packet(p);
+      if (up.padding()) return;
+      up.priority(std::upper_bound(ends.cbegin(), ends.cend(), i) -
+		  ends.cbegin());
+      cb(blockno, up);
+    });
+}
+
+void uep_decoder::set_ripple_order(mp::ripple_order order) {
+  std::vector<std::size_t> priorities;
+  if (order == mp::ripple_order::priority) {
+    // The sub-blocks are stored in order of importance
+    const auto &Ks = row_generator().Ks();
+    for (std::size_t subblock = 0; subblock < Ks.size(); ++subblock) {
+      priorities.insert(priorities.end(), Ks[subblock], subblock);
+    }
+  }
+  std_dec->set_ripple_order(order, priorities);
+}
+
+void uep_decoder::set_decode_budget(std::size_t max_decoded) {
+  std_dec->set_decode_budget(max_decoded);
+}
+
+void uep_decoder::enable_attempt_throttling(double step) {
+  std_dec->enable_attempt_throttling(step);
+}
+
+double uep_decoder::success_probability(std::size_t extra) const {
+  return std_dec->success_probability(extra);
+}
+
+std::size_t uep_decoder::needed_estimate() const {
+  return std_dec->needed_estimate();
+}
+
 bool uep_decoder::has_decoded() const {
   return std_dec->has_decoded();
 }
@@ -1,6 +1,7 @@
 #ifndef UEP_UEP_DECODER_HPP
 #define UEP_UEP_DECODER_HPP
 
+#include <functional>
 #include <limits>
 
 #include <boost/iterator/iterator_adaptor.hpp>
@@ -20,6 +21,10 @@ class uep_decoder {
 public:
   /** The collection of parameters required to setup the decoder. */
   typedef lt_uep_parameter_set parameter_set;
+  /** Type of the function called for each decoded packet with the
+   *  block number and the packet.
+   */
+  typedef std::function<void(std::size_t, const uep_packet&)> decoded_callback;
 
   static constexpr std::size_t BLOCK_WINDOW = lt_decoder::BLOCK_WINDOW;
   static constexpr std::size_t MAX_BLOCKNO = lt_decoder::MAX_BLOCKNO;
@@ -31,6 +36,16 @@ public:
 		       std::size_t EF,
 		       double c,
 		       double delta);
+  /** Construct using the given sub-block sizes, expanding window
+   *  probabilities, c and delta. \sa uep_row_generator
+   */
+  template<typename KsIter, typename WPsIter>
+  explicit uep_decoder(KsIter ks_begin, KsIter ks_end,
+		       WPsIter wps_begin, WPsIter wps_end,
+		       double c,
+		       double delta);
+  /** Construct using the given row generator. */
+  explicit uep_decoder(std::unique_ptr<uep_row_generator> &&rg);
 
   /** Pass a received packet. \sa push(fountain_packet&&) */
   void push(const fountain_packet &p);
@@ -80,6 +95,71 @@ public:
    */
   void flush_n_blocks(std::size_t n);
 
+  /** Set the number of consecutive blocks that can receive packets
+   *  at the same time. \sa lt_decoder::interleave_depth(std::size_t)
+   */
+  void interleave_depth(std::size_t depth);
+  /** Return the number of consecutive blocks that can receive
+   *  packets at the same time.
+   */
+  std::size_t interleave_depth() const;
+  /** Keep `n` more blocks to handle the reordering.
+   *  \sa lt_decoder::reorder_window(std::size_t)
+   */
+  void reorder_window(std::size_t n);
+  /** Return the number of blocks added to handle the reordering. */
+  std::size_t reorder_window() const;
+
+  /** Enable the Gaussian elimination when the message passing
+   *  stalls. \sa lt_decoder::enable_elimination
+   */
+  void enable_elimination(std::size_t max_unknowns);
+  /** Return the limit set by enable_elimination(). */
+  std::size_t elimination_limit() const;
+  /** Execute the XORs after the peeling with the given number of
+   *  threads. \sa lt_decoder::enable_xor_schedule
+   */
+  void enable_xor_schedule(std::size_t threads);
+  /** Return the value set by enable_xor_schedule(). */
+  std::size_t xor_schedule_threads() const;
+  /** Peel the large blocks with the given number of threads.
+   *  \sa lt_decoder::enable_parallel_peeling
+   */
+  void enable_parallel_peeling(std::size_t threads);
+  /** Return the value set by enable_parallel_peeling(). */
+  std::size_t parallel_peeling_threads() const;
+
+  /** Call `cb` with the block number and each decoded packet as soon
+   *  as it is decoded, before it is released by next_decoded(). The
+   *  packet carries its sequence number and the priority of its
+   *  sub-block. The padding packets are not passed.
+   *  \sa lt_decoder::set_decoded_callback
+   */
+  void set_decoded_callback(decoded_callback cb);
+
+  /** Set the ripple order of the message passing. With
+   *  mp::ripple_order::priority the packets of the most important
+   *  sub-blocks are decoded first. \sa lt_decoder::set_ripple_order
+   */
+  void set_ripple_order(mp::ripple_order order);
+  /** Limit the number of packets decoded after each push.
+   *  \sa lt_decoder::set_decode_budget
+   */
+  void set_decode_budget(std::size_t max_decoded);
+  /** Skip the decoding attempts that are unlikely to succeed.
+   *  \sa lt_decoder::enable_attempt_throttling
+   */
+  void enable_attempt_throttling(double step);
+  /** Estimate the probability that the current block is decoded once
+   *  `extra` more unique packets are received.
+   *  \sa lt_decoder::success_probability
+   */
+  double success_probability(std::size_t extra) const;
+  /** Estimate how many more unique packets are needed to decode the
+   *  current block. \sa lt_decoder::needed_estimate
+   */
+  std::size_t needed_estimate() const;
+
   /** Return true if the current block has been decoded. */
   bool has_decoded() const;
   /** Return the output block size. */
@@ -172,29 +252,22 @@ uep_decoder::uep_decoder(KsIter ks_begin, KsIter ks_end,
 			 std::size_t ef,
 			 double c,
 			 double delta) :
-  basic_lg(boost::log::keywords::channel = log::basic),
-  perf_lg(boost::log::keywords::channel = log::performance),
-  empty_queued_count(0),
-  seqno_ctr(std::numeric_limits<uep_packet::seqno_type>::max()),
-  tot_dec_count(0),
-  tot_fail_count(0) {
-  auto uep_rowgen = std::make_unique<uep_row_generator>(ks_begin, ks_end,
-							rfs_begin, rfs_end,
-							ef,
-							c,
-							delta);
-  out_queues.resize(uep_rowgen->Ks().size());
-
-  std_dec = std::make_unique<lt_decoder>(std::move(uep_rowgen));
-
-  seqno_ctr.set(0);
-
-  BOOST_LOG_SEV(basic_lg, log::debug) << "Constructed a uep_decoder."
-				      << " Ks=" << row_generator().Ks()
-				      << " RFs=" << row_generator().RFs()
-				      << " EF=" << row_generator().EF()
-				      << " c=" << row_generator().c()
-				      << " delta=" << row_generator().delta();
+  uep_decoder(std::make_unique<uep_row_generator>(ks_begin, ks_end,
+						  rfs_begin, rfs_end,
+						  ef,
+						  c,
+						  delta)) {
+}
+
+template<typename KsIter, typename WPsIter>
+uep_decoder::uep_decoder(KsIter ks_begin, KsIter ks_end,
+			 WPsIter wps_begin, WPsIter wps_end,
+			 double c,
+			 double delta) :
+  uep_decoder(std::make_unique<uep_row_generator>(ks_begin, ks_end,
+						  wps_begin, wps_end,
+						  c,
+						  delta)) {
 }
 
 template <class Iter>
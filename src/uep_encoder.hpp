@@ -42,6 +42,16 @@ public:
 		       std::size_t ef,
 		       double c,
 		       double delta);
+  /** Construct using the given sub-block sizes, expanding window
+   *  probabilities, c and delta. \sa uep_row_generator
+   */
+  template<typename KsIter, typename WPsIter>
+  explicit uep_encoder(KsIter ks_begin, KsIter ks_end,
+		       WPsIter wps_begin, WPsIter wps_end,
+		       double c,
+		       double delta);
+  /** Construct using the given row generator. */
+  explicit uep_encoder(std::unique_ptr<uep_row_generator> &&rg);
 
   /** Enqueue a packet according to its priority level. */
   void push(fountain_packet &&p);
@@ -56,7 +66,9 @@ public:
   fountain_packet next_coded();
 
   /** Fill a partial block with padding packets. This allows to encode
-   *  even if there are no more source packets to be passed.
+   *  even if there are no more source packets to be passed. When
+   *  interleaving, the encoder then also works with less open blocks
+   *  than the interleave depth.
    */
   void pad_partial_block();
 
@@ -70,6 +82,13 @@ public:
    */
   void next_block(std::size_t bn);
 
+  /** Set the number of blocks that are encoded at the same
+   *  time. \sa lt_encoder::interleave_depth(std::size_t)
+   */
+  void interleave_depth(std::size_t depth);
+  /** Return the number of blocks that are encoded at the same time. */
+  std::size_t interleave_depth() const;
+
   /** Return true when the encoder has been passed at least K packets
    *  and is ready to produce a coded packet.
    */
@@ -115,11 +134,32 @@ public:
   /** Return the total number of coded packets that were produced. */
   std::size_t total_coded_count() const;
 
+  /** Cache the XOR of the pairs of packets that are used more than
+   *  once in a block. \sa block_encoder::enable_xor_cache()
+   */
+  void enable_xor_cache(std::size_t max_bytes);
+  /** Return the total number of packet XORs performed. */
+  std::size_t xor_count() const;
+  /** Return the total number of packet XORs avoided by the cache. */
+  std::size_t saved_xor_count() const;
+  /** Return the fraction of the XOR cache lookups that were hits. */
+  double xor_cache_hit_rate() const;
+
   /** Number of padding packets added to the current block. */
   std::size_t padding_count() const;
   /** Total number of padding packets added to all blocks. */
   std::size_t total_padding_count() const;
 
+  /** Return a snapshot of the encoder, including the packets in the
+   *  priority queues, that can be passed to restore_state().
+   */
+  uep_encoder_state save_state() const;
+  /** Replace the current state with a snapshot produced by
+   *  save_state(). The encoder must have been constructed with the
+   *  same parameters.
+   */
+  void restore_state(const uep_encoder_state &st);
+
   /** Is true when coded packets can be produced. */
   explicit operator bool() const;
   /** Is true when there is not a full block available. */
@@ -157,7 +197,9 @@ private:
 					*   encoding time.
 					*/
 
-  /** Check whether the queues have enough packets to build a block. */
+  /** Pass the blocks that can be built from the queues to the LT
+   *  encoder, until its interleaving window is full.
+   */
   void check_has_block();
 };
 
@@ -170,15 +212,31 @@ uep_encoder<Gen>::uep_encoder(KsIter ks_begin, KsIter ks_end,
 			      std::size_t ef,
 			      double c,
 			      double delta) :
+  uep_encoder(std::make_unique<uep_row_generator>(ks_begin, ks_end,
+						  rfs_begin, rfs_end,
+						  ef,
+						  c,
+						  delta)) {
+}
+
+template <class Gen>
+template<typename KsIter, typename WPsIter>
+uep_encoder<Gen>::uep_encoder(KsIter ks_begin, KsIter ks_end,
+			      WPsIter wps_begin, WPsIter wps_end,
+			      double c,
+			      double delta) :
+  uep_encoder(std::make_unique<uep_row_generator>(ks_begin, ks_end,
+						  wps_begin, wps_end,
+						  c,
+						  delta)) {
+}
+
+template <class Gen>
+uep_encoder<Gen>::uep_encoder(std::unique_ptr<uep_row_generator> &&uep_rowgen) :
   basic_lg(boost::log::keywords::channel = log::basic),
   perf_lg(boost::log::keywords::channel = log::performance),
   seqno_ctr(std::numeric_limits<uep_packet::seqno_type>::max()),
   pktsize(0) {
-  auto uep_rowgen = std::make_unique<uep_row_generator>(ks_begin, ks_end,
-							rfs_begin, rfs_end,
-							ef,
-							c,
-							delta);
   const auto &Ks = uep_rowgen->Ks();
   inp_queues.reserve(Ks.size());
   for (std::size_t Ki : Ks) {
@@ -192,11 +250,7 @@ uep_encoder<Gen>::uep_encoder(KsIter ks_begin, KsIter ks_end,
 
 template<typename Gen>
 uep_encoder<Gen>::uep_encoder(const parameter_set &ps) :
-  uep_encoder(ps.Ks.begin(), ps.Ks.end(),
-	      ps.RFs.begin(), ps.RFs.end(),
-	      ps.EF,
-	      ps.c,
-	      ps.delta) {
+  uep_encoder(make_uep_row_generator(ps)) {
 }
 
 template <class Gen>
@@ -254,22 +308,25 @@ fountain_packet uep_encoder<Gen>::next_coded() {
 
 template<typename Gen>
 void uep_encoder<Gen>::pad_partial_block() {
-  if (has_block()) return;
-
-  std::size_t pad_cnt = 0;
-  for (queue_type &q : inp_queues) {
-    while (!q.has_block()) {
-      // Don't give the padding pkts a seqno
-      q.push(uep_packet::make_padding(pktsize));
-      ++pad_cnt;
+  // The LT encoder may already hold some blocks when interleaving
+  if (!has_block() && queue_size() > 0) {
+    std::size_t pad_cnt = 0;
+    for (queue_type &q : inp_queues) {
+      while (!q.has_block()) {
+	// Don't give the padding pkts a seqno
+	q.push(uep_packet::make_padding(pktsize));
+	++pad_cnt;
+      }
     }
-  }
-  padding_cnt.add_sample(pad_cnt);
+    padding_cnt.add_sample(pad_cnt);
 
-  BOOST_LOG(perf_lg) << "uep_encoder::pad_partial_block"
-		     << " pad_cnt=" << pad_cnt;
+    BOOST_LOG(perf_lg) << "uep_encoder::pad_partial_block"
+		       << " pad_cnt=" << pad_cnt;
 
-  check_has_block();
+    check_has_block();
+  }
+  // Do not wait for more blocks to fill the interleaving window
+  std_enc->pad_partial_block();
 }
 
 template <class Gen>
@@ -288,23 +345,31 @@ void uep_encoder<Gen>::next_block(std::size_t bn) {
   if (!wanted_bnc.is_after(curr_bnc)) return;
   std::size_t dist = curr_bnc.forward_distance(wanted_bnc);
 
-  // Drop `dist-1` blocks from the queues
-  for (std::size_t i = 0; i < dist - 1; ++i) {
+  // Drop from the queues the blocks that the LT encoder does not hold
+  std::size_t held = std_enc->size() / std_enc->K();
+  if (dist > held) {
     for (queue_type &iq : inp_queues) {
-      iq.pop_block();
+      iq.pop_blocks(dist - held);
     }
   }
 
-  // Push `dist-1` empty blocks
-  for (std::size_t i = 0; i < K() * (dist - 1); ++i) {
-    std_enc->push(packet());
-  }
-
-  std_enc->next_block(bn);
+  // The skipped blocks were never passed to the LT encoder
+  std_enc->skip_to_block(bn);
   padding_cnt.clear_last();
   check_has_block();
 }
 
+template <class Gen>
+void uep_encoder<Gen>::interleave_depth(std::size_t depth) {
+  std_enc->interleave_depth(depth);
+  check_has_block();
+}
+
+template <class Gen>
+std::size_t uep_encoder<Gen>::interleave_depth() const {
+  return std_enc->interleave_depth();
+}
+
 template <class Gen>
 bool uep_encoder<Gen>::has_block() const {
   return std_enc->has_block();
@@ -404,6 +469,58 @@ std::size_t uep_encoder<Gen>::total_coded_count() const {
   return std_enc->total_coded_count();
 }
 
+template <class Gen>
+void uep_encoder<Gen>::enable_xor_cache(std::size_t max_bytes) {
+  std_enc->enable_xor_cache(max_bytes);
+}
+
+template <class Gen>
+std::size_t uep_encoder<Gen>::xor_count() const {
+  return std_enc->xor_count();
+}
+
+template <class Gen>
+std::size_t uep_encoder<Gen>::saved_xor_count() const {
+  return std_enc->saved_xor_count();
+}
+
+template <class Gen>
+double uep_encoder<Gen>::xor_cache_hit_rate() const {
+  return std_enc->xor_cache_hit_rate();
+}
+
+template <class Gen>
+uep_encoder_state uep_encoder<Gen>::save_state() const {
+  uep_encoder_state st;
+  st.lt_state = std_enc->save_state();
+  for (const queue_type &q : inp_queues) {
+    for (std::size_t i = 0; i < q.size(); ++i) {
+      st.queued.push_back(q.at(i).to_fountain_packet());
+    }
+  }
+  st.seqno = seqno_ctr.value();
+  st.pktsize = pktsize;
+  return st;
+}
+
+template <class Gen>
+void uep_encoder<Gen>::restore_state(const uep_encoder_state &st) {
+  std_enc->restore_state(st.lt_state);
+  for (queue_type &q : inp_queues) {
+    q.clear();
+  }
+  for (const fountain_packet &fp : st.queued) {
+    uep_packet up = uep_packet::from_fountain_packet(fp);
+    if (inp_queues.size() <= up.priority())
+      throw std::runtime_error("Priority is out of range");
+    inp_queues[up.priority()].push(std::move(up));
+  }
+  seqno_ctr.set(st.seqno);
+  pktsize = st.pktsize;
+  padding_cnt.clear_last();
+  check_has_block();
+}
+
 template <class Gen>
 uep_encoder<Gen>::operator bool() const {
   return has_block();
@@ -416,34 +533,33 @@ bool uep_encoder<Gen>::operator!() const {
 
 template <class Gen>
 void uep_encoder<Gen>::check_has_block() {
-  if (std_enc->has_block()) return; // Already has a block
-  if (std::any_of(inp_queues.cbegin(),
-		  inp_queues.cend(),
-		  [](const queue_type &q){
-		    return !q.has_block();
-		  })) {
-    return; // Not all sub-blocks are available
-  }
-
-  // Count the non-padding packets for each sub-block
-  std::vector<std::size_t> pkt_counts(inp_queues.size(), 0);
-
-  // Iterate over all queues
-  for (std::size_t i = 0; i < inp_queues.size(); ++i) {
-    queue_type &q = inp_queues[i];
-
-    // Convert the sub-block to packets
-    for (auto l = q.block_begin(); l != q.block_end(); ++l) {
-      const uep_packet &p = *l;
-      if (!p.padding()) ++pkt_counts[i];
-      std_enc->push(p.to_packet());
+  // Stop when the window is full or not all sub-blocks are available
+  while (std_enc->open_block_count() < std_enc->interleave_depth() &&
+	 std::all_of(inp_queues.cbegin(),
+		     inp_queues.cend(),
+		     [](const queue_type &q){
+		       return q.has_block();
+		     })) {
+    // Count the non-padding packets for each sub-block
+    std::vector<std::size_t> pkt_counts(inp_queues.size(), 0);
+
+    // Iterate over all queues
+    for (std::size_t i = 0; i < inp_queues.size(); ++i) {
+      queue_type &q = inp_queues[i];
+
+      // Convert the sub-block to packets
+      for (auto l = q.block_begin(); l != q.block_end(); ++l) {
+	const uep_packet &p = *l;
+	if (!p.padding()) ++pkt_counts[i];
+	std_enc->push(p.to_packet());
+      }
+      q.pop_block();
     }
-    q.pop_block();
-  }
 
-  BOOST_LOG(perf_lg) << "uep_encoder::check_has_block"
-		     << " new_block"
-		     << " non_padding_pkts=" << pkt_counts;
+    BOOST_LOG(perf_lg) << "uep_encoder::check_has_block"
+		       << " new_block"
+		       << " non_padding_pkts=" << pkt_counts;
+  }
 }
 
 template<typename Gen>
@@ -4,6 +4,10 @@
 
 #include "block_decoder.hpp"
 
+#include <cstdlib>
+#include <new>
+#include <random>
+
 using namespace std;
 using namespace uep;
 
@@ -21,6 +25,24 @@ struct global_fixture {
 };
 BOOST_GLOBAL_FIXTURE(global_fixture);
 
+// Count the heap allocations made by the whole program
+static size_t alloc_count = 0;
+
+void *operator new(size_t n) {
+  ++alloc_count;
+  void *p = malloc(n == 0 ? 1 : n);
+  if (!p) throw bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  free(p);
+}
+
 BOOST_AUTO_TEST_CASE(check_rows) {
   const int seed = 0x42424242;
   lt_row_generator rowgen(robust_soliton_distribution(3, 0.1, 0.5));
@@ -137,6 +159,58 @@ BOOST_FIXTURE_TEST_CASE(duplicate_packets, setup_packets) {
   }
 }
 
+BOOST_FIXTURE_TEST_CASE(duplicates_in_range, setup_packets) {
+  block_decoder dec(lt_row_generator(robust_soliton_distribution(3,0.1,0.5)));
+  // The duplicates do not stop the rest of the range
+  vector<fountain_packet> batch{received[0], received[0], received[1],
+      received[1], received[2], received[3]};
+  BOOST_CHECK_EQUAL(dec.push(batch.cbegin(), batch.cend()), 4);
+  BOOST_CHECK_EQUAL(dec.received_count(), 4);
+  BOOST_CHECK(dec.has_decoded());
+  BOOST_CHECK(equal(dec.block_begin(), dec.block_end(), expected.cbegin()));
+
+  // The received seqnos are forgotten after a reset
+  dec.reset();
+  BOOST_CHECK_EQUAL(dec.received_count(), 0);
+  BOOST_CHECK_EQUAL(dec.push(batch.cbegin(), batch.cend()), 4);
+  BOOST_CHECK(dec.has_decoded());
+}
+
+BOOST_FIXTURE_TEST_CASE(large_seqnos, setup_packets) {
+  block_decoder dec(lt_row_generator(robust_soliton_distribution(3,0.1,0.5)));
+  fountain_packet p(received[0]);
+  p.sequence_number(0x12345);
+  BOOST_CHECK(dec.push(p));
+  BOOST_CHECK(!dec.push(p));
+  p.sequence_number(0x12344);
+  BOOST_CHECK(dec.push(p));
+  BOOST_CHECK_EQUAL(dec.received_count(), 2);
+
+  dec.reset();
+  BOOST_CHECK(dec.push(p));
+  BOOST_CHECK_EQUAL(dec.received_count(), 1);
+}
+
+BOOST_FIXTURE_TEST_CASE(iterators_return_references, setup_packets) {
+  block_decoder dec(lt_row_generator(robust_soliton_distribution(3,0.1,0.5)));
+  dec.push(received[0]);
+  dec.push(received[1]);
+
+  // The empty inputs are all the same packet
+  BOOST_CHECK(!*dec.partial_begin());
+  BOOST_CHECK_EQUAL(&*dec.partial_begin(), &*std::next(dec.partial_begin()));
+
+  dec.push(received[2]);
+  dec.push(received[3]);
+  BOOST_REQUIRE(dec.has_decoded());
+  for (auto i = dec.block_begin(); i != dec.block_end(); ++i) {
+    const packet &p = *i;
+    BOOST_CHECK_EQUAL(&p, &*i);
+  }
+  BOOST_CHECK_EQUAL(&*dec.block_begin(), &*dec.partial_begin());
+  BOOST_CHECK(equal(dec.block_begin(), dec.block_end(), expected.cbegin()));
+}
+
 BOOST_FIXTURE_TEST_CASE(out_of_order, setup_packets) {
   block_decoder dec(lt_row_generator(robust_soliton_distribution(3,0.1,0.5)));
   vector<fountain_packet> recv;
@@ -157,3 +231,88 @@ BOOST_FIXTURE_TEST_CASE(out_of_order, setup_packets) {
     ++i; ++j;
   }
 }
+
+BOOST_FIXTURE_TEST_CASE(incremental_decoding, setup_packets) {
+  block_decoder dec(lt_row_generator(robust_soliton_distribution(3,0.1,0.5)));
+  const size_t expected_count[] = {0, 0, 0, 3};
+
+  for (int i = 0; i < 4; ++i) {
+    dec.push(received[i]);
+    BOOST_CHECK_EQUAL(dec.received_count(), i+1);
+    BOOST_CHECK_EQUAL(dec.decoded_count(), expected_count[i]);
+  }
+  BOOST_CHECK(dec.has_decoded());
+  BOOST_CHECK(equal(dec.block_begin(), dec.block_end(), expected.cbegin()));
+
+  // The same packets decode again after a reset
+  dec.reset();
+  BOOST_CHECK_EQUAL(dec.received_count(), 0);
+  for (int i = 3; i >= 0; --i) dec.push(received[i]);
+  BOOST_CHECK(dec.has_decoded());
+  BOOST_CHECK(equal(dec.block_begin(), dec.block_end(), expected.cbegin()));
+}
+
+BOOST_FIXTURE_TEST_CASE(decoded_callback, setup_packets) {
+  block_decoder dec(lt_row_generator(robust_soliton_distribution(3,0.1,0.5)));
+  vector<packet> notified(3);
+  size_t calls = 0;
+  dec.set_decoded_callback([&](size_t blockno, size_t i, const packet &p) {
+      BOOST_CHECK_EQUAL(blockno, 42);
+      BOOST_CHECK(!notified.at(i));
+      notified[i] = p;
+      ++calls;
+    });
+
+  for (int i = 0; i < 3; ++i) dec.push(received[i]);
+  BOOST_CHECK_EQUAL(calls, 0);
+  dec.push(received[3]);
+  BOOST_CHECK_EQUAL(calls, 3);
+  BOOST_CHECK(notified == expected);
+}
+
+BOOST_AUTO_TEST_CASE(flat_allocations_per_block) {
+  const size_t K = 200;
+  const size_t L = 64;
+  const size_t nblocks = 20;
+  robust_soliton_distribution dist(K, 0.1, 0.5);
+  lt_row_generator enc_rows(dist);
+  block_decoder dec{lt_row_generator(dist)};
+  std::mt19937 g;
+  // Same rows in each block, so that the decoder needs the same storage
+  const int seed = 0x42424242;
+
+  vector<size_t> allocs;
+  for (size_t b = 0; b < nblocks; ++b) {
+    // Encode the block outside of the counted section
+    vector<packet> src;
+    for (size_t i = 0; i < K; ++i) {
+      src.push_back(packet(L, 0));
+      for (size_t j = 0; j < L; ++j) src.back()[j] = g();
+    }
+    enc_rows.reset(seed);
+    vector<fountain_packet> coded;
+    for (size_t n = 0; n < 2*K; ++n) {
+      auto row = enc_rows.next_row();
+      fountain_packet p(L, 0);
+      for (size_t i : row) p ^= src[i];
+      p.block_seed(seed);
+      p.block_number(b);
+      p.sequence_number(n);
+      coded.push_back(move(p));
+    }
+
+    size_t before = alloc_count;
+    auto i = coded.begin();
+    while (!dec.has_decoded() && i != coded.end()) dec.push(move(*i++));
+    BOOST_REQUIRE(dec.has_decoded());
+    BOOST_CHECK(equal(dec.block_begin(), dec.block_end(), src.cbegin()));
+    dec.reset();
+    allocs.push_back(alloc_count - before);
+  }
+
+  // After the first blocks, no new storage is needed
+  BOOST_CHECK_GT(allocs[0], 0);
+  for (size_t b = nblocks/2; b < nblocks; ++b) {
+    BOOST_CHECK_EQUAL(allocs[b], 0);
+  }
+}
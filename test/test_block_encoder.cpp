@@ -2,7 +2,10 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <cmath>
+
 #include "block_encoder.hpp"
+#include "block_queues.hpp"
 
 using namespace std;
 using namespace uep;
@@ -60,3 +63,105 @@ BOOST_FIXTURE_TEST_CASE(correct_encoding, setup_packets) {
   BOOST_CHECK_EQUAL(enc.output_count(), 4);
   BOOST_CHECK(equal(out.cbegin(), out.cend(), expected.cbegin()));
 }
+
+BOOST_FIXTURE_TEST_CASE(shallow_block_from_queue, setup_packets) {
+  input_block_queue q(3);
+  for (const packet &p : input) {
+    q.push(p);
+  }
+  BOOST_CHECK(q.has_block());
+
+  enc.set_seed(seed);
+  enc.set_block_shallow(q.block());
+  BOOST_CHECK(enc.can_encode());
+  BOOST_CHECK(enc.block_begin() == q.block_begin());
+
+  // Growing the queue must not move the current block
+  for (int i = 0; i < 20; ++i) {
+    q.push(packet(L, i));
+  }
+  BOOST_CHECK(enc.block_begin() == q.block_begin());
+  BOOST_CHECK_EQUAL(q.queue_size(), 20);
+
+  vector<packet> out;
+  for (int i = 0; i < 4; ++i)
+    out.push_back(enc.next_coded());
+  BOOST_CHECK(equal(out.cbegin(), out.cend(), expected.cbegin()));
+}
+
+BOOST_AUTO_TEST_CASE(block_queue_ring) {
+  block_queue<int> q(4);
+  BOOST_CHECK(q.empty());
+  BOOST_CHECK_THROW(q.block(), std::logic_error);
+
+  int next_in = 0;
+  int next_out = 0;
+  for (int round = 0; round < 10; ++round) {
+    // Push a variable number of elements and pop all the full blocks
+    for (int i = 0; i < 3 + 2*round; ++i) {
+      q.push(next_in++);
+    }
+    while (q.has_block()) {
+      auto b = q.block();
+      BOOST_CHECK_EQUAL(b.size(), 4);
+      for (int x : b) {
+	BOOST_CHECK_EQUAL(x, next_out++);
+      }
+      q.pop_block();
+    }
+    BOOST_CHECK_EQUAL(q.size(), next_in - next_out);
+  }
+
+  for (int i = 0; i < 12; ++i) {
+    q.push(next_in++);
+  }
+  std::size_t old_size = q.size();
+  q.pop_blocks(2);
+  next_out += 8;
+  BOOST_CHECK_EQUAL(q.size(), old_size - 8);
+  BOOST_CHECK_EQUAL(q.block_at(0), next_out);
+  BOOST_CHECK_THROW(q.pop_blocks(3), std::logic_error);
+
+  q.clear();
+  BOOST_CHECK(q.empty());
+  BOOST_CHECK(!q.has_block());
+}
+
+BOOST_AUTO_TEST_CASE(xor_cache_same_output) {
+  const size_t L = 100;
+  vector<size_t> Ks{5, 45};
+  vector<size_t> RFs{5, 1};
+  auto make_rowgen = [&Ks, &RFs]() {
+    return std::make_unique<uep_row_generator>(Ks.begin(), Ks.end(),
+					       RFs.begin(), RFs.end(),
+					       1, 0.1, 0.5);
+  };
+
+  vector<packet> block;
+  for (size_t i = 0; i < 50; ++i) {
+    block.push_back(packet(L, i));
+  }
+
+  block_encoder plain_enc(make_rowgen());
+  block_encoder cached_enc(make_rowgen());
+  cached_enc.enable_xor_cache(10*L);
+  BOOST_CHECK_EQUAL(cached_enc.xor_cache_max_size(), 10*L);
+
+  plain_enc.set_seed(0x1234);
+  cached_enc.set_seed(0x1234);
+  plain_enc.set_block(block.cbegin(), block.cend());
+  cached_enc.set_block(block.cbegin(), block.cend());
+
+  for (int i = 0; i < 500; ++i) {
+    packet p = plain_enc.next_coded();
+    packet c = cached_enc.next_coded();
+    BOOST_CHECK(p == c);
+  }
+
+  BOOST_CHECK(cached_enc.saved_xor_count() > 0);
+  BOOST_CHECK_EQUAL(cached_enc.xor_count() + cached_enc.saved_xor_count(),
+		    plain_enc.xor_count());
+  BOOST_CHECK(cached_enc.xor_cache_hit_rate() > 0);
+  BOOST_CHECK_EQUAL(plain_enc.saved_xor_count(), 0);
+  BOOST_CHECK(std::isnan(plain_enc.xor_cache_hit_rate()));
+}
@@ -859,3 +859,61 @@ BOOST_AUTO_TEST_CASE(uep_padding) {
   BOOST_CHECK_EQUAL(count_fail, dc.decoder().total_failed_count());
   BOOST_CHECK_EQUAL(count_ok, dc.decoder().total_decoded_count());
 }
+
+BOOST_AUTO_TEST_CASE(need_more_hints) {
+  using namespace std;
+
+  io_service io; // Global io_service object
+
+  const size_t L = 1024; // pkt size
+  const size_t K = 100; // block size
+  const double c = 0.1;
+  const double delta = 0.5;
+  const size_t N = 10*K; // total packets to send
+  const size_t max_per_block = 110; // Too few for many blocks
+  const mt19937::result_type src_seed = 0x42;
+
+  lt_encoder<std::mt19937>::parameter_set enc_ps{K,c,delta};
+  lt_decoder::parameter_set dec_ps = enc_ps;
+  random_packet_source::parameter_set src_ps{src_seed,L,N};
+  memory_sink::parameter_set sink_ps;
+
+  data_server<lt_encoder<std::mt19937>,random_packet_source> ds(io);
+  data_client<lt_decoder,memory_sink> dc(io);
+
+  ds.setup_encoder(enc_ps);
+  ds.setup_source(src_ps);
+  ds.enable_ack(true);
+  ds.max_sequence_number(max_per_block);
+  ds.ring_capacity(4); // Do not encode too far ahead of the hints
+  ds.target_send_rate(L*8*2000); // 2000 pkt/s
+  ds.open("127.0.0.1", "9999");
+
+  dc.setup_decoder(dec_ps);
+  dc.setup_sink(sink_ps);
+  dc.enable_ack(true);
+  dc.enable_need_more_hints(max_per_block, 0.9);
+  dc.expected_count(N);
+  dc.timeout(2);
+  dc.bind("9999");
+
+  dc.start_receive(ds.server_endpoint());
+  ds.start();
+  setup_termination_checks(io, ds, dc, 180);
+  io.run();
+
+  BOOST_CHECK_GT(dc.need_more_count(), 0);
+  BOOST_CHECK_GT(ds.extended_count(), 0);
+
+  const std::vector<packet> &orig = ds.source().original;
+  const std::vector<packet> &recv = dc.sink().received;
+  BOOST_CHECK_EQUAL(recv.size(), N);
+  std::size_t count_ok = 0;
+  for (std::size_t i = 0; i < recv.size() && i < orig.size(); ++i) {
+    if (recv[i]) {
+      BOOST_CHECK(recv[i] == orig[i]);
+      ++count_ok;
+    }
+  }
+  BOOST_CHECK_EQUAL(count_ok, dc.decoder().total_decoded_count());
+}
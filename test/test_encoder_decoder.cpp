@@ -652,3 +652,430 @@ BOOST_AUTO_TEST_CASE(check_decoder_flush_n) {
   BOOST_CHECK_EQUAL(dec.total_decoded_count(), good_pkts);
   BOOST_CHECK_EQUAL(dec.blockno(), nblocks % static_cast<size_t>(pow(2,16)));
 }
+
+/** Encode `nblocks` blocks with the given interleave depth, sending
+ *  `per_block` coded packets for each block and dropping a burst of
+ *  `burst` consecutive packets. Return the decoded packets.
+ */
+vector<packet> interleaved_burst_run(const vector<packet> &original,
+				     size_t K, size_t depth,
+				     size_t per_block, size_t burst,
+				     size_t burst_start) {
+  lt_encoder<std::mt19937> enc(K, 0.1, 0.5);
+  lt_decoder dec(K, 0.1, 0.5);
+  enc.interleave_depth(depth);
+  dec.interleave_depth(depth);
+
+  for (const packet &p : original) {
+    enc.push(p);
+  }
+  enc.pad_partial_block();
+
+  size_t sent = 0;
+  while (enc.has_block()) {
+    fountain_packet p = enc.next_coded();
+    if (sent < burst_start || sent >= burst_start + burst) {
+      dec.push(move(p));
+    }
+    ++sent;
+    if (enc.coded_count() == per_block) {
+      enc.next_block();
+    }
+  }
+  dec.flush(enc.blockno());
+
+  vector<packet> out;
+  while (dec) {
+    out.push_back(dec.next_decoded());
+  }
+  return out;
+}
+
+BOOST_AUTO_TEST_CASE(interleaved_round_robin) {
+  const size_t L = 10;
+  const size_t K = 50;
+  const size_t depth = 4;
+  lt_encoder<std::mt19937> enc(K, 0.1, 0.5);
+  enc.interleave_depth(depth);
+  BOOST_CHECK_EQUAL(enc.interleave_depth(), depth);
+
+  for (size_t i = 0; i < (depth+1)*K; ++i) {
+    enc.push(random_pkt(L));
+    // The window must be full before encoding
+    BOOST_CHECK_EQUAL(enc.has_block(), i+1 >= depth*K);
+  }
+  BOOST_CHECK_EQUAL(enc.open_block_count(), depth);
+  BOOST_CHECK_THROW(enc.interleave_depth(2), std::logic_error);
+
+  for (size_t n = 0; n < 3; ++n) {
+    for (size_t i = 0; i < depth; ++i) {
+      fountain_packet p = enc.next_coded();
+      BOOST_CHECK_EQUAL(p.block_number(), i);
+      BOOST_CHECK_EQUAL(p.sequence_number(), n);
+    }
+  }
+  BOOST_CHECK_EQUAL(enc.coded_count(), 3);
+
+  // The next queued block enters the window
+  enc.next_block();
+  BOOST_CHECK_EQUAL(enc.blockno(), 1);
+  BOOST_CHECK_EQUAL(enc.coded_count(), 3);
+  BOOST_CHECK_EQUAL(enc.open_block_count(), depth);
+  for (size_t i = 1; i <= depth; ++i) {
+    fountain_packet p = enc.next_coded();
+    BOOST_CHECK_EQUAL(p.block_number(), i);
+    BOOST_CHECK_EQUAL(p.sequence_number(), i == depth ? 0 : 3);
+  }
+
+  // Drop the open blocks up to block 3
+  enc.next_block(3);
+  BOOST_CHECK_EQUAL(enc.blockno(), 3);
+  BOOST_CHECK_EQUAL(enc.open_block_count(), 2);
+  BOOST_CHECK(!enc.has_block());
+  enc.pad_partial_block();
+  BOOST_CHECK(enc.has_block());
+  BOOST_CHECK_EQUAL(enc.next_coded().block_number(), 3);
+  BOOST_CHECK_EQUAL(enc.next_coded().block_number(), 4);
+  BOOST_CHECK_EQUAL(enc.next_coded().block_number(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(interleaved_burst_loss) {
+  const size_t L = 10;
+  const size_t K = 100;
+  const size_t nblocks = 8;
+  const size_t per_block = 2*K;
+  const size_t burst = 120;
+
+  vector<packet> original;
+  for (size_t i = 0; i < nblocks*K; ++i) {
+    original.push_back(random_pkt(L));
+  }
+
+  // Without interleaving the burst falls in a single block
+  vector<packet> plain = interleaved_burst_run(original, K, 1,
+					       per_block, burst, 3*per_block);
+  BOOST_REQUIRE_EQUAL(plain.size(), original.size());
+  size_t plain_failed = count_if(plain.cbegin(), plain.cend(),
+				 [](const packet &p){ return !p; });
+  BOOST_CHECK_GT(plain_failed, 0);
+
+  // With interleaving it is spread over four blocks
+  vector<packet> inter = interleaved_burst_run(original, K, 4,
+					       per_block, burst, 3*per_block);
+  BOOST_REQUIRE_EQUAL(inter.size(), original.size());
+  BOOST_CHECK(inter == original);
+}
+
+/** Decode `nblocks` blocks sent with `per_block` packets each, where
+ *  every `stride`-th packet is delayed by `delay` positions. Return
+ *  the decoded packets.
+ */
+vector<packet> reordered_run(const vector<packet> &original, size_t K,
+			     size_t per_block, size_t stride, size_t delay,
+			     size_t window) {
+  lt_encoder<std::mt19937> enc(K, 0.1, 0.5);
+  lt_decoder dec(K, 0.1, 0.5);
+  dec.reorder_window(window);
+  BOOST_CHECK_EQUAL(dec.reorder_window(), window);
+
+  for (const packet &p : original) enc.push(p);
+  vector<fountain_packet> sent;
+  while (enc.has_block()) {
+    sent.push_back(enc.next_coded());
+    if (enc.coded_count() == per_block) enc.next_block();
+  }
+  for (size_t i = 0; i + delay < sent.size(); i += stride) {
+    rotate(sent.begin() + i, sent.begin() + i + 1,
+	   sent.begin() + i + delay + 1);
+  }
+  for (fountain_packet &p : sent) dec.push(move(p));
+  dec.flush(enc.blockno());
+
+  vector<packet> out;
+  while (dec) out.push_back(dec.next_decoded());
+  return out;
+}
+
+BOOST_AUTO_TEST_CASE(reorder_window_decodes_late_packets) {
+  const size_t L = 10;
+  const size_t K = 100;
+  const size_t nblocks = 10;
+  const size_t per_block = 13*K/10;
+
+  vector<packet> original;
+  for (size_t i = 0; i < nblocks*K; ++i) original.push_back(random_pkt(L));
+
+  auto failed = [](const vector<packet> &v) {
+    return count_if(v.cbegin(), v.cend(), [](const packet &p){ return !p; });
+  };
+
+  // The blocks receive the same packets as without the reordering
+  vector<packet> in_order = reordered_run(original, K, per_block,
+					  per_block*nblocks, 0, 0);
+  vector<packet> reord = reordered_run(original, K, per_block, 4, K/2, 1);
+  BOOST_REQUIRE_EQUAL(in_order.size(), original.size());
+  BOOST_REQUIRE_EQUAL(reord.size(), original.size());
+  BOOST_CHECK(reord == in_order);
+
+  // Without the window the late packets are lost
+  vector<packet> plain = reordered_run(original, K, per_block, 4, K/2, 0);
+  BOOST_REQUIRE_EQUAL(plain.size(), original.size());
+  BOOST_CHECK_GT(failed(plain), failed(reord));
+}
+
+BOOST_AUTO_TEST_CASE(reorder_window_releases_in_order) {
+  encdec_setup s(10, 50, 0.1, 0.5);
+  s.gen_pkts(2*s.K);
+  lt_decoder dec(s.rowgen);
+  dec.reorder_window(2);
+  BOOST_CHECK_EQUAL(dec.interleave_depth(), 1);
+  for (const packet &p : s.original) s.enc.push(p);
+
+  vector<vector<fountain_packet>> blocks(3);
+  for (auto &b : blocks) {
+    for (size_t i = 0; i < 2*s.K; ++i) b.push_back(s.enc.next_coded());
+    s.enc.next_block();
+  }
+
+  // Block 1 is decoded first but it waits for block 0
+  for (const fountain_packet &p : blocks[1]) dec.push(p);
+  BOOST_CHECK_EQUAL(dec.blockno(), 0);
+  BOOST_CHECK_EQUAL(dec.queue_size(), 0);
+  BOOST_CHECK_THROW(dec.interleave_depth(2), std::logic_error);
+  BOOST_CHECK_THROW(dec.reorder_window(1), std::logic_error);
+
+  // Both are released once block 0 is decoded
+  for (const fountain_packet &p : blocks[0]) dec.push(p);
+  BOOST_CHECK_EQUAL(dec.queue_size(), 2*s.K);
+  BOOST_CHECK_EQUAL(dec.blockno(), 1);
+  BOOST_CHECK(dec.has_decoded());
+
+  for (const fountain_packet &p : blocks[2]) dec.push(p);
+  BOOST_CHECK_EQUAL(dec.queue_size(), 3*s.K);
+  BOOST_CHECK_EQUAL(dec.blockno(), 2);
+
+  vector<packet> out;
+  while (dec) out.push_back(dec.next_decoded());
+  BOOST_CHECK(out == s.original);
+}
+
+BOOST_AUTO_TEST_CASE(reorder_window_keeps_settings) {
+  encdec_setup s(10, 50, 0.1, 0.5);
+  s.gen_pkts(3*s.K);
+  lt_decoder dec(s.rowgen);
+  dec.enable_parallel_peeling(2);
+  dec.enable_xor_schedule(3);
+  dec.reorder_window(2);
+  for (const packet &p : s.original) s.enc.push(p);
+
+  // Reach a block decoded by a slot added by the window
+  for (size_t b = 0; b < 3; ++b) {
+    for (size_t i = 0; i < 2*s.K; ++i) dec.push(s.enc.next_coded());
+    s.enc.next_block();
+  }
+  BOOST_CHECK_EQUAL(dec.blockno(), 2);
+  BOOST_CHECK_EQUAL(dec.xor_schedule_threads(), 3);
+  BOOST_CHECK_EQUAL(dec.parallel_peeling_threads(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(elimination_lowers_overhead) {
+  const size_t nblocks = 30;
+  encdec_setup s(16, 100, 0.1, 0.5);
+  s.gen_pkts((nblocks-1)*s.K);
+  lt_decoder ml_dec(s.rowgen);
+  ml_dec.enable_elimination(s.K);
+  BOOST_CHECK_EQUAL(ml_dec.elimination_limit(), s.K);
+
+  for (const packet &p : s.original) s.enc.push(p);
+  size_t plain_ok = 0, ml_ok = 0;
+  for (size_t b = 0; s.enc.has_block(); ++b) {
+    // Small overhead: the peeling alone often stalls
+    for (size_t i = 0; i < s.K + s.K/10; ++i) {
+      fountain_packet p = s.enc.next_coded();
+      s.dec.push(p);
+      ml_dec.push(move(p));
+    }
+    if (s.dec.has_decoded()) ++plain_ok;
+    if (ml_dec.has_decoded()) {
+      ++ml_ok;
+      BOOST_CHECK(equal(ml_dec.decoded_begin(), ml_dec.decoded_end(),
+			s.original.cbegin() + b*s.K));
+    }
+    s.enc.next_block();
+  }
+
+  BOOST_CHECK_GT(ml_ok, plain_ok);
+  BOOST_CHECK_GE(ml_ok, nblocks*8/10);
+}
+
+BOOST_AUTO_TEST_CASE(throttled_decoding_attempts) {
+  const size_t nblocks = 20;
+  encdec_setup s(16, 200, 0.1, 0.5);
+  s.gen_pkts((nblocks-1)*s.K);
+  for (const packet &p : s.original) s.enc.push(p);
+
+  block_decoder plain(s.rowgen), throttled(s.rowgen);
+  throttled.enable_attempt_throttling(0.02);
+  BOOST_CHECK_EQUAL(throttled.attempt_step(), 0.02);
+
+  for (size_t b = 0; s.enc.has_block(); ++b) {
+    plain.reset();
+    throttled.reset();
+    const double first_attempt = s.K * (1 + throttled.overhead_estimate()) + 1;
+    size_t plain_recv = 0;
+    while (!throttled.has_decoded()) {
+      fountain_packet p = s.enc.next_coded();
+      if (!plain.has_decoded()) {
+	plain.push(p);
+	++plain_recv;
+      }
+      throttled.push(move(p));
+    }
+    // The throttled decoder waits for the first attempt, then it is
+    // late by one step at most
+    BOOST_CHECK(plain.has_decoded());
+    BOOST_CHECK_GE(throttled.received_count(), plain_recv);
+    BOOST_CHECK_LE(throttled.received_count(),
+		   max(first_attempt, plain_recv * 1.02 + 1));
+    BOOST_CHECK_GE(throttled.skipped_attempts(), s.K - 1);
+    BOOST_CHECK(equal(throttled.block_begin(), throttled.block_end(),
+		      s.original.cbegin() + b*s.K));
+    s.enc.next_block();
+  }
+  BOOST_CHECK_GT(throttled.overhead_estimate(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(throttled_partial_flush) {
+  encdec_setup s(16, 100, 0.1, 0.5);
+  for (const packet &p : s.original) s.enc.push(p);
+  lt_decoder throttled(s.rowgen);
+  throttled.enable_attempt_throttling(0.1);
+
+  // Too few packets to try a decoding: the flush must run it anyway
+  for (size_t i = 0; i < s.K - 1; ++i) {
+    fountain_packet p = s.enc.next_coded();
+    s.dec.push(p);
+    throttled.push(move(p));
+  }
+  BOOST_CHECK_EQUAL(throttled.decoded_count(), 0);
+  s.dec.flush();
+  throttled.flush();
+  BOOST_CHECK_EQUAL(throttled.total_decoded_count(), s.dec.total_decoded_count());
+  BOOST_CHECK_GT(throttled.total_decoded_count(), 0);
+  while (s.dec) {
+    BOOST_REQUIRE(throttled);
+    BOOST_CHECK(throttled.next_decoded().buffer() ==
+		s.dec.next_decoded().buffer());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(block_sink_matches_queue) {
+  // Odd packet size to cover the unaligned packets in the block buffer
+  encdec_setup s(13, 100, 0.1, 0.5);
+  s.gen_pkts(3*s.K);
+  for (const packet &p : s.original) s.enc.push(p);
+
+  lt_decoder sunk(s.rowgen);
+  vector<size_t> blocknos;
+  vector<packet> sunk_pkts;
+  sunk.set_block_sink([&](size_t bn, const block_buffer &b) {
+      BOOST_CHECK_EQUAL(b.block_size(), s.K);
+      blocknos.push_back(bn);
+      for (size_t i = 0; i < b.block_size(); ++i) {
+	packet p;
+	if (b.has_packet(i)) {
+	  auto sp = b.packet_span(i);
+	  p.buffer().assign(sp.begin(), sp.end());
+	}
+	sunk_pkts.push_back(move(p));
+      }
+    });
+
+  // Partial, full, missing and partial blocks
+  const size_t sent[] = {s.K - 10, 2*s.K, 0, s.K + s.K/2};
+  for (size_t n : sent) {
+    for (size_t i = 0; i < n; ++i) {
+      fountain_packet p = s.enc.next_coded();
+      s.dec.push(p);
+      sunk.push(move(p));
+    }
+    s.enc.next_block();
+  }
+  s.dec.flush();
+  sunk.flush();
+
+  BOOST_CHECK(!sunk);
+  BOOST_CHECK(blocknos == vector<size_t>({0, 1, 2, 3}));
+  BOOST_CHECK_EQUAL(sunk.total_decoded_count(), s.dec.total_decoded_count());
+  BOOST_CHECK_EQUAL(sunk.total_failed_count(), s.dec.total_failed_count());
+  BOOST_REQUIRE_EQUAL(sunk_pkts.size(), 4*s.K);
+  for (size_t i = 0; i < sunk_pkts.size(); ++i) {
+    BOOST_REQUIRE(s.dec);
+    BOOST_CHECK(sunk_pkts[i].buffer() == s.dec.next_decoded().buffer());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(success_probability_estimate) {
+  encdec_setup s(8, 100, 0.1, 0.5);
+  s.gen_pkts(9*s.K);
+  for (const packet &p : s.original) s.enc.push(p);
+
+  // Before any decoded block only the residual graph is used
+  s.dec.push(s.enc.next_coded());
+  BOOST_CHECK_EQUAL(s.dec.success_probability(0), 0);
+  BOOST_CHECK_EQUAL(s.dec.success_probability(s.K - 1), 1);
+  BOOST_CHECK_EQUAL(s.dec.needed_estimate(), s.K - 1);
+
+  // Learn from 9 blocks
+  for (size_t b = 0; b < 9; ++b) {
+    while (!s.dec.has_decoded()) s.dec.push(s.enc.next_coded());
+    s.enc.next_block();
+  }
+
+  for (size_t i = 0; i < s.K/2; ++i) s.dec.push(s.enc.next_coded());
+  BOOST_REQUIRE_EQUAL(s.dec.blockno(), 9);
+  BOOST_CHECK_EQUAL(s.dec.success_probability(0), 0);
+  size_t needed = s.dec.needed_estimate();
+  BOOST_CHECK_GE(needed, s.K/2);
+  BOOST_CHECK_GE(s.dec.success_probability(needed), 0.5);
+  BOOST_CHECK_LT(s.dec.success_probability(needed - 1), 0.5);
+  BOOST_CHECK_EQUAL(s.dec.success_probability(3*s.K), 1);
+  double last = 0;
+  for (size_t extra = 0; extra < 2*s.K; extra += 5) {
+    double p = s.dec.success_probability(extra);
+    BOOST_CHECK_GE(p, last);
+    last = p;
+  }
+
+  while (!s.dec.has_decoded()) s.dec.push(s.enc.next_coded());
+  BOOST_CHECK_EQUAL(s.dec.success_probability(0), 1);
+  BOOST_CHECK_EQUAL(s.dec.needed_estimate(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(needed_estimate_unsorted_history) {
+  const size_t nblocks = 12;
+  encdec_setup s(8, 100, 0.1, 0.5);
+  s.gen_pkts((nblocks+1)*s.K);
+  for (const packet &p : s.original) s.enc.push(p);
+
+  // Mix decoded blocks with blocks cut short after K packets, in no
+  // particular order of need
+  const size_t cut[] = {0, s.K, 0, 0, s.K + 2, s.K, 0, s.K + 5, 0, s.K, 0, 0};
+  for (size_t b = 0; b < nblocks; ++b) {
+    size_t n = 0;
+    while (!s.dec.has_decoded() && (cut[b] == 0 || n < cut[b])) {
+      s.dec.push(s.enc.next_coded());
+      ++n;
+    }
+    s.enc.next_block();
+  }
+
+  for (size_t i = 0; i < s.K/2; ++i) s.dec.push(s.enc.next_coded());
+  BOOST_REQUIRE_EQUAL(s.dec.blockno(), nblocks);
+  // The estimate is the first value that reaches one half
+  size_t needed = s.dec.needed_estimate();
+  BOOST_CHECK_GE(s.dec.success_probability(needed), 0.5);
+  for (size_t extra = 0; extra < needed; ++extra) {
+    BOOST_CHECK_LT(s.dec.success_probability(extra), 0.5);
+  }
+}
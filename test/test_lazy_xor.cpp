@@ -49,18 +49,42 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(lazy_xor_basic, Sym, symbol_types) {
   lazy_xor<Sym,10> lx1(&x1);
   lazy_xor<Sym,10> lx2(&x2);
   lazy_xor<Sym,10> lx3 = lx1 ^ lx2;
+  lazy_xor<Sym,10> empty;
+  BOOST_CHECK_EQUAL(lx1.size(), 1);
+  BOOST_CHECK_EQUAL(lx2.size(), 1);
+  BOOST_CHECK_EQUAL(lx3.size(), 2);
+  BOOST_CHECK_EQUAL(empty.size(), 0);
+
   BOOST_CHECK(lx1.evaluate() == x1);
   BOOST_CHECK(lx2.evaluate() == x2);
   BOOST_CHECK(lx3.evaluate() == x3);
-  lazy_xor<Sym,10> empty;
   BOOST_CHECK_THROW(empty.evaluate(), runtime_error);
 
-  BOOST_CHECK_EQUAL(lx1.size(), 1);
-  BOOST_CHECK_EQUAL(lx2.size(), 1);
-  BOOST_CHECK_EQUAL(lx3.size(), 2);
+  // The evaluation replaces the list with its result
+  BOOST_CHECK_EQUAL(lx3.size(), 1);
   BOOST_CHECK_EQUAL(empty.size(), 0);
 }
 
+BOOST_AUTO_TEST_CASE_TEMPLATE(lazy_xor_memoized, Sym, symbol_types) {
+  const Sym x1 = symbol_traits<Sym>::build(0x11);
+  const Sym x2 = symbol_traits<Sym>::build(0x22);
+  const Sym x3 = symbol_traits<Sym>::build(0x33);
+  lazy_xor<Sym,10> lx1(&x1);
+  BOOST_CHECK_EQUAL(&lx1.evaluate(), &x1);
+
+  lx1.xor_with(&x2);
+  const Sym &e = lx1.evaluate();
+  BOOST_CHECK(e == x3);
+  BOOST_CHECK_EQUAL(&lx1.evaluate(), &e);
+
+  // The copies own their result
+  lazy_xor<Sym,10> copy(lx1);
+  BOOST_CHECK(copy.evaluate() == e);
+  copy.xor_with(&x3);
+  BOOST_CHECK(copy.evaluate() == Sym(x1 ^ x1));
+  BOOST_CHECK(lx1.evaluate() == x3);
+}
+
 BOOST_AUTO_TEST_CASE_TEMPLATE(lazy_xor_shorthand, Sym, symbol_types) {
   const Sym x1 = symbol_traits<Sym>::build(0x11);
   const Sym x2 = symbol_traits<Sym>::build(0x22);
@@ -116,3 +140,21 @@ BOOST_AUTO_TEST_CASE(lazy_xor_pktsize) {
   BOOST_CHECK_THROW(flz1.evaluate(), runtime_error);
   BOOST_CHECK_NO_THROW(flz2.evaluate());
 }
+
+BOOST_AUTO_TEST_CASE(lazy_xor_evaluate_into) {
+  const buffer_type b1(13, 0x11), b2(13, 0x22), b3(13, 0x44);
+  lazy_xor<buffer_type,10> lx(&b1);
+  lx ^= lazy_xor<buffer_type,10>(&b2);
+  lx ^= lazy_xor<buffer_type,10>(b3);
+
+  // Write at an unaligned position
+  buffer_type out(15, 0x7f);
+  lx.evaluate_into(out.data() + 1);
+  BOOST_CHECK_EQUAL(out.front(), 0x7f);
+  BOOST_CHECK_EQUAL(out.back(), 0x7f);
+  BOOST_CHECK(buffer_type(out.begin() + 1, out.end() - 1) == lx.evaluate());
+  BOOST_CHECK(lx.evaluate() == buffer_type(13, 0x77));
+
+  lazy_xor<buffer_type,10> empty;
+  BOOST_CHECK_THROW(empty.evaluate_into(out.data()), runtime_error);
+}
@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <forward_list>
+#include <random>
 
 #include <boost/mpl/vector.hpp>
 #include <boost/optional.hpp>
@@ -11,6 +12,7 @@
 #include "log.hpp"
 #include "message_passing.hpp"
 #include "packets.hpp"
+#include "presence_context.hpp"
 
 using namespace std;
 using namespace uep;
@@ -577,3 +579,356 @@ BOOST_AUTO_TEST_CASE(triple_edges_xor_once) {
   BOOST_CHECK_EQUAL(*(mp.decoded_symbols_begin()), 0x33);
   BOOST_CHECK_EQUAL(*(++mp.decoded_symbols_begin()), 0x13);
 }
+
+BOOST_AUTO_TEST_CASE(packet_symbols) {
+  mp_context<packet> mp(2);
+  vector<size_t> edges{0, 1};
+  mp.add_output(packet(4, 0x11 ^ 0x22), edges.cbegin(), edges.cend());
+  edges = {0};
+  mp.add_output(packet(4, 0x11), edges.cbegin(), edges.cend());
+  mp.run();
+
+  BOOST_CHECK(mp.has_decoded());
+  vector<packet> expected{packet(4, 0x11), packet(4, 0x22)};
+  BOOST_CHECK(equal(mp.input_symbols_begin(), mp.input_symbols_end(),
+		    expected.cbegin()));
+}
+
+BOOST_AUTO_TEST_CASE(random_graph_after_reset) {
+  const size_t K = 500;
+  std::mt19937 gen(12);
+  std::uniform_int_distribution<size_t> pick(0, K-1);
+  std::uniform_int_distribution<size_t> degree(1, 6);
+  std::uniform_int_distribution<int> val(0, 255);
+
+  mp_context<char> mp(K);
+  for (int round = 0; round < 3; ++round) {
+    vector<char> truth(K);
+    for (char &c : truth) c = static_cast<char>(val(gen));
+    // Make sure the all-zero symbols are not confused with empty ones
+    for (char &c : truth) if (c == 0) c = 1;
+
+    mp.reset();
+    // Add the degree one symbols last to exercise the ripple
+    for (size_t i = 0; i < 2*K; ++i) {
+      vector<size_t> row(degree(gen) + 1);
+      for (size_t &e : row) e = pick(gen);
+      char sym = 0;
+      for (size_t e : row) sym ^= truth[e];
+      mp.add_output(sym, row.cbegin(), row.cend());
+    }
+    for (size_t i = 0; i < K; i += 2) {
+      vector<size_t> row{i};
+      mp.add_output(truth[i], row.cbegin(), row.cend());
+    }
+    mp.run();
+
+    BOOST_CHECK_EQUAL(mp.output_size(), 2*K + K/2);
+    BOOST_CHECK_GE(mp.decoded_count(), K/2);
+    size_t pos = 0;
+    for (auto i = mp.input_symbols_begin(); i != mp.input_symbols_end();
+	 ++i, ++pos) {
+      if (*i) BOOST_CHECK_EQUAL(*i, truth[pos]);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(elimination_when_stalled) {
+  // No output has degree one: the peeling cannot start
+  mp_context<char> mp(3);
+  std::vector<size_t> edges{0, 1};
+  mp.add_output(0x11 ^ 0x22, edges.begin(), edges.end());
+  edges = {1, 2};
+  mp.add_output(0x22 ^ 0x44, edges.begin(), edges.end());
+  edges = {0, 1, 2};
+  mp.add_output(0x11 ^ 0x22 ^ 0x44, edges.begin(), edges.end());
+
+  mp_context<char> plain(mp);
+  plain.run();
+  BOOST_CHECK_EQUAL(plain.decoded_count(), 0);
+
+  mp.enable_elimination(3);
+  mp.run();
+  BOOST_CHECK(mp.has_decoded());
+  BOOST_CHECK_EQUAL(mp.eliminated_count(), 3);
+  vector<char> expected{0x11, 0x22, 0x44};
+  BOOST_CHECK(equal(mp.input_symbols_begin(), mp.input_symbols_end(),
+		    expected.cbegin()));
+}
+
+BOOST_AUTO_TEST_CASE(elimination_partial_rank) {
+  mp_context<char> mp(3);
+  mp.enable_elimination(3);
+  std::vector<size_t> edges{0, 1};
+  mp.add_output(0x11 ^ 0x22, edges.begin(), edges.end());
+  edges = {0, 1, 2, 2, 2};
+  mp.add_output(0x11 ^ 0x22 ^ 0x44, edges.begin(), edges.end());
+  mp.run();
+  // Only the last input is determined
+  BOOST_CHECK_EQUAL(mp.decoded_count(), 1);
+  auto i = mp.input_symbols_begin();
+  BOOST_CHECK(!*i++);
+  BOOST_CHECK(!*i++);
+  BOOST_CHECK_EQUAL(*i, 0x44);
+
+  // The peeling resumes with the new outputs
+  edges = {0};
+  mp.add_output(0x11, edges.begin(), edges.end());
+  mp.run();
+  BOOST_CHECK(mp.has_decoded());
+  vector<char> expected{0x11, 0x22, 0x44};
+  BOOST_CHECK(equal(mp.input_symbols_begin(), mp.input_symbols_end(),
+		    expected.cbegin()));
+}
+
+BOOST_AUTO_TEST_CASE(elimination_needs_copies) {
+  mp_context<my_opt_char> mp(3);
+  BOOST_CHECK_THROW(mp.enable_elimination(3), std::logic_error);
+  mp_context<copy_opt_char> cp(3);
+  cp.enable_elimination(3);
+  BOOST_CHECK_EQUAL(cp.elimination_limit(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(xor_schedule_matches_immediate) {
+  const size_t K = 2000;
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<size_t> pick(0, K-1);
+  std::uniform_int_distribution<size_t> degree(1, 4);
+  std::uniform_int_distribution<int> val(1, 255);
+
+  vector<char> truth(K);
+  for (char &c : truth) c = static_cast<char>(val(gen));
+
+  mp_context<char> immediate(K), single(K), threaded(K);
+  single.enable_xor_schedule(1);
+  threaded.enable_xor_schedule(4);
+  BOOST_CHECK_EQUAL(threaded.xor_schedule_threads(), 4);
+
+  // Decode incrementally, so that the outputs left in the graph must
+  // be updated by the schedule too
+  for (int round = 0; round < 4; ++round) {
+    for (size_t i = 0; i < K/2; ++i) {
+      vector<size_t> row(i % 4 == 0 ? 1 : degree(gen));
+      for (size_t &e : row) e = pick(gen);
+      char sym = 0;
+      for (size_t e : row) sym ^= truth[e];
+      immediate.add_output(sym, row.cbegin(), row.cend());
+      single.add_output(sym, row.cbegin(), row.cend());
+      threaded.add_output(sym, row.cbegin(), row.cend());
+    }
+    immediate.run();
+    single.run();
+    threaded.run();
+
+    BOOST_CHECK_EQUAL(single.decoded_count(), immediate.decoded_count());
+    BOOST_CHECK_EQUAL(threaded.decoded_count(), immediate.decoded_count());
+    BOOST_CHECK(equal(single.input_symbols_begin(), single.input_symbols_end(),
+		      immediate.input_symbols_begin()));
+    BOOST_CHECK(equal(threaded.input_symbols_begin(),
+		      threaded.input_symbols_end(),
+		      immediate.input_symbols_begin()));
+  }
+  BOOST_CHECK_GT(immediate.decoded_count(), K/2);
+  size_t pos = 0;
+  for (auto i = threaded.input_symbols_begin();
+       i != threaded.input_symbols_end(); ++i, ++pos) {
+    if (*i) BOOST_CHECK_EQUAL(*i, truth[pos]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(xor_schedule_with_elimination) {
+  mp_context<char> mp(4);
+  mp.enable_xor_schedule(1);
+  mp.enable_elimination(4);
+  std::vector<size_t> edges{0, 1};
+  mp.add_output(0x11 ^ 0x22, edges.begin(), edges.end());
+  edges = {1, 2};
+  mp.add_output(0x22 ^ 0x44, edges.begin(), edges.end());
+  edges = {0, 1, 2};
+  mp.add_output(0x11 ^ 0x22 ^ 0x44, edges.begin(), edges.end());
+  edges = {2, 3};
+  mp.add_output(0x44 ^ 0x08, edges.begin(), edges.end());
+  mp.run();
+
+  BOOST_CHECK(mp.has_decoded());
+  BOOST_CHECK_EQUAL(mp.eliminated_count(), 4);
+  vector<char> expected{0x11, 0x22, 0x44, 0x08};
+  BOOST_CHECK(equal(mp.input_symbols_begin(), mp.input_symbols_end(),
+		    expected.cbegin()));
+}
+
+BOOST_AUTO_TEST_CASE(parallel_peeling_matches_sequential) {
+  const size_t K = 20000;
+  std::mt19937 gen(3);
+  std::uniform_int_distribution<size_t> pick(0, K-1);
+  std::uniform_int_distribution<size_t> degree(2, 5);
+  std::uniform_int_distribution<int> val(1, 255);
+
+  vector<char> truth(K);
+  for (char &c : truth) c = static_cast<char>(val(gen));
+
+  mp_context<char> sequential(K), parallel(K);
+  parallel.enable_parallel_peeling(4, K);
+  BOOST_CHECK_EQUAL(parallel.parallel_peeling_threads(), 4);
+  BOOST_CHECK_EQUAL(parallel.xor_schedule_threads(), 4);
+
+  for (int round = 0; round < 3; ++round) {
+    for (size_t i = 0; i < K/2; ++i) {
+      // Many degree one outputs give wide wavefronts
+      vector<size_t> row(i % 3 == 0 ? 1 : degree(gen));
+      for (size_t &e : row) e = pick(gen);
+      char sym = 0;
+      for (size_t e : row) sym ^= truth[e];
+      sequential.add_output(sym, row.cbegin(), row.cend());
+      parallel.add_output(sym, row.cbegin(), row.cend());
+    }
+    sequential.run();
+    parallel.run();
+
+    BOOST_CHECK_EQUAL(parallel.decoded_count(), sequential.decoded_count());
+    BOOST_CHECK(equal(parallel.input_symbols_begin(),
+		      parallel.input_symbols_end(),
+		      sequential.input_symbols_begin()));
+  }
+  BOOST_CHECK_GT(sequential.decoded_count(), K/2);
+  size_t pos = 0;
+  for (auto i = parallel.input_symbols_begin();
+       i != parallel.input_symbols_end(); ++i, ++pos) {
+    if (*i) BOOST_CHECK_EQUAL(*i, truth[pos]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(decoded_callback_once_per_input) {
+  const size_t K = 1000;
+  std::mt19937 gen(5);
+  std::uniform_int_distribution<size_t> pick(0, K-1);
+  std::uniform_int_distribution<size_t> degree(1, 4);
+  std::uniform_int_distribution<int> val(1, 255);
+
+  vector<char> truth(K);
+  for (char &c : truth) c = static_cast<char>(val(gen));
+
+  mp_context<char> immediate(K), scheduled(K);
+  scheduled.enable_xor_schedule(1);
+  scheduled.enable_elimination(K);
+  vector<int> imm_calls(K, 0), sched_calls(K, 0);
+  immediate.set_decoded_callback([&](size_t i, const char &c) {
+      BOOST_CHECK_EQUAL(c, truth[i]);
+      ++imm_calls[i];
+    });
+  scheduled.set_decoded_callback([&](size_t i, const char &c) {
+      BOOST_CHECK_EQUAL(c, truth[i]);
+      ++sched_calls[i];
+    });
+
+  for (int round = 0; round < 3; ++round) {
+    for (size_t i = 0; i < K/2; ++i) {
+      vector<size_t> row(degree(gen));
+      for (size_t &e : row) e = pick(gen);
+      char sym = 0;
+      for (size_t e : row) sym ^= truth[e];
+      immediate.add_output(sym, row.cbegin(), row.cend());
+      scheduled.add_output(sym, row.cbegin(), row.cend());
+    }
+    immediate.run();
+    scheduled.run();
+
+    size_t pos = 0;
+    for (auto i = immediate.input_symbols_begin();
+	 i != immediate.input_symbols_end(); ++i, ++pos) {
+      BOOST_CHECK_EQUAL(imm_calls[pos], *i ? 1 : 0);
+    }
+    pos = 0;
+    for (auto i = scheduled.input_symbols_begin();
+	 i != scheduled.input_symbols_end(); ++i, ++pos) {
+      BOOST_CHECK_EQUAL(sched_calls[pos], *i ? 1 : 0);
+    }
+  }
+  BOOST_CHECK_GT(scheduled.eliminated_count(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(presence_context_matches_mp_context) {
+  const size_t K = 1000;
+  std::mt19937 gen(9);
+  std::uniform_int_distribution<size_t> pick(0, K-1);
+  std::uniform_int_distribution<size_t> degree(1, 5);
+  std::uniform_int_distribution<int> val(1, 255);
+
+  vector<char> truth(K);
+  for (char &c : truth) c = static_cast<char>(val(gen));
+
+  mp::presence_context pc(K);
+  mp_context<char> mp(K);
+  for (int block = 0; block < 3; ++block) {
+    pc.reset();
+    mp.reset();
+    for (int round = 0; round < 3; ++round) {
+      for (size_t i = 0; i < K/2; ++i) {
+	// The rows can contain parallel edges
+	vector<size_t> row(degree(gen));
+	for (size_t &e : row) e = pick(gen);
+	char sym = 0;
+	for (size_t e : row) sym ^= truth[e];
+	pc.add_output(row.cbegin(), row.cend());
+	mp.add_output(sym, row.cbegin(), row.cend());
+      }
+      pc.run();
+      mp.run();
+
+      BOOST_CHECK_EQUAL(pc.output_size(), mp.output_size());
+      BOOST_CHECK_EQUAL(pc.decoded_count(), mp.decoded_count());
+      BOOST_CHECK_EQUAL(pc.has_decoded(), mp.has_decoded());
+      size_t pos = 0;
+      for (auto i = mp.input_symbols_begin(); i != mp.input_symbols_end();
+	   ++i, ++pos) {
+	BOOST_CHECK_EQUAL(pc.is_decoded(pos), static_cast<bool>(*i));
+      }
+    }
+    BOOST_CHECK_GT(pc.decoded_count(), K/2);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ripple_order_with_budget) {
+  const vector<char> truth{0x01, 0x02, 0x04, 0x08, 0x10, 0x20};
+  auto build = [&truth]() {
+    mp_context<char> mp(truth.size());
+    // Degree one outputs from the last input to the first
+    for (size_t i = truth.size(); i-- > 0;) {
+      auto edges = {i};
+      mp.add_output(truth[i], edges.begin(), edges.end());
+    }
+    mp.set_decode_budget(3);
+    return mp;
+  };
+  auto decoded = [](const mp_context<char> &mp) {
+    vector<bool> d;
+    for (auto i = mp.input_symbols_begin(); i != mp.input_symbols_end(); ++i) {
+      d.push_back(static_cast<bool>(*i));
+    }
+    return d;
+  };
+
+  mp_context<char> fifo = build();
+  fifo.run();
+  BOOST_CHECK(decoded(fifo) == vector<bool>({0, 0, 0, 1, 1, 1}));
+  BOOST_CHECK_EQUAL(fifo.ripple_size(), 3);
+
+  mp_context<char> lowest = build();
+  lowest.set_ripple_order(mp::ripple_order::lowest_index);
+  lowest.run();
+  BOOST_CHECK(decoded(lowest) == vector<bool>({1, 1, 1, 0, 0, 0}));
+
+  mp_context<char> prio = build();
+  prio.set_ripple_order(mp::ripple_order::priority, {2, 0, 1, 2, 0, 1});
+  prio.run();
+  BOOST_CHECK(decoded(prio) == vector<bool>({0, 1, 0, 0, 1, 1}));
+
+  // The next run resumes from the remaining ripple
+  prio.run();
+  BOOST_CHECK(prio.has_decoded());
+  BOOST_CHECK(equal(prio.input_symbols_begin(), prio.input_symbols_end(),
+		    truth.cbegin()));
+
+  BOOST_CHECK_THROW(prio.set_ripple_order(mp::ripple_order::priority, {0}),
+		    std::invalid_argument);
+}
@@ -129,6 +129,36 @@ BOOST_AUTO_TEST_CASE(nal_read) {
   BOOST_CHECK_GE(npkts, ceil(static_cast<double>(r.totLength()) / ps.packet_size));
 }
 
+BOOST_AUTO_TEST_CASE(nal_save_restore) {
+  nal_reader::parameter_set ps;
+  ps.streamName = "CREW_352x288_30_orig_01";
+  ps.packet_size = 512;
+  nal_reader r(ps);
+
+  for (size_t i = 0; i < 20; ++i) {
+    r.next_packet();
+  }
+  nal_reader_state st = r.save_state();
+
+  vector<fountain_packet> expected;
+  while (r) {
+    expected.push_back(r.next_packet());
+  }
+
+  nal_reader r2(ps);
+  r2.restore_state(st);
+  vector<fountain_packet> resumed;
+  while (r2) {
+    resumed.push_back(r2.next_packet());
+  }
+
+  BOOST_REQUIRE_EQUAL(resumed.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    BOOST_CHECK_EQUAL(resumed[i].getPriority(), expected[i].getPriority());
+    BOOST_CHECK(resumed[i].buffer() == expected[i].buffer());
+  }
+}
+
 BOOST_AUTO_TEST_CASE(nal_read_write) {
   nal_reader::parameter_set ps;
   ps.streamName = "CREW_352x288_30_orig_01";
@@ -176,3 +206,41 @@ BOOST_AUTO_TEST_CASE(nal_eos) {
   BOOST_CHECK(compare_streams("dataset/CREW_352x288_30_orig_01.264",
 			      "dataset_client/CREW_352x288_30_orig_01.264"));
 }
+
+BOOST_AUTO_TEST_CASE(nal_write_block) {
+  // Three NALs split in packets of 10 bytes
+  buffer_type stream;
+  const std::size_t nal_sizes[] = {20, 33, 27};
+  for (std::size_t s : nal_sizes) {
+    const char sc[4] = {0x00, 0x00, 0x00, 0x01};
+    stream.insert(stream.end(), sc, sc + 4);
+    stream.insert(stream.end(), s - 4, 0x41);
+  }
+  const std::size_t P = 10;
+  const std::size_t K = stream.size() / P;
+  BOOST_REQUIRE_EQUAL(stream.size(), K*P);
+
+  block_buffer b;
+  b.assign(K, P);
+  std::copy(stream.begin(), stream.end(), b.packet_data(0));
+  for (std::size_t i = 0; i < K; ++i) {
+    if (i != 3) b.set_present(i); // One missing packet
+  }
+  BOOST_CHECK_EQUAL(b.present_count(), K - 1);
+  BOOST_CHECK_EQUAL(b.size(), stream.size());
+
+  ostringstream by_pkt, by_block;
+  {
+    nal_writer w(by_pkt);
+    for (std::size_t i = 0; i < K; ++i) {
+      if (i == 3) continue;
+      fountain_packet fp;
+      fp.buffer().assign(b.packet_data(i), b.packet_data(i) + P);
+      w.push(fp);
+    }
+    nal_writer wb(by_block);
+    wb.push(b);
+  }
+  BOOST_CHECK(!by_block.str().empty());
+  BOOST_CHECK(by_block.str() == by_pkt.str());
+}
@@ -141,3 +141,24 @@ BOOST_AUTO_TEST_CASE(wrong_type) {
   BOOST_CHECK_THROW(parse_raw_data_packet(raw_data), runtime_error);
   BOOST_CHECK_THROW(parse_raw_ack_packet(raw_data), runtime_error);
 }
+
+BOOST_AUTO_TEST_CASE(need_more_read_write) {
+  std::vector<char> raw = build_raw_need_more(0x1234, 0x56);
+  BOOST_REQUIRE_EQUAL(raw.size(), need_more_size);
+  const char *expected_raw = "\x02\x12\x34\x00\x56";
+  BOOST_CHECK(std::equal(raw.cbegin(), raw.cend(), expected_raw));
+
+  auto hint = parse_raw_need_more_packet(raw);
+  BOOST_CHECK_EQUAL(hint.first, 0x1234);
+  BOOST_CHECK_EQUAL(hint.second, 0x56);
+
+  // The count saturates
+  hint = parse_raw_need_more_packet(build_raw_need_more(1, 0x12345));
+  BOOST_CHECK_EQUAL(hint.second, 0xffff);
+
+  std::vector<char> ack = build_raw_ack(1);
+  ack.resize(need_more_size);
+  BOOST_CHECK_THROW(parse_raw_need_more_packet(ack), runtime_error);
+  raw.resize(need_more_size - 1);
+  BOOST_CHECK_THROW(parse_raw_need_more_packet(raw), runtime_error);
+}
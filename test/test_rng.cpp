@@ -116,6 +116,38 @@ BOOST_AUTO_TEST_CASE(row_generation) {
 		    1);
 }
 
+BOOST_AUTO_TEST_CASE(uep_expanding_window_rows) {
+  std::vector<std::size_t> Ks{25, 75};
+  std::vector<double> WPs{0.5, 0.5};
+  uep::uep_row_generator rg(Ks.begin(), Ks.end(),
+			    WPs.begin(), WPs.end(),
+			    0.1, 0.5);
+  BOOST_CHECK(rg.expanding_windows());
+  BOOST_CHECK_EQUAL(rg.K_in(), 100);
+  BOOST_CHECK_EQUAL(rg.K_out(), 100);
+
+  const std::size_t N = 100000;
+  std::size_t mib_only = 0;
+  for (std::size_t i = 0; i < N; ++i) {
+    auto row = rg.next_row();
+    BOOST_REQUIRE(!row.empty());
+    BOOST_CHECK(std::is_sorted(row.begin(), row.end()));
+    BOOST_CHECK(std::adjacent_find(row.begin(), row.end()) == row.end());
+    BOOST_CHECK_LT(row.back(), 100);
+    if (row.back() < Ks[0]) ++mib_only;
+  }
+  // The MIB window is selected half of the times, the full window
+  // also produces some rows inside the MIB
+  BOOST_CHECK_GT(static_cast<double>(mib_only) / N, 0.5);
+  BOOST_CHECK_LT(static_cast<double>(mib_only) / N, 0.7);
+
+  std::vector<double> bad_WPs{0, 0};
+  BOOST_CHECK_THROW(uep::uep_row_generator(Ks.begin(), Ks.end(),
+					   bad_WPs.begin(), bad_WPs.end(),
+					   0.1, 0.5),
+		    std::invalid_argument);
+}
+
 BOOST_AUTO_TEST_CASE(markov2_iid_05) {
   markov2_distribution m2(0.5);
   f_uint zeros = 0;
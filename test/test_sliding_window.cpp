@@ -0,0 +1,121 @@
+#define BOOST_TEST_MODULE test_sliding_window
+#include <boost/test/unit_test.hpp>
+
+#include "sliding_decoder.hpp"
+#include "sliding_encoder.hpp"
+
+#include <climits>
+#include <random>
+
+using namespace std;
+using namespace uep;
+
+// Set globally the log severity level
+struct global_fixture {
+  global_fixture() {
+    uep::log::init();
+    auto warn_filter = boost::log::expressions::attr<
+      uep::log::severity_level>("Severity") >= uep::log::warning;
+    boost::log::core::get()->set_filter(warn_filter);
+  }
+
+  ~global_fixture() {
+  }
+};
+BOOST_GLOBAL_FIXTURE(global_fixture);
+
+packet random_pkt(int size) {
+  static std::independent_bits_engine<std::mt19937, CHAR_BIT, unsigned char> g;
+  packet p;
+  p.resize(size);
+  for (int i=0; i < size; i++) {
+    p[i] = g();
+  }
+  return p;
+}
+
+BOOST_AUTO_TEST_CASE(encoder_window) {
+  const size_t W = 20;
+  sliding_window_encoder<std::mt19937> enc(W, 0.1, 0.5);
+  BOOST_CHECK(!enc.has_block());
+  BOOST_CHECK_THROW(enc.next_coded(), std::runtime_error);
+
+  for (size_t i = 0; i < 3*W; ++i) {
+    enc.push(random_pkt(10));
+    BOOST_CHECK_EQUAL(enc.window_end(), i+1);
+    BOOST_CHECK_EQUAL(enc.size(), min(i+1, W));
+    fountain_packet fp = enc.next_coded();
+    BOOST_CHECK_EQUAL(fp.size(), 10);
+    BOOST_CHECK_EQUAL(fp.block_number(), i+1);
+  }
+  BOOST_CHECK_EQUAL(enc.window_start(), 2*W);
+  BOOST_CHECK_EQUAL(enc.total_coded_count(), 3*W);
+}
+
+BOOST_AUTO_TEST_CASE(in_order_release) {
+  const size_t W = 50;
+  const size_t N = 2000;
+  sliding_window_encoder<std::mt19937> enc(W, 0.1, 0.5);
+  sliding_window_decoder dec(W, 0.1, 0.5);
+
+  vector<packet> original;
+  vector<fountain_packet> received;
+  for (size_t i = 0; i < N; ++i) {
+    packet p = random_pkt(16);
+    original.push_back(p);
+    enc.push(p);
+    // Send 2 coded packets for each input packet
+    for (size_t j = 0; j < 2; ++j) {
+      dec.push(enc.next_coded());
+    }
+    while (dec.has_queued_packets()) {
+      received.push_back(dec.next_decoded());
+    }
+  }
+  dec.flush();
+  while (dec) {
+    received.push_back(dec.next_decoded());
+  }
+
+  BOOST_REQUIRE_EQUAL(received.size(), N);
+  for (size_t i = 0; i < N; ++i) {
+    if (received[i]) BOOST_CHECK(received[i] == original[i]);
+  }
+  BOOST_CHECK_EQUAL(dec.total_decoded_count() + dec.total_failed_count(), N);
+  BOOST_CHECK_GT(dec.total_decoded_count(), 0.95*N);
+  BOOST_CHECK_LE(dec.average_release_delay(), W);
+}
+
+BOOST_AUTO_TEST_CASE(lost_and_wrapped_windows) {
+  const size_t W = 10;
+  const size_t N = 70000; // Past MAX_BLOCKNO
+  sliding_window_encoder<std::mt19937> enc(W, 0.1, 0.5);
+  sliding_window_decoder dec(W, 0.1, 0.5);
+  std::mt19937 loss_gen;
+  std::bernoulli_distribution lost(0.1);
+
+  vector<packet> original;
+  size_t checked = 0;
+  bool all_correct = true;
+  for (size_t i = 0; i < N; ++i) {
+    packet p = random_pkt(4);
+    original.push_back(p);
+    enc.push(p);
+    for (size_t j = 0; j < 2; ++j) {
+      fountain_packet fp = enc.next_coded();
+      if (!lost(loss_gen)) dec.push(move(fp));
+    }
+    while (dec) {
+      fountain_packet d = dec.next_decoded();
+      if (d && !(d == original[checked])) all_correct = false;
+      ++checked;
+    }
+  }
+  dec.flush();
+  checked += dec.queue_size();
+
+  BOOST_CHECK(all_correct);
+  BOOST_CHECK_EQUAL(checked, N);
+  BOOST_CHECK_EQUAL(dec.release_position(), N);
+  BOOST_CHECK_GT(dec.total_decoded_count(), 0.9*N);
+}
@@ -0,0 +1,78 @@
+#define BOOST_TEST_MODULE test_spsc_ring
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+#include <thread>
+
+#include "spsc_ring.hpp"
+
+using namespace std;
+using namespace uep;
+
+BOOST_AUTO_TEST_CASE(push_pop_order) {
+  spsc_ring<int> r(3);
+  BOOST_CHECK(r.empty());
+  BOOST_CHECK_EQUAL(r.capacity(), 3);
+
+  for (int i = 0; i < 3; ++i) {
+    BOOST_CHECK(r.try_push(move(i)));
+  }
+  BOOST_CHECK(r.full());
+  int x = 42;
+  BOOST_CHECK(!r.try_push(move(x)));
+  BOOST_CHECK_EQUAL(r.size(), 3);
+
+  for (int i = 0; i < 3; ++i) {
+    int y;
+    BOOST_CHECK(r.try_pop(y));
+    BOOST_CHECK_EQUAL(y, i);
+  }
+  int y;
+  BOOST_CHECK(!r.try_pop(y));
+  BOOST_CHECK(r.empty());
+}
+
+BOOST_AUTO_TEST_CASE(wrap_around_and_clear) {
+  spsc_ring<unique_ptr<int>> r(4);
+  for (int i = 0; i < 10; ++i) {
+    BOOST_CHECK(r.try_push(make_unique<int>(i)));
+    BOOST_CHECK(r.try_push(make_unique<int>(-i)));
+    unique_ptr<int> p;
+    BOOST_CHECK(r.try_pop(p));
+    BOOST_CHECK_EQUAL(*p, i);
+    BOOST_CHECK(r.try_pop(p));
+    BOOST_CHECK_EQUAL(*p, -i);
+  }
+
+  r.try_push(make_unique<int>(1));
+  r.try_push(make_unique<int>(2));
+  BOOST_CHECK_EQUAL(r.clear(), 2);
+  BOOST_CHECK(r.empty());
+  BOOST_CHECK(r.try_push(make_unique<int>(3)));
+  unique_ptr<int> p;
+  BOOST_CHECK(r.try_pop(p));
+  BOOST_CHECK_EQUAL(*p, 3);
+}
+
+BOOST_AUTO_TEST_CASE(two_threads) {
+  const int N = 100000;
+  spsc_ring<int> r(16);
+
+  thread prod([&r]() {
+      for (int i = 0; i < N; ++i) {
+	int x = i;
+	while (!r.try_push(move(x))) this_thread::yield();
+      }
+    });
+
+  bool in_order = true;
+  for (int i = 0; i < N; ++i) {
+    int y;
+    while (!r.try_pop(y)) this_thread::yield();
+    if (y != i) in_order = false;
+  }
+  prod.join();
+
+  BOOST_CHECK(in_order);
+  BOOST_CHECK(r.empty());
+}
@@ -0,0 +1,151 @@
+#define BOOST_TEST_MODULE test_stream_cache
+#include <boost/test/unit_test.hpp>
+
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "stream_cache.hpp"
+
+#include <climits>
+#include <deque>
+#include <random>
+
+using namespace std;
+using namespace uep;
+
+// Set globally the log severity level
+struct global_fixture {
+  global_fixture() {
+    uep::log::init();
+    auto warn_filter = boost::log::expressions::attr<
+      uep::log::severity_level>("Severity") >= uep::log::warning;
+    boost::log::core::get()->set_filter(warn_filter);
+  }
+
+  ~global_fixture() {
+  }
+};
+BOOST_GLOBAL_FIXTURE(global_fixture);
+
+packet random_pkt(int size) {
+  static std::independent_bits_engine<std::mt19937, CHAR_BIT, unsigned char> g;
+  packet p;
+  p.resize(size);
+  for (int i=0; i < size; i++) {
+    p[i] = g();
+  }
+  return p;
+}
+
+/** Source that returns the packets of a vector. */
+struct vector_source {
+  explicit vector_source(const vector<packet> &v) : pkts(v.cbegin(), v.cend()) {}
+
+  packet next_packet() {
+    packet p = move(pkts.front());
+    pkts.pop_front();
+    return p;
+  }
+
+  explicit operator bool() const { return !pkts.empty(); }
+  bool operator!() const { return pkts.empty(); }
+
+  deque<packet> pkts;
+};
+
+typedef stream_cache<lt_encoder<std::mt19937>, vector_source> cache_type;
+typedef stream_session<lt_encoder<std::mt19937>, vector_source> session_type;
+
+shared_ptr<cache_type> make_cache(const vector<packet> &input, size_t K,
+				  size_t per_block, size_t max_blocks) {
+  auto enc = make_unique<lt_encoder<std::mt19937>>(K, 0.1, 0.5);
+  auto src = make_unique<vector_source>(input);
+  return make_shared<cache_type>(move(enc), move(src), per_block, max_blocks);
+}
+
+BOOST_AUTO_TEST_CASE(sessions_share_packets) {
+  const size_t K = 50;
+  const size_t per_block = 2*K;
+  vector<packet> input;
+  for (size_t i = 0; i < 3*K; ++i) input.push_back(random_pkt(10));
+  auto cache = make_cache(input, K, per_block, 4);
+  session_type s1(cache), s2(cache);
+
+  vector<fountain_packet> out1, out2;
+  while (s1) out1.push_back(s1.next_coded());
+  while (s2) out2.push_back(s2.next_coded());
+
+  BOOST_REQUIRE_EQUAL(out1.size(), 3*per_block);
+  BOOST_REQUIRE_EQUAL(out2.size(), out1.size());
+  for (size_t i = 0; i < out1.size(); ++i) {
+    BOOST_CHECK_EQUAL(out1[i].block_number(), out2[i].block_number());
+    BOOST_CHECK_EQUAL(out1[i].sequence_number(), out2[i].sequence_number());
+    BOOST_CHECK(out1[i] == out2[i]);
+  }
+  // Each packet was encoded once
+  BOOST_CHECK_EQUAL(cache->encoded_count(), out1.size());
+  BOOST_CHECK_EQUAL(s1.total_coded_count(), out1.size());
+}
+
+BOOST_AUTO_TEST_CASE(lagging_session_decodes) {
+  const size_t K = 100;
+  const size_t per_block = 2*K;
+  const size_t nblocks = 4;
+  vector<packet> input;
+  for (size_t i = 0; i < nblocks*K; ++i) input.push_back(random_pkt(10));
+  auto cache = make_cache(input, K, per_block, nblocks);
+  session_type leader(cache), lagging(cache);
+  lt_decoder dec_leader(K, 0.1, 0.5), dec_lagging(K, 0.1, 0.5);
+
+  // The leader acks each block as soon as it is decoded
+  while (leader) {
+    fountain_packet p = leader.next_coded();
+    size_t bn = p.block_number();
+    dec_leader.push(move(p));
+    if (dec_leader.has_decoded() && leader.blockno() == bn)
+      leader.next_block(bn + 1);
+  }
+  size_t leader_sent = leader.total_coded_count();
+  BOOST_CHECK_LT(leader_sent, nblocks*per_block);
+
+  // The lagging client receives all the cached packets
+  while (lagging) dec_lagging.push(lagging.next_coded());
+  BOOST_CHECK_EQUAL(lagging.total_coded_count(), nblocks*per_block);
+  BOOST_CHECK_EQUAL(cache->encoded_count(), nblocks*per_block);
+
+  dec_leader.flush();
+  dec_lagging.flush();
+  vector<packet> out_leader, out_lagging;
+  while (dec_leader) out_leader.push_back(dec_leader.next_decoded());
+  while (dec_lagging) out_lagging.push_back(dec_lagging.next_decoded());
+  BOOST_CHECK(out_leader == input);
+  BOOST_CHECK(out_lagging == input);
+}
+
+BOOST_AUTO_TEST_CASE(eviction) {
+  const size_t K = 20;
+  vector<packet> input;
+  for (size_t i = 0; i < 6*K; ++i) input.push_back(random_pkt(10));
+  auto cache = make_cache(input, K, K, 2);
+  session_type leader(cache), lagging(cache);
+  BOOST_CHECK(cache->can_join());
+
+  fountain_packet p = lagging.next_coded();
+  BOOST_CHECK_EQUAL(p.block_number(), 0);
+
+  for (size_t i = 0; i < 4; ++i) leader.next_block();
+  BOOST_CHECK_EQUAL(leader.next_coded().block_number(), 4);
+  BOOST_CHECK_EQUAL(cache->oldest_block(), 3);
+  BOOST_CHECK(!cache->can_join());
+
+  // The lagging session jumps to the oldest cached block
+  p = lagging.next_coded();
+  BOOST_CHECK_EQUAL(p.block_number(), 3);
+  BOOST_CHECK_EQUAL(lagging.blockno(), 3);
+
+  // Old ACKs are ignored
+  lagging.next_block(1);
+  BOOST_CHECK_EQUAL(lagging.blockno(), 3);
+  lagging.next_block(5);
+  BOOST_CHECK_EQUAL(lagging.next_coded().block_number(), 5);
+  BOOST_CHECK_EQUAL(cache->oldest_block(), 4);
+}
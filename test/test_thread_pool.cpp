@@ -0,0 +1,44 @@
+#define BOOST_TEST_MODULE test_thread_pool
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+using namespace std;
+using namespace uep;
+
+BOOST_AUTO_TEST_CASE(each_worker_runs_once) {
+  thread_pool pool(4);
+  BOOST_CHECK_EQUAL(pool.size(), 4);
+
+  for (int round = 0; round < 100; ++round) {
+    vector<int> calls(pool.size(), 0);
+    pool.run([&calls](size_t w) { ++calls[w]; });
+    for (int c : calls) BOOST_CHECK_EQUAL(c, 1);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(exceptions_are_rethrown) {
+  thread_pool pool(3);
+  atomic<int> done(0);
+  BOOST_CHECK_THROW(pool.run([&done](size_t w) {
+	if (w == 2) throw runtime_error("worker failed");
+	++done;
+      }), runtime_error);
+  BOOST_CHECK_EQUAL(done.load(), 2);
+
+  // The pool is still usable
+  pool.run([&done](size_t) { ++done; });
+  BOOST_CHECK_EQUAL(done.load(), 5);
+}
+
+BOOST_AUTO_TEST_CASE(single_thread) {
+  thread_pool pool(1);
+  int calls = 0;
+  pool.run([&calls](size_t w) { BOOST_CHECK_EQUAL(w, 0); ++calls; });
+  BOOST_CHECK_EQUAL(calls, 1);
+  BOOST_CHECK_THROW(thread_pool(0), invalid_argument);
+}
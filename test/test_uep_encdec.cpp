@@ -7,6 +7,7 @@
 #include <climits>
 #include <map>
 #include <fstream>
+#include <sstream>
 
 using namespace std;
 using namespace uep;
@@ -198,6 +199,242 @@ BOOST_AUTO_TEST_CASE(multiple_blocks) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(skip_blocks_correct_decoding) {
+  size_t L = 100;
+  size_t K_uep = 100;
+  lt_uep_parameter_set ps;
+  ps.Ks = {25, 75};
+  ps.RFs = {2, 1};
+  ps.EF = 2;
+  ps.c = 0.1;
+  ps.delta = 0.5;
+
+  size_t nblocks = 10;
+
+  uep_encoder<std::mt19937> enc(ps);
+  uep_decoder dec(ps);
+
+  vector<fountain_packet> original;
+  for (size_t i = 0; i < nblocks; ++i) {
+    for (size_t j = 0; j < ps.Ks[0]; ++j) {
+      fountain_packet p(random_pkt(L));
+      p.setPriority(0);
+      original.push_back(p);
+      enc.push(std::move(p));
+    }
+    for (size_t j = 0; j < ps.Ks[1]; ++j) {
+      fountain_packet p(random_pkt(L));
+      p.setPriority(1);
+      original.push_back(p);
+      enc.push(std::move(p));
+    }
+  }
+
+  // Jump from block 0 to block 7
+  enc.next_coded();
+  enc.next_block(7);
+  BOOST_CHECK_EQUAL(enc.blockno(), 7);
+  BOOST_CHECK_EQUAL(enc.coded_count(), 0);
+  BOOST_CHECK_EQUAL(enc.size(), 3*K_uep);
+  BOOST_CHECK_EQUAL(enc.total_coded_count(), 1);
+
+  // Old block numbers are ignored
+  enc.next_block(2);
+  BOOST_CHECK_EQUAL(enc.blockno(), 7);
+
+  do {
+    fountain_packet p = enc.next_coded();
+    BOOST_CHECK_EQUAL(p.block_number(), 7);
+    dec.push(std::move(p));
+  } while (!dec.has_decoded());
+
+  BOOST_CHECK_EQUAL(dec.queue_size(), 8*K_uep);
+  for (size_t i = 0; i < 7*K_uep; ++i) {
+    BOOST_CHECK(!dec.next_decoded());
+  }
+  for (size_t i = 7*K_uep; i < 8*K_uep; ++i) {
+    fountain_packet out = dec.next_decoded();
+    BOOST_CHECK(original[i].buffer() == out.buffer());
+    BOOST_CHECK_EQUAL(original[i].getPriority(), out.getPriority());
+  }
+
+  // Skip to the last block
+  enc.next_block(9);
+  BOOST_CHECK_EQUAL(enc.blockno(), 9);
+  BOOST_CHECK_EQUAL(enc.size(), K_uep);
+  enc.next_block();
+  BOOST_CHECK(!enc.has_block());
+}
+
+BOOST_AUTO_TEST_CASE(expanding_window_decoding) {
+  size_t L = 1500;
+  size_t K_uep = 100;
+  lt_uep_parameter_set ps;
+  ps.Ks = {25, 75};
+  ps.WPs = {0.3, 0.7};
+  ps.c = 0.1;
+  ps.delta = 0.5;
+
+  uep_encoder<std::mt19937> enc(ps);
+  uep_decoder dec(ps);
+  BOOST_CHECK(enc.row_generator().expanding_windows());
+  BOOST_CHECK_EQUAL(enc.block_size_out(), K_uep);
+  BOOST_CHECK_EQUAL(enc.block_size_in(), K_uep);
+
+  vector<fountain_packet> original;
+  for (size_t j = 0; j < ps.Ks[0]; ++j) {
+    fountain_packet p(random_pkt(L));
+    p.setPriority(0);
+    original.push_back(p);
+    enc.push(std::move(p));
+  }
+  for (size_t j = 0; j < ps.Ks[1]; ++j) {
+    fountain_packet p(random_pkt(L));
+    p.setPriority(1);
+    original.push_back(p);
+    enc.push(std::move(p));
+  }
+  BOOST_CHECK(enc.has_block());
+
+  while (!dec.has_decoded()) {
+    dec.push(enc.next_coded());
+  }
+
+  BOOST_CHECK_EQUAL(dec.queue_size(), K_uep);
+  for (auto i = original.cbegin(); i != original.cend(); ++i) {
+    fountain_packet out = dec.next_decoded();
+    BOOST_CHECK(i->buffer() == out.buffer());
+    BOOST_CHECK_EQUAL(i->getPriority(), out.getPriority());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(save_restore_state) {
+  size_t L = 100;
+  size_t K_uep = 100;
+  lt_uep_parameter_set ps;
+  ps.Ks = {25, 75};
+  ps.RFs = {2, 1};
+  ps.EF = 2;
+  ps.c = 0.1;
+  ps.delta = 0.5;
+
+  uep_encoder<std::mt19937> enc(ps);
+  uep_decoder dec(ps);
+
+  vector<fountain_packet> original;
+  for (size_t i = 0; i < 2; ++i) {
+    for (size_t j = 0; j < ps.Ks[0]; ++j) {
+      fountain_packet p(random_pkt(L));
+      p.setPriority(0);
+      original.push_back(p);
+      enc.push(std::move(p));
+    }
+    // Leave the second block incomplete
+    for (size_t j = 0; j < ps.Ks[1] - 10*i; ++j) {
+      fountain_packet p(random_pkt(L));
+      p.setPriority(1);
+      original.push_back(p);
+      enc.push(std::move(p));
+    }
+  }
+  BOOST_CHECK(enc.has_block());
+
+  for (size_t i = 0; i < 30; ++i) {
+    dec.push(enc.next_coded());
+  }
+
+  stream_checkpoint cp;
+  cp.encoder = enc.save_state();
+  stringstream ss;
+  write_checkpoint(ss, cp);
+  stream_checkpoint read_cp = read_checkpoint(ss);
+
+  uep_encoder<std::mt19937> enc2(ps);
+  enc2.restore_state(read_cp.encoder);
+  BOOST_CHECK_EQUAL(enc2.size(), enc.size());
+  BOOST_CHECK_EQUAL(enc2.has_block(), enc.has_block());
+  BOOST_CHECK_EQUAL(enc2.blockno(), enc.blockno());
+  BOOST_CHECK_EQUAL(enc2.block_seed(), enc.block_seed());
+  BOOST_CHECK_EQUAL(enc2.coded_count(), enc.coded_count());
+  BOOST_CHECK_EQUAL(enc2.seqno(), enc.seqno());
+
+  for (size_t i = 0; i < 20; ++i) {
+    fountain_packet a = enc.next_coded();
+    fountain_packet b = enc2.next_coded();
+    BOOST_CHECK_EQUAL(a.block_number(), b.block_number());
+    BOOST_CHECK_EQUAL(a.sequence_number(), b.sequence_number());
+    BOOST_CHECK_EQUAL(a.block_seed(), b.block_seed());
+    BOOST_CHECK(a.buffer() == b.buffer());
+  }
+
+  // The decoder completes the block from the restored encoder
+  while (!dec.has_decoded()) {
+    dec.push(enc2.next_coded());
+  }
+  BOOST_CHECK_EQUAL(dec.queue_size(), K_uep);
+  for (size_t i = 0; i < K_uep; ++i) {
+    fountain_packet out = dec.next_decoded();
+    BOOST_CHECK(original[i].buffer() == out.buffer());
+  }
+
+  // The queued packets of the incomplete block are restored as well
+  for (size_t j = 0; j < 10; ++j) {
+    fountain_packet p(random_pkt(L));
+    p.setPriority(1);
+    enc2.push(std::move(p));
+  }
+  enc2.next_block();
+  BOOST_CHECK(enc2.has_block());
+  BOOST_CHECK_THROW(read_checkpoint(ss), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(interleaved_decoding) {
+  size_t L = 100;
+  size_t K_uep = 100;
+  size_t nblocks = 5;
+  size_t depth = 3;
+  lt_uep_parameter_set ps;
+  ps.Ks = {25, 75};
+  ps.RFs = {2, 1};
+  ps.EF = 2;
+  ps.c = 0.1;
+  ps.delta = 0.5;
+
+  uep_encoder<std::mt19937> enc(ps);
+  uep_decoder dec(ps);
+  enc.interleave_depth(depth);
+  dec.interleave_depth(depth);
+
+  vector<fountain_packet> original;
+  for (size_t i = 0; i < nblocks; ++i) {
+    for (size_t j = 0; j < K_uep; ++j) {
+      fountain_packet p(random_pkt(L));
+      p.setPriority(j < ps.Ks[0] ? 0 : 1);
+      original.push_back(p);
+    }
+  }
+  // Push in priority order inside each block
+  for (const fountain_packet &p : original) {
+    enc.push(p);
+    BOOST_CHECK(!enc.has_block() || enc.size() >= depth*K_uep);
+  }
+  enc.pad_partial_block();
+  BOOST_CHECK(enc.has_block());
+
+  while (enc.has_block()) {
+    dec.push(enc.next_coded());
+    if (enc.coded_count() == 3*K_uep) enc.next_block();
+  }
+  dec.flush(enc.blockno());
+
+  BOOST_CHECK_EQUAL(dec.queue_size(), nblocks*K_uep);
+  for (auto i = original.cbegin(); i != original.cend(); ++i) {
+    fountain_packet out = dec.next_decoded();
+    BOOST_CHECK(i->buffer() == out.buffer());
+    BOOST_CHECK_EQUAL(i->getPriority(), out.getPriority());
+  }
+}
+
 BOOST_AUTO_TEST_CASE(drop_packets) {
   size_t L = 1500;
   size_t K_uep = 100;
@@ -1124,3 +1361,93 @@ BOOST_AUTO_TEST_CASE(uep_padding_many) {
     ++i;
   }
 }
+
+BOOST_AUTO_TEST_CASE(priority_ripple_order) {
+  size_t L = 100;
+  lt_uep_parameter_set ps;
+  ps.Ks = {50, 150};
+  ps.RFs = {1, 1};
+  ps.EF = 1;
+  ps.c = 0.1;
+  ps.delta = 0.5;
+
+  vector<fountain_packet> original;
+  for (size_t j = 0; j < ps.Ks[0] + ps.Ks[1]; ++j) {
+    fountain_packet p(random_pkt(L));
+    p.setPriority(j < ps.Ks[0] ? 0 : 1);
+    original.push_back(p);
+  }
+  uep_encoder<std::mt19937> enc(ps);
+  for (const auto &p : original) enc.push(p);
+  vector<fountain_packet> coded;
+  for (size_t i = 0; i < 2 * original.size(); ++i) {
+    coded.push_back(enc.next_coded());
+  }
+
+  // The peeling stops before the block is complete
+  auto decode_mib = [&](mp::ripple_order order) {
+    uep_decoder dec(ps);
+    dec.set_ripple_order(order);
+    dec.set_decode_budget(ps.Ks[0] + 10);
+    dec.push(coded.cbegin(), coded.cend());
+    dec.flush();
+    size_t mib = 0;
+    while (dec) {
+      fountain_packet p = dec.next_decoded();
+      if (p.getPriority() == 0) ++mib;
+    }
+    return mib;
+  };
+  size_t fifo_mib = decode_mib(mp::ripple_order::fifo);
+  size_t prio_mib = decode_mib(mp::ripple_order::priority);
+  BOOST_CHECK_LT(fifo_mib, prio_mib);
+
+  // Without a budget the order does not change the result
+  uep_decoder dec(ps);
+  dec.set_ripple_order(mp::ripple_order::priority);
+  for (const auto &p : coded) dec.push(p);
+  BOOST_CHECK(dec.has_decoded());
+  for (auto i = original.cbegin(); i != original.cend(); ++i) {
+    fountain_packet out = dec.next_decoded();
+    BOOST_CHECK(i->buffer() == out.buffer());
+    BOOST_CHECK_EQUAL(i->getPriority(), out.getPriority());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(decoded_callback) {
+  size_t L = 100;
+  lt_uep_parameter_set ps;
+  ps.Ks = {25, 75};
+  ps.RFs = {2, 1};
+  ps.EF = 2;
+  ps.c = 0.1;
+  ps.delta = 0.5;
+
+  vector<fountain_packet> original;
+  for (size_t j = 0; j < ps.Ks[0] + ps.Ks[1]; ++j) {
+    fountain_packet p(random_pkt(L));
+    p.setPriority(j < ps.Ks[0] ? 0 : 1);
+    original.push_back(p);
+  }
+  uep_encoder<std::mt19937> enc(ps);
+  for (const auto &p : original) enc.push(p);
+
+  uep_decoder dec(ps);
+  map<size_t, uep_packet> notified;
+  dec.set_decoded_callback([&](size_t blockno, const uep_packet &up) {
+      BOOST_CHECK_EQUAL(blockno, 0);
+      BOOST_CHECK(notified.find(up.sequence_number()) == notified.end());
+      notified[up.sequence_number()] = up;
+    });
+  while (!dec.has_decoded()) dec.push(enc.next_coded());
+
+  // All the packets are notified before they are extracted
+  BOOST_REQUIRE_EQUAL(notified.size(), original.size());
+  for (size_t i = 0; i < original.size(); ++i) {
+    const uep_packet &up = notified.at(i);
+    BOOST_CHECK(up.buffer() == original[i].buffer());
+    BOOST_CHECK_EQUAL(up.priority(), original[i].getPriority());
+    fountain_packet out = dec.next_decoded();
+    BOOST_CHECK(out.buffer() == original[i].buffer());
+  }
+}